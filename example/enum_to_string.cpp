@@ -9,7 +9,7 @@
 
 #include <iostream>
 
-#include <cppast/cpp_enum.hpp> // cpp_enum
+#include <cppast/cpp_enum.hpp> // cpp_enum, cpp_enum_value_table
 #include <cppast/visitor.hpp>  // visit()
 
 #include "example_parser.hpp"
@@ -36,9 +36,12 @@ void generate_to_string(const cppast::cpp_file& file)
                                     << "& e) {\n";
 
                           // generate switch
+                          // enumerators with the same value are the same case, so use the table
+                          cppast::cpp_enum_value_table table(enum_);
                           std::cout << "  switch (e) {\n";
-                          for (const auto& enumerator : enum_)
+                          for (const auto& entry : table.entries())
                           {
+                              auto& enumerator = *entry.enumerator;
                               std::cout << "  case " << enum_.name() << "::" << enumerator.name()
                                         << ":\n";
 
@@ -12,6 +12,7 @@
 
 #include <cppast/cpp_entity.hpp>
 #include <cppast/cpp_entity_ref.hpp>
+#include <cppast/cpp_token.hpp>
 
 namespace cppast
 {
@@ -26,6 +27,12 @@ namespace cppast
         /// \effects Creates it viewing the [std::string]().
         string_view(const std::string& str) noexcept : str_(str.c_str()), length_(str.length()) {}
 
+        /// \effects Creates it viewing the spelling of a token.
+        string_view(const cpp_token_spelling& str) noexcept
+        : str_(str.c_str()), length_(str.length())
+        {
+        }
+
         /// \effects Creates it viewing the C string `str`.
         string_view(const char* str) noexcept : str_(str), length_(std::strlen(str)) {}
 
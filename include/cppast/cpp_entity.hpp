@@ -6,6 +6,8 @@
 #define CPPAST_CPP_ENTITY_HPP_INCLUDED
 
 #include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
 
 #include <type_safe/optional_ref.hpp>
@@ -23,6 +25,28 @@ namespace cppast
     class cpp_template_parameter;
     class cpp_template;
 
+    namespace detail
+    {
+        // a documentation comment as written in the source,
+        // it is only normalized when it is accessed
+        struct raw_doc_comment
+        {
+            enum kind_t : unsigned char
+            {
+                c,   // the text after `/**` up to `*/`
+                cpp, // the text after `///` up to the end of the line, merged lines joined by `\n`
+            };
+
+            std::shared_ptr<const std::string> buffer; // shared by all comments of a file
+            std::uint32_t                      offset, length;
+            std::uint32_t                      column; // column of the comment start
+            kind_t                             kind;
+
+            // returns the normalized comment as documented in cpp_entity::comment()
+            std::string normalize() const;
+        };
+    } // namespace detail
+
     /// The name of a scope.
     ///
     /// It is a combination of a name and optional template parameters.
@@ -112,16 +136,37 @@ namespace cppast
         /// on the same line as the end of line comment.
         ///
         /// This comment system is also used by [standardese](https://standardese.foonathan.net).
-        type_safe::optional_ref<const std::string> comment() const noexcept
-        {
-            return comment_.empty() ? nullptr : type_safe::opt_ref(&comment_);
-        }
+        ///
+        /// \notes The parser only records where the comment is,
+        /// it is normalized the first time this function is called.
+        type_safe::optional_ref<const std::string> comment() const;
 
         /// \effects Sets the associated comment.
         /// \requires The comment must not be empty, if there is one.
         void set_comment(type_safe::optional<std::string> comment) noexcept
         {
-            comment_ = comment.value_or("");
+            raw_comment_.buffer = nullptr;
+            if (comment && !comment.value().empty())
+                comment_ = std::make_shared<const std::string>(std::move(comment.value()));
+            else
+                comment_ = nullptr;
+        }
+
+        /// \effects Sets the associated comment to the one of `other`.
+        /// \notes Unlike `set_comment(type_safe::copy(other.comment()))`,
+        /// this doesn't normalize the comment if it wasn't accessed yet.
+        void set_comment(const cpp_entity& other) noexcept
+        {
+            raw_comment_ = other.raw_comment_;
+            comment_     = std::atomic_load(&other.comment_);
+        }
+
+        /// \effects Sets the associated comment to one that is normalized on first access.
+        /// \notes This function is used by the parser.
+        void set_comment(detail::raw_doc_comment comment) noexcept
+        {
+            raw_comment_ = std::move(comment);
+            comment_     = nullptr;
         }
 
         /// \returns The list of attributes that are specified for that entity.
@@ -161,7 +206,12 @@ namespace cppast
 
     protected:
         /// \effects Creates it giving it the the name.
-        cpp_entity(std::string name) : name_(std::move(name)), user_data_(nullptr) {}
+        cpp_entity(std::string name)
+        : name_(std::move(name)),
+          raw_comment_{nullptr, 0u, 0u, 0u, detail::raw_doc_comment::c},
+          user_data_(nullptr)
+        {
+        }
 
     private:
         /// \returns The kind of the entity.
@@ -179,15 +229,22 @@ namespace cppast
             parent_ = type_safe::ref(parent);
         }
 
-        std::string                               name_;
-        std::string                               comment_;
-        cpp_attribute_list                        attributes_;
-        type_safe::optional_ref<const cpp_entity> parent_;
-        mutable std::atomic<void*>                user_data_;
+        // returns the fully qualified scope of the children, including the trailing `::`,
+        // it is computed once and shared with the children that don't create a new scope
+        std::shared_ptr<const std::string> children_scope() const;
+
+        std::string                                name_;
+        detail::raw_doc_comment                    raw_comment_;
+        mutable std::shared_ptr<const std::string> comment_; // normalized comment
+        cpp_attribute_list                         attributes_;
+        type_safe::optional_ref<const cpp_entity>  parent_;
+        mutable std::atomic<void*>                 user_data_;
+        mutable std::shared_ptr<const std::string> children_scope_;
 
         template <typename T>
         friend struct detail::intrusive_list_access;
         friend detail::intrusive_list_node<cpp_entity>;
+        friend std::string full_name(const cpp_entity& e);
     };
 
     /// A [cppast::cpp_entity]() that isn't exposed directly.
@@ -207,21 +264,33 @@ namespace cppast
         /// It will not be registered.
         static std::unique_ptr<cpp_entity> build(cpp_token_string spelling);
 
+        /// \returns A newly built and registered unexposed entity,
+        /// whose spelling is only tokenized when it is accessed.
+        /// \notes This function is used by the parser.
+        static std::unique_ptr<cpp_entity> build(const cpp_entity_index& index, cpp_entity_id id,
+                                                 std::string name,
+                                                 detail::lazy_token_string spelling);
+
+        /// \returns A newly built unnamed unexposed entity,
+        /// whose spelling is only tokenized when it is accessed.
+        /// \notes This function is used by the parser.
+        static std::unique_ptr<cpp_entity> build(detail::lazy_token_string spelling);
+
         /// \returns The spelling of that entity.
-        const cpp_token_string& spelling() const noexcept
+        const cpp_token_string& spelling() const
         {
-            return spelling_;
+            return spelling_.get();
         }
 
     private:
-        cpp_unexposed_entity(std::string name, cpp_token_string spelling)
+        cpp_unexposed_entity(std::string name, detail::lazy_token_string spelling)
         : cpp_entity(std::move(name)), spelling_(std::move(spelling))
         {
         }
 
         cpp_entity_kind do_get_entity_kind() const noexcept override;
 
-        cpp_token_string spelling_;
+        detail::lazy_token_string spelling_;
     };
 
     /// \returns Whether or not the entity is templated.
@@ -233,6 +302,20 @@ namespace cppast
     /// \returns Whether or not the given entity is "friended",
     /// that is, its declaration exists as part of a [cppast::cpp_friend]() declaration.
     bool is_friended(const cpp_entity& e) noexcept;
+
+    /// \returns The fully qualified name of the entity,
+    /// i.e. its name prefixed with the names of all enclosing scopes separated by `::`,
+    /// e.g. `ns::Widget::resize`.
+    /// Anonymous scopes do not contribute to the name,
+    /// the semantic scope of out of line definitions and the enclosing namespace of friended entities do.
+    /// A templated entity has the same name as its template.
+    /// If the entity has no name, it returns the empty string,
+    /// and parameters don't have a fully qualified name, so it returns their name.
+    /// \requires The entity must be part of the final AST,
+    /// as the name of a scope is cached when it is first requested.
+    /// \notes The qualified name of each scope is only computed once and shared by all entities in it.
+    /// This function is thread safe.
+    std::string full_name(const cpp_entity& e);
 } // namespace cppast
 
 #endif // CPPAST_CPP_ENTITY_HPP_INCLUDED
@@ -5,8 +5,12 @@
 #ifndef CPPAST_CPP_ENTITY_INDEX_HPP_INCLUDED
 #define CPPAST_CPP_ENTITY_INDEX_HPP_INCLUDED
 
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -19,37 +23,123 @@ namespace cppast
     class cpp_entity;
     class cpp_file;
     class cpp_namespace;
+    class cpp_entity_index_snapshot;
+    class cpp_forward_declarable;
+
+    struct cpp_entity_id;
 
     /// \exclude
     namespace detail
     {
-        constexpr std::size_t fnv_basis = 14695981039346656037ull;
-        constexpr std::size_t fnv_prime = 1099511628211ull;
-
-        // FNV-1a 64 bit hash
-        constexpr std::size_t id_hash(const char* str, std::size_t hash = fnv_basis)
+        // incremental hash of strings, processing 8 bytes at a time
+        // appending multiple strings gives the same hash as appending their concatenation
+        class id_hasher
         {
-            return *str ? id_hash(str + 1, (hash ^ std::size_t(*str)) * fnv_prime) : hash;
-        }
+        public:
+            id_hasher() noexcept;
+
+            id_hasher& append(const char* str, std::size_t length) noexcept;
+
+            id_hasher& append(const char* str) noexcept
+            {
+                return append(str, std::strlen(str));
+            }
+
+            id_hasher& append(const std::string& str) noexcept
+            {
+                return append(str.data(), str.size());
+            }
+
+            std::size_t finish() const noexcept;
+
+        private:
+            void mix(std::uint64_t word) noexcept;
+
+            std::uint64_t hash_;
+            std::uint64_t tail_;
+            std::size_t   length_;
+#ifdef CPPAST_CHECK_ID_COLLISIONS
+            std::string key_;
+#endif
+
+            friend cpp_entity_id;
+        };
+
+        std::size_t id_hash(const char* str, std::size_t length) noexcept;
     } // namespace detail
 
     /// A [ts::strong_typedef]() representing the unique id of a [cppast::cpp_entity]().
     ///
     /// It is comparable for equality.
+    /// \notes The id is a hash of a string, so different strings can result in the same id.
+    /// If `CPPAST_CHECK_ID_COLLISIONS` is enabled, the id also stores the string,
+    /// and the [cppast::cpp_entity_index]() checks for collisions.
     struct cpp_entity_id : type_safe::strong_typedef<cpp_entity_id, std::size_t>,
                            type_safe::strong_typedef_op::equality_comparison<cpp_entity_id>
     {
-        explicit cpp_entity_id(const std::string& str) : cpp_entity_id(str.c_str()) {}
+        explicit cpp_entity_id(const std::string& str) : cpp_entity_id(str.data(), str.size()) {}
+
+        explicit cpp_entity_id(const char* str) : cpp_entity_id(str, std::strlen(str)) {}
+
+        explicit cpp_entity_id(const char* str, std::size_t length)
+        : strong_typedef(detail::id_hash(str, length))
+#ifdef CPPAST_CHECK_ID_COLLISIONS
+          ,
+          key_(str, length)
+#endif
+        {
+        }
+
+        /// \effects Creates it from the string hashed by the given hasher.
+        /// \notes This avoids concatenating strings to create an id.
+        /// \exclude
+        explicit cpp_entity_id(const detail::id_hasher& hasher)
+        : strong_typedef(hasher.finish())
+#ifdef CPPAST_CHECK_ID_COLLISIONS
+          ,
+          key_(hasher.key_)
+#endif
+        {
+        }
 
-        explicit cpp_entity_id(const char* str) : strong_typedef(detail::id_hash(str)) {}
+#ifdef CPPAST_CHECK_ID_COLLISIONS
+        /// \returns The string the id was created from.
+        /// \notes This function is only available if `CPPAST_CHECK_ID_COLLISIONS` is enabled.
+        const std::string& key() const noexcept
+        {
+            return key_;
+        }
+#endif
+
+    private:
+        struct from_hash_tag
+        {
+        };
+
+        // used by the snapshot, which stores the hash and the string if it is known
+        cpp_entity_id(from_hash_tag, std::size_t hash, const char* key)
+        : strong_typedef(hash)
+#ifdef CPPAST_CHECK_ID_COLLISIONS
+          ,
+          key_(key)
+#endif
+        {
+            (void)key;
+        }
+
+#ifdef CPPAST_CHECK_ID_COLLISIONS
+        std::string key_;
+#endif
+
+        friend cpp_entity_index_snapshot;
     };
 
     inline namespace literals
     {
         /// \returns A new [cppast::cpp_entity_id]() created from the given string.
-        inline cpp_entity_id operator"" _id(const char* str, std::size_t)
+        inline cpp_entity_id operator"" _id(const char* str, std::size_t length)
         {
-            return cpp_entity_id(str);
+            return cpp_entity_id(str, length);
         }
     }
 
@@ -59,6 +149,13 @@ namespace cppast
     class cpp_entity_index
     {
     public:
+        /// \effects Creates an empty index.
+        /// If `track_files` is `true`, it keeps track of the file of every registered entity,
+        /// which is required for [*unregister_file]() but costs additional memory.
+        /// Then the entities of a file must be registered by the same thread as the file itself,
+        /// as the parser does.
+        explicit cpp_entity_index(bool track_files = false);
+
         /// Exception thrown on duplicate entity definition.
         class duplicate_definition_error : public std::logic_error
         {
@@ -66,9 +163,23 @@ namespace cppast
             duplicate_definition_error();
         };
 
+        /// Exception thrown if two different strings result in the same [cppast::cpp_entity_id]().
+        /// \notes It is only thrown if `CPPAST_CHECK_ID_COLLISIONS` is enabled.
+        class id_collision_error : public std::logic_error
+        {
+        public:
+            id_collision_error(const std::string& a, const std::string& b);
+        };
+
         /// \effects Registers a new [cppast::cpp_entity]() which is a definition.
-        /// It will override any previously registered declarations of the same entity.
-        /// \throws duplicate_defintion_error if the entity has been registered as definition before.
+        /// It will override any previously registered declarations of the same entity,
+        /// and stores the definition in all of them, see [cppast::cpp_forward_declarable::definition_entity]().
+        /// \throws duplicate_defintion_error if the entity has been registered as definition before,
+        /// unless the index tracks files.
+        /// Then the first definition is used,
+        /// and the others replace it once its file is unregistered,
+        /// as e.g. an inline function can be defined in multiple files.
+        /// \throws id_collision_error if collision checks are enabled and the id collides with another one.
         /// \requires The entity must live as long as the index lives,
         /// and it must not be a namespace.
         /// \notes This operation is thread safe.
@@ -84,6 +195,8 @@ namespace cppast
 
         /// \effects Registers a new [cppast::cpp_entity]() which is a declaration.
         /// Only the first declaration will be registered.
+        /// If the definition has already been registered, it is stored in the declaration,
+        /// else it will be stored once the definition is registered.
         /// \requires The entity must live as long as the index lives.
         /// \requires The entity must be forward declarable.
         /// \notes This operation is thread safe.
@@ -96,6 +209,30 @@ namespace cppast
         void register_namespace(cpp_entity_id                              id,
                                 type_safe::object_ref<const cpp_namespace> ns) const;
 
+        /// \effects Removes all entities of the given [cppast::cpp_file]() from the index,
+        /// including the file itself.
+        /// If a definition is removed, the declarations in other files no longer store it,
+        /// and the entity falls back to another definition or the first remaining declaration.
+        /// Afterwards the file can be registered again, e.g. by parsing it once more.
+        /// \requires The index must track files.
+        /// The file must have been parsed completely.
+        /// Nothing else must refer to the entities of the file anymore.
+        /// References linked with [cppast::link]() look up their entities in the index again.
+        /// \notes The name index is not updated, the ids of the removed entities will no longer be found by `lookup()`.
+        /// \notes This operation is thread safe,
+        /// its cost is linear in the number of entities of the file
+        /// and of the entities registered since the last call.
+        void unregister_file(const cpp_file& file) const;
+
+        /// \effects Removes all registered entities, files and namespaces, as well as the name index.
+        /// \notes This operation is thread safe.
+        void clear() const noexcept;
+
+        /// \returns A number that changes whenever entities are removed from the index,
+        /// i.e. by [*unregister_file]() or [*clear]().
+        /// \notes This operation is thread safe.
+        std::uint64_t generation() const noexcept;
+
         /// \returns A [ts::optional_ref]() corresponding to the entity(/ies) of the given [cppast::cpp_entity_id]().
         /// If no definition has been registered, it return the first declaration that was registered.
         /// If the id resolves to a namespaces, returns an empty optional.
@@ -114,6 +251,51 @@ namespace cppast
         auto lookup_namespace(const cpp_entity_id& id) const noexcept
             -> type_safe::array_ref<type_safe::object_ref<const cpp_namespace>>;
 
+        /// \effects Builds the index of fully qualified names of all registered entities and namespaces.
+        /// The name of an entity is its [cppast::cpp_entity::name]() prefixed with the names of all enclosing scopes,
+        /// separated by `::`, e.g. `ns::Widget::resize`.
+        /// Anonymous entities, files and parameters are not part of the name index.
+        /// \requires All files whose entities should be indexed must have been parsed completely,
+        /// as the name of an entity depends on its parents.
+        /// \notes Calling it again rebuilds the name index from scratch,
+        /// which invalidates all array references returned by the name lookup functions.
+        /// \notes This operation is thread safe.
+        void build_name_index() const;
+
+        /// \returns A [ts::array_ref]() of all [cppast::cpp_entity_id]() whose fully qualified name is `name`.
+        /// There can be multiple ids in case of overloaded functions.
+        /// If no entity is found, it returns an empty array reference.
+        /// \requires [*build_name_index]() has been called.
+        /// \notes This operation is thread safe.
+        auto lookup_name(const std::string& name) const noexcept
+            -> type_safe::array_ref<const cpp_entity_id>;
+
+        /// \returns A [ts::array_ref]() of all [cppast::cpp_entity_id]() whose fully qualified name starts with `prefix`.
+        /// For example, the prefix `ns::Widget::` finds all (nested) members of `ns::Widget`.
+        /// If no entity is found, it returns an empty array reference.
+        /// \requires [*build_name_index]() has been called.
+        /// \notes This operation is thread safe.
+        auto lookup_name_prefix(const std::string& prefix) const noexcept
+            -> type_safe::array_ref<const cpp_entity_id>;
+
+        /// \returns A [ts::array_ref]() of all [cppast::cpp_entity_id]() that are direct members of the given scope,
+        /// i.e. that have the fully qualified name `scope::<name>`.
+        /// The empty string is the global scope.
+        /// If no entity is found, it returns an empty array reference.
+        /// \requires [*build_name_index]() has been called.
+        /// \notes This operation is thread safe.
+        auto lookup_scope_members(const std::string& scope) const noexcept
+            -> type_safe::array_ref<const cpp_entity_id>;
+
+        /// \effects Writes a snapshot of the index to the given file,
+        /// which can be opened using [cppast::cpp_entity_index_snapshot]().
+        /// It contains the id, kind, name, fully qualified name and file of every registered entity,
+        /// as well as the files of every namespace, but not the entities themselves.
+        /// \throws snapshot_error if the file could not be written.
+        /// \requires All files must have been parsed completely, as with [*build_name_index]().
+        /// \notes This operation is thread safe.
+        void write_snapshot(const std::string& path) const;
+
     private:
         struct hash
         {
@@ -125,8 +307,10 @@ namespace cppast
 
         struct value
         {
-            type_safe::object_ref<const cpp_entity> entity;
-            bool                                    is_definition;
+            type_safe::object_ref<const cpp_entity>              entity;
+            bool                                                 is_definition;
+            // until the definition has been registered, or all if files are tracked
+            std::vector<type_safe::object_ref<const cpp_entity>> declarations;
 
             value(type_safe::object_ref<const cpp_entity> e, bool def)
             : entity(std::move(e)), is_definition(def)
@@ -134,11 +318,75 @@ namespace cppast
             }
         };
 
+        // stores the definition in the declaration, requires lock
+        void link_definition(const cpp_entity& decl, const cpp_entity* def) const;
+
+        // throws if the id collides with a previously registered one, requires lock
+        void check_collision(const cpp_entity_id& id) const;
+        // whether the id is the one registered under its hash, requires lock
+        bool is_registered_key(const cpp_entity_id& id) const noexcept;
+
+        struct registration
+        {
+            const cpp_entity* entity;
+            cpp_entity_id     id;
+            bool              is_namespace;
+
+            registration(const cpp_entity& e, cpp_entity_id i, bool ns)
+            : entity(&e), id(std::move(i)), is_namespace(ns)
+            {
+            }
+        };
+
+        // remembers the registration to find it again in unregister_file(), requires lock
+        void track(const cpp_entity& entity, const cpp_entity_id& id,
+                   bool is_namespace = false) const;
+        // removes the entity from the entry of the id, requires lock
+        void unregister(const registration& r) const;
+
+        struct name_entry
+        {
+            std::string name;
+            std::size_t scope_length; // length of the scope part of the name, without `::`
+
+            name_entry(std::string n, std::size_t length) : name(std::move(n)), scope_length(length)
+            {
+            }
+        };
+
         mutable std::mutex                                     mutex_;
         mutable std::unordered_map<cpp_entity_id, value, hash> map_;
         mutable std::unordered_map<cpp_entity_id,
                                    std::vector<type_safe::object_ref<const cpp_namespace>>, hash>
             ns_;
+
+        // name index: names_ are sorted by name, name_ids_ is the corresponding id,
+        // members_ are the indices into names_ sorted by scope first, member_ids_ the corresponding id
+        mutable std::vector<name_entry>    names_;
+        mutable std::vector<cpp_entity_id> name_ids_;
+        mutable std::vector<std::size_t>   members_;
+        mutable std::vector<cpp_entity_id> member_ids_;
+
+        // only used if files are tracked:
+        // the registrations of each thread until it registers their file,
+        // the registrations of each file, and the definitions that aren't used as they came later
+        bool                                                                   track_files_;
+        mutable std::unordered_map<std::thread::id, std::vector<registration>> untracked_;
+        mutable std::unordered_map<const cpp_file*, std::vector<registration>> tracked_;
+        mutable std::unordered_map<cpp_entity_id,
+                                   std::vector<type_safe::object_ref<const cpp_entity>>, hash>
+            duplicates_;
+
+        mutable std::atomic<std::uint64_t> generation_{0u};
+        // unique for every index and changed on clear(),
+        // so definitions stored in declarations can't be used by another index
+        mutable std::atomic<std::uint64_t> instance_;
+
+        friend cpp_forward_declarable;
+
+#ifdef CPPAST_CHECK_ID_COLLISIONS
+        mutable std::unordered_map<cpp_entity_id, std::string, hash> keys_;
+#endif
     };
 } // namespace cppast
 
@@ -0,0 +1,136 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#ifndef CPPAST_CPP_ENTITY_INDEX_SNAPSHOT_HPP_INCLUDED
+#define CPPAST_CPP_ENTITY_INDEX_SNAPSHOT_HPP_INCLUDED
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <type_safe/optional.hpp>
+
+#include <cppast/cpp_entity_index.hpp>
+#include <cppast/cpp_entity_kind.hpp>
+
+namespace cppast
+{
+    /// The exception thrown when a snapshot file cannot be written or read.
+    class snapshot_error final : public std::runtime_error
+    {
+    public:
+        /// \effects Creates it with a message.
+        snapshot_error(std::string msg) : std::runtime_error(std::move(msg)) {}
+    };
+
+    /// \exclude
+    namespace detail
+    {
+        // the binary layout of the snapshot file, all offsets are relative to the file begin
+        struct snapshot_header
+        {
+            char          magic[8];
+            std::uint32_t version;
+            std::uint32_t entity_count;
+            std::uint32_t namespace_file_count;
+            std::uint32_t name_count;
+            std::uint64_t strings_offset;
+            std::uint64_t strings_size;
+            std::uint64_t entities_offset;
+            std::uint64_t namespace_files_offset;
+            std::uint64_t names_offset;
+        };
+
+        // sorted by id, strings are offsets into the string table
+        struct snapshot_entity
+        {
+            std::uint64_t id;
+            std::uint32_t file;
+            std::uint32_t name;
+            std::uint32_t full_name;
+            std::uint32_t key; // empty unless written with CPPAST_CHECK_ID_COLLISIONS
+            std::uint32_t first_namespace_file; // for namespaces only
+            std::uint32_t namespace_file_count; // for namespaces only
+            std::uint16_t kind;
+            std::uint8_t  is_definition;
+            std::uint8_t  padding[5];
+        };
+    } // namespace detail
+
+    /// A read-only snapshot of a [cppast::cpp_entity_index]().
+    ///
+    /// It is created by [cppast::cpp_entity_index::write_snapshot]()
+    /// and contains the information about all registered entities,
+    /// but not the entities themselves.
+    /// The file is memory mapped and used directly, so opening a snapshot is cheap.
+    /// \notes A snapshot can only be read on the same kind of platform it was written on.
+    /// If `CPPAST_CHECK_ID_COLLISIONS` is enabled,
+    /// it must have been written with it enabled as well,
+    /// otherwise the ids do not know their string and are not found in an index.
+    class cpp_entity_index_snapshot
+    {
+    public:
+        /// Information about an entity in the snapshot.
+        struct entity_info
+        {
+            cpp_entity_id   id;
+            const char*     file;      //< The name of the file containing the entity.
+            const char*     name;      //< The name of the entity.
+            const char*     full_name; //< The fully qualified name of the entity, see [cppast::full_name]().
+            cpp_entity_kind kind;
+            bool            is_definition;
+        };
+
+        /// \effects Opens the given snapshot file.
+        /// \throws snapshot_error if the file could not be read or is not a valid snapshot,
+        /// i.e. if it is truncated or refers to data outside of its tables.
+        explicit cpp_entity_index_snapshot(const std::string& path);
+
+        cpp_entity_index_snapshot(cpp_entity_index_snapshot&& other) noexcept;
+
+        ~cpp_entity_index_snapshot() noexcept;
+
+        cpp_entity_index_snapshot& operator=(cpp_entity_index_snapshot&& other) noexcept;
+
+        /// \effects Merges the given snapshot files into a single snapshot written to `output`.
+        /// If an entity is in multiple snapshots, the definition is kept,
+        /// the files of a namespace are combined.
+        /// \throws snapshot_error if an input file could not be read or the output file could not be written.
+        static void merge(const std::vector<std::string>& inputs, const std::string& output);
+
+        /// \returns The number of entities in the snapshot.
+        std::size_t size() const noexcept;
+
+        /// \returns Information about the entity with the given [cppast::cpp_entity_id](),
+        /// or an empty optional if there is none.
+        /// \notes For namespaces, the file is the first file the namespace was registered in.
+        type_safe::optional<entity_info> lookup(const cpp_entity_id& id) const noexcept;
+
+        /// \returns The names of all files containing the namespace with the given [cppast::cpp_entity_id]().
+        std::vector<const char*> lookup_namespace(const cpp_entity_id& id) const;
+
+        /// \returns Information about all entities whose fully qualified name is `name`.
+        std::vector<entity_info> lookup_name(const std::string& name) const;
+
+        /// \returns Information about all entities whose fully qualified name starts with `prefix`.
+        std::vector<entity_info> lookup_name_prefix(const std::string& prefix) const;
+
+    private:
+        void release() noexcept;
+        bool validate() const noexcept;
+
+        const detail::snapshot_header& header() const noexcept;
+        const detail::snapshot_entity* entities() const noexcept;
+        const std::uint32_t*           names() const noexcept;
+        const char*                    string(std::uint32_t offset) const noexcept;
+        entity_info                    get_info(const detail::snapshot_entity& entity) const noexcept;
+
+        const char* data_;
+        std::size_t size_;
+        bool        is_mapped_;
+    };
+} // namespace cppast
+
+#endif // CPPAST_CPP_ENTITY_INDEX_SNAPSHOT_HPP_INCLUDED
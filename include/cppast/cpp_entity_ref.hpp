@@ -27,14 +27,20 @@ namespace cppast
     public:
         /// \effects Creates it giving it the target id and name.
         basic_cpp_entity_ref(cpp_entity_id target_id, std::string target_name)
-        : target_(std::move(target_id)), name_(std::move(target_name))
+        : target_(std::move(target_id)),
+          name_(std::move(target_name)),
+          linked_index_(nullptr),
+          linked_generation_(0u)
         {
         }
 
         /// \effects Creates it giving it multiple target ids and name.
         /// \notes This is to refer to an overloaded function.
         basic_cpp_entity_ref(std::vector<cpp_entity_id> target_ids, std::string target_name)
-        : target_(std::move(target_ids)), name_(std::move(target_name))
+        : target_(std::move(target_ids)),
+          name_(std::move(target_name)),
+          linked_index_(nullptr),
+          linked_generation_(0u)
         {
         }
 
@@ -74,14 +80,52 @@ namespace cppast
         /// \returns An array reference to the entities it refers to.
         /// The return type provides `operator[]` + `size()`,
         /// as well as `begin()` and `end()` returning forward iterators.
+        /// \notes If the reference has been linked with the index, this does not query the index.
         /// \exclude return
         std::vector<type_safe::object_ref<const T>> get(const cpp_entity_index& idx) const
         {
+            if (auto linked = get_linked(idx))
+                return linked.value();
+
             std::vector<type_safe::object_ref<const T>> result;
             get_impl(std::is_convertible<cpp_namespace&, T&>{}, result, idx);
             return result;
         }
 
+        /// \returns A reference to the entities stored by [*link](),
+        /// or `nullptr` if it hasn't been linked with the given index,
+        /// or entities have been removed from the index since then.
+        /// \notes Unlike [*get](), this never allocates.
+        type_safe::optional_ref<const std::vector<type_safe::object_ref<const T>>> get_linked(
+            const cpp_entity_index& idx) const noexcept
+        {
+            if (linked_index_ != &idx || linked_generation_ != idx.generation())
+                return nullptr;
+            return type_safe::ref(linked_);
+        }
+
+        /// \effects Resolves the reference using the given index and stores the entities,
+        /// so that later calls to [*get]() with the same index don't need to look them up again.
+        /// \returns Whether or not the reference refers to at least one entity.
+        /// \requires All entities it could refer to must have been registered in the index.
+        /// \notes This function is not thread safe,
+        /// it must not be called while the reference is used by another thread.
+        /// \notes Once entities are removed from the index, the stored entities are no longer used.
+        bool link(const cpp_entity_index& idx) const
+        {
+            linked_.clear();
+            linked_generation_ = idx.generation();
+            get_impl(std::is_convertible<cpp_namespace&, T&>{}, linked_, idx);
+            linked_index_ = &idx;
+            return !linked_.empty();
+        }
+
+        /// \returns Whether or not [*link]() has been called.
+        bool is_linked() const noexcept
+        {
+            return linked_index_ != nullptr;
+        }
+
     private:
         void get_impl(std::true_type, std::vector<type_safe::object_ref<const T>>& result,
                       const cpp_entity_index& idx) const
@@ -110,6 +154,9 @@ namespace cppast
 
         type_safe::variant<cpp_entity_id, std::vector<cpp_entity_id>> target_;
         std::string                                                   name_;
+        mutable std::vector<type_safe::object_ref<const T>>           linked_;
+        mutable const cpp_entity_index*                               linked_index_;
+        mutable std::uint64_t                                         linked_generation_;
     };
 
     /// \exclude
@@ -6,7 +6,9 @@
 #define CPPAST_CPP_ENUM_HPP_INCLUDED
 
 #include <memory>
+#include <vector>
 
+#include <type_safe/optional.hpp>
 #include <type_safe/optional_ref.hpp>
 
 #include <cppast/cpp_entity_container.hpp>
@@ -26,9 +28,11 @@ namespace cppast
 
         /// \returns A newly created and registered enum value.
         /// \notes `value` may be `nullptr`, in which case the enum has an implicit value.
+        /// `evaluated_value` is the value of the enumerator as computed by the compiler, if known.
         static std::unique_ptr<cpp_enum_value> build(
             const cpp_entity_index& idx, cpp_entity_id id, std::string name,
-            std::unique_ptr<cpp_expression> value = nullptr);
+            std::unique_ptr<cpp_expression>         value           = nullptr,
+            type_safe::optional<cpp_integral_value> evaluated_value = type_safe::nullopt);
 
         /// \returns A [ts::optional_ref]() to the [cppast::cpp_expression]() that is the enum value.
         /// \notes It only has an associated expression if the value is explictly given.
@@ -37,15 +41,25 @@ namespace cppast
             return type_safe::opt_cref(value_.get());
         }
 
+        /// \returns The value of the enumerator, regardless of whether it is given explicitly or implicitly.
+        /// \notes It does not have a value if the parser could not evaluate it,
+        /// e.g. because it depends on a template parameter.
+        const type_safe::optional<cpp_integral_value>& evaluated_value() const noexcept
+        {
+            return evaluated_;
+        }
+
     private:
-        cpp_enum_value(std::string name, std::unique_ptr<cpp_expression> value)
-        : cpp_entity(std::move(name)), value_(std::move(value))
+        cpp_enum_value(std::string name, std::unique_ptr<cpp_expression> value,
+                       type_safe::optional<cpp_integral_value> evaluated)
+        : cpp_entity(std::move(name)), value_(std::move(value)), evaluated_(std::move(evaluated))
         {
         }
 
         cpp_entity_kind do_get_entity_kind() const noexcept override;
 
-        std::unique_ptr<cpp_expression> value_;
+        std::unique_ptr<cpp_expression>         value_;
+        type_safe::optional<cpp_integral_value> evaluated_;
     };
 
     /// A [cppast::cpp_entity]() modelling a C++ enumeration.
@@ -142,6 +156,49 @@ namespace cppast
         std::unique_ptr<cpp_type> type_;
         bool                      scoped_, type_given_;
     };
+
+    /// A table mapping the values of a [cppast::cpp_enum]() to its enumerators.
+    ///
+    /// It is meant for generating or implementing value to string conversions:
+    /// If the values are densely packed, a lookup is a single index operation,
+    /// otherwise it is a binary search over the sorted values.
+    /// \notes The table refers to the enumerators, so the enum must outlive it.
+    class cpp_enum_value_table
+    {
+    public:
+        /// An enumerator together with its value.
+        struct entry
+        {
+            cpp_integral_value    value;
+            const cpp_enum_value* enumerator;
+        };
+
+        /// \effects Creates the table of all enumerators of the given enum.
+        /// Enumerators that don't have an [cppast::cpp_enum_value::evaluated_value]() are ignored,
+        /// if multiple enumerators have the same value, the first one is used.
+        explicit cpp_enum_value_table(const cpp_enum& e);
+
+        /// \returns The first enumerator with the given value, if there is one.
+        type_safe::optional_ref<const cpp_enum_value> lookup(const cpp_integral_value& value) const
+            noexcept;
+
+        /// \returns All distinct values together with the first enumerator that has this value,
+        /// sorted by value.
+        const std::vector<entry>& entries() const noexcept
+        {
+            return entries_;
+        }
+
+        /// \returns Whether or not the lookup is a single index operation.
+        bool is_dense() const noexcept
+        {
+            return !dense_.empty();
+        }
+
+    private:
+        std::vector<entry>       entries_;
+        std::vector<std::size_t> dense_; // value - min value -> index into entries_ + 1, or 0
+    };
 } // namespace cppast
 
 #endif // CPPAST_CPP_ENUM_HPP_INCLUDED
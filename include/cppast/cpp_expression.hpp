@@ -6,8 +6,11 @@
 #define CPPAST_CPP_EXPRESSION_HPP_INCLUDED
 
 #include <atomic>
+#include <cstdint>
 #include <memory>
 
+#include <type_safe/optional.hpp>
+
 #include <cppast/cpp_token.hpp>
 #include <cppast/cpp_type.hpp>
 
@@ -21,6 +24,83 @@ namespace cppast
         unexposed_t,
     };
 
+    /// The value of an integral constant expression as computed by the compiler.
+    class cpp_integral_value
+    {
+    public:
+        /// \returns A value of a signed type.
+        static cpp_integral_value make_signed(std::int64_t value) noexcept
+        {
+            return cpp_integral_value(static_cast<std::uint64_t>(value), true);
+        }
+
+        /// \returns A value of an unsigned type.
+        static cpp_integral_value make_unsigned(std::uint64_t value) noexcept
+        {
+            return cpp_integral_value(value, false);
+        }
+
+        /// \returns Whether or not the value has a signed type.
+        bool is_signed() const noexcept
+        {
+            return signed_;
+        }
+
+        /// \returns Whether or not the value is less than zero.
+        bool is_negative() const noexcept
+        {
+            return signed_ && signed_value() < 0;
+        }
+
+        /// \returns The value as signed integer.
+        /// \notes Unsigned values that don't fit wrap around.
+        std::int64_t signed_value() const noexcept
+        {
+            return value_ <= std::uint64_t(INT64_MAX) ? std::int64_t(value_) :
+                                                        -std::int64_t(~value_) - 1;
+        }
+
+        /// \returns The value as unsigned integer.
+        /// \notes Negative values wrap around.
+        std::uint64_t unsigned_value() const noexcept
+        {
+            return value_;
+        }
+
+    private:
+        cpp_integral_value(std::uint64_t value, bool is_signed) noexcept
+        : value_(value), signed_(is_signed)
+        {
+        }
+
+        std::uint64_t value_;
+        bool          signed_;
+    };
+
+    /// \returns Whether or not both values are mathematically equal, regardless of the signedness of their types.
+    inline bool operator==(const cpp_integral_value& lhs, const cpp_integral_value& rhs) noexcept
+    {
+        return lhs.is_negative() == rhs.is_negative()
+               && lhs.unsigned_value() == rhs.unsigned_value();
+    }
+
+    /// \returns Whether or not both values are mathematically different.
+    inline bool operator!=(const cpp_integral_value& lhs, const cpp_integral_value& rhs) noexcept
+    {
+        return !(lhs == rhs);
+    }
+
+    /// \returns Whether or not the first value is mathematically less than the second one.
+    inline bool operator<(const cpp_integral_value& lhs, const cpp_integral_value& rhs) noexcept
+    {
+        if (lhs.is_negative() != rhs.is_negative())
+            return lhs.is_negative();
+        else if (lhs.is_negative())
+            return lhs.signed_value() < rhs.signed_value();
+        else
+            return lhs.unsigned_value() < rhs.unsigned_value();
+    }
+
     /// Base class for all C++ expressions.
     class cpp_expression
     {
@@ -42,6 +122,13 @@ namespace cppast
             return *type_;
         }
 
+        /// \returns The value of the expression, if it is an integral constant expression the parser could evaluate.
+        /// \notes Expressions that depend on template parameters are not evaluated.
+        const type_safe::optional<cpp_integral_value>& evaluated_value() const noexcept
+        {
+            return evaluated_;
+        }
+
         /// \returns The specified user data.
         void* user_data() const noexcept
         {
@@ -60,9 +147,11 @@ namespace cppast
         }
 
     protected:
-        /// \effects Creates it given the type.
+        /// \effects Creates it given the type and the evaluated value, if there is one.
         /// \requires The type must not be `nullptr`.
-        cpp_expression(std::unique_ptr<cpp_type> type) : type_(std::move(type)), user_data_(nullptr)
+        cpp_expression(std::unique_ptr<cpp_type>               type,
+                       type_safe::optional<cpp_integral_value> evaluated)
+        : type_(std::move(type)), evaluated_(std::move(evaluated)), user_data_(nullptr)
         {
             DEBUG_ASSERT(type_ != nullptr, detail::precondition_error_handler{});
         }
@@ -71,8 +160,9 @@ namespace cppast
         /// \returns The [cppast::cpp_expression_kind]().
         virtual cpp_expression_kind do_get_kind() const noexcept = 0;
 
-        std::unique_ptr<cpp_type>  type_;
-        mutable std::atomic<void*> user_data_;
+        std::unique_ptr<cpp_type>               type_;
+        type_safe::optional<cpp_integral_value> evaluated_;
+        mutable std::atomic<void*>              user_data_;
     };
 
     /// An unexposed [cppast::cpp_expression]().
@@ -82,22 +172,37 @@ namespace cppast
     {
     public:
         /// \returns A newly created unexposed expression.
-        static std::unique_ptr<cpp_unexposed_expression> build(std::unique_ptr<cpp_type> type,
-                                                               cpp_token_string          str)
+        static std::unique_ptr<cpp_unexposed_expression> build(
+            std::unique_ptr<cpp_type> type, cpp_token_string str,
+            type_safe::optional<cpp_integral_value> evaluated = type_safe::nullopt)
+        {
+            return std::unique_ptr<cpp_unexposed_expression>(
+                new cpp_unexposed_expression(std::move(type), std::move(str),
+                                             std::move(evaluated)));
+        }
+
+        /// \returns A newly created unexposed expression,
+        /// whose string is only tokenized when it is accessed.
+        /// \notes This function is used by the parser.
+        static std::unique_ptr<cpp_unexposed_expression> build(
+            std::unique_ptr<cpp_type> type, detail::lazy_token_string str,
+            type_safe::optional<cpp_integral_value> evaluated = type_safe::nullopt)
         {
             return std::unique_ptr<cpp_unexposed_expression>(
-                new cpp_unexposed_expression(std::move(type), std::move(str)));
+                new cpp_unexposed_expression(std::move(type), std::move(str),
+                                             std::move(evaluated)));
         }
 
         /// \returns The expression as a string.
-        const cpp_token_string& expression() const noexcept
+        const cpp_token_string& expression() const
         {
-            return str_;
+            return str_.get();
         }
 
     private:
-        cpp_unexposed_expression(std::unique_ptr<cpp_type> type, cpp_token_string str)
-        : cpp_expression(std::move(type)), str_(std::move(str))
+        cpp_unexposed_expression(std::unique_ptr<cpp_type> type, detail::lazy_token_string str,
+                                 type_safe::optional<cpp_integral_value> evaluated)
+        : cpp_expression(std::move(type), std::move(evaluated)), str_(std::move(str))
         {
         }
 
@@ -106,7 +211,7 @@ namespace cppast
             return cpp_expression_kind::unexposed_t;
         }
 
-        cpp_token_string str_;
+        detail::lazy_token_string str_;
     };
 
     /// A [cppast::cpp_expression]() that is a literal.
@@ -114,11 +219,13 @@ namespace cppast
     {
     public:
         /// \returns A newly created literal expression.
-        static std::unique_ptr<cpp_literal_expression> build(std::unique_ptr<cpp_type> type,
-                                                             std::string               value)
+        static std::unique_ptr<cpp_literal_expression> build(
+            std::unique_ptr<cpp_type> type, std::string value,
+            type_safe::optional<cpp_integral_value> evaluated = type_safe::nullopt)
         {
             return std::unique_ptr<cpp_literal_expression>(
-                new cpp_literal_expression(std::move(type), std::move(value)));
+                new cpp_literal_expression(std::move(type), std::move(value),
+                                           std::move(evaluated)));
         }
 
         /// \returns The value of the literal, as string.
@@ -128,8 +235,9 @@ namespace cppast
         }
 
     private:
-        cpp_literal_expression(std::unique_ptr<cpp_type> type, std::string value)
-        : cpp_expression(std::move(type)), value_(std::move(value))
+        cpp_literal_expression(std::unique_ptr<cpp_type> type, std::string value,
+                               type_safe::optional<cpp_integral_value> evaluated)
+        : cpp_expression(std::move(type), std::move(evaluated)), value_(std::move(value))
         {
         }
 
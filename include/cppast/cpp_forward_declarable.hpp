@@ -5,6 +5,8 @@
 #ifndef CPPAST_CPP_FORWARD_DECLARABLE_HPP_INCLUDED
 #define CPPAST_CPP_FORWARD_DECLARABLE_HPP_INCLUDED
 
+#include <atomic>
+#include <cstdint>
 #include <type_traits>
 
 #include <type_safe/optional.hpp>
@@ -41,6 +43,22 @@ namespace cppast
             return definition_;
         }
 
+        /// \returns A [ts::optional_ref]() to the definition entity,
+        /// if the current entity is a declaration whose definition has been registered
+        /// in the given [cppast::cpp_entity_index]() as well.
+        /// \notes The definition is stored in the declaration when the index sees both,
+        /// so this function does not need to query the index.
+        /// It returns the same entity as `lookup_definition()` of the index,
+        /// or `nullptr` if the definition isn't stored,
+        /// e.g. because the declaration has been registered in another index first.
+        type_safe::optional_ref<const cpp_entity> definition_entity(
+            const cpp_entity_index& idx) const noexcept
+        {
+            if (definition_index_.load(std::memory_order_acquire) != idx.instance_.load())
+                return nullptr;
+            return type_safe::opt_ref(definition_entity_.load(std::memory_order_acquire));
+        }
+
         /// \returns A reference to the semantic parent of the entity.
         /// This applies only to out-of-line definitions
         /// and is the entity which owns the declaration.
@@ -61,7 +79,7 @@ namespace cppast
         /// \effects Marks the entity as definition.
         /// \notes If it is not a definition,
         /// [*set_definition]() must be called.
-        cpp_forward_declarable() noexcept = default;
+        cpp_forward_declarable() noexcept : definition_index_(0u), definition_entity_(nullptr) {}
 
         ~cpp_forward_declarable() noexcept = default;
 
@@ -79,13 +97,32 @@ namespace cppast
         }
 
     private:
-        type_safe::optional<cpp_entity_ref> semantic_parent_;
-        type_safe::optional<cpp_entity_id>  definition_;
+        // only the first index that stores a definition uses the cache,
+        // an index stores it only while holding its lock
+        void set_definition_entity(std::uint64_t index, const cpp_entity* def) const noexcept
+        {
+            auto owner = std::uint64_t(0u);
+            if (definition_index_.compare_exchange_strong(owner, index) || owner == index)
+                definition_entity_.store(def, std::memory_order_release);
+        }
+
+        type_safe::optional<cpp_entity_ref>    semantic_parent_;
+        type_safe::optional<cpp_entity_id>     definition_;
+        mutable std::atomic<std::uint64_t>     definition_index_; // instance of the owning index
+        mutable std::atomic<const cpp_entity*> definition_entity_;
+
+        friend cpp_entity_index;
     };
 
     /// \returns Whether or not the given entity is a definition.
     bool is_definition(const cpp_entity& e) noexcept;
 
+    /// \returns A [ts::optional_ref]() to the [cppast::cpp_forward_declarable]() base of the given entity,
+    /// or `nullptr` if it is not forward declarable.
+    /// \notes For templates it returns the base of the entity being templated.
+    type_safe::optional_ref<const cpp_forward_declarable> get_forward_declarable(
+        const cpp_entity& e) noexcept;
+
     class cpp_enum;
     class cpp_class;
     class cpp_variable;
@@ -95,7 +132,9 @@ namespace cppast
     /// \returns A [ts::optional_ref]() to the entity that is the definition.
     /// If the entity is a definition or not derived from [cppast::cpp_forward_declarable]() (only valid for the generic entity overload),
     /// returns a reference to the entity itself.
-    /// Otherwise lookups the definition id and returns it.
+    /// Otherwise returns the definition the index has stored in the declaration,
+    /// see [cppast::cpp_forward_declarable::definition_entity](),
+    /// or looks it up in `idx` if there is none.
     /// \notes The return value will only be `nullptr`, if the definition is not registered.
     /// \group get_definition
     type_safe::optional_ref<const cpp_entity> get_definition(const cpp_entity_index& idx,
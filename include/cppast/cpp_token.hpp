@@ -5,6 +5,10 @@
 #ifndef CPPAST_CPP_TOKEN_HPP_INCLUDED
 #define CPPAST_CPP_TOKEN_HPP_INCLUDED
 
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -24,6 +28,138 @@ namespace cppast
         punctuation     //< Any other punctuation.
     };
 
+    /// The spelling of a token in a [cppast::cpp_token_string]().
+    ///
+    /// It refers to the characters stored in the token string,
+    /// so it is only valid as long as the string is.
+    class cpp_token_spelling
+    {
+    public:
+        /// \effects Creates it giving the characters, which must be null-terminated.
+        cpp_token_spelling(const char* str, std::size_t length) noexcept
+        : str_(str), length_(length)
+        {
+        }
+
+        /// \returns The null-terminated spelling.
+        const char* c_str() const noexcept
+        {
+            return str_;
+        }
+
+        /// \returns The number of characters.
+        std::size_t length() const noexcept
+        {
+            return length_;
+        }
+
+        /// \returns The number of characters.
+        std::size_t size() const noexcept
+        {
+            return length_;
+        }
+
+        /// \returns Whether or not the spelling is empty.
+        bool empty() const noexcept
+        {
+            return length_ == 0u;
+        }
+
+        /// \returns The character at the given index.
+        /// \requires `i < length()`.
+        char operator[](std::size_t i) const noexcept
+        {
+            return str_[i];
+        }
+
+        /// \returns The first character.
+        /// \requires `!empty()`.
+        char front() const noexcept
+        {
+            return str_[0u];
+        }
+
+        /// \returns The last character.
+        /// \requires `!empty()`.
+        char back() const noexcept
+        {
+            return str_[length_ - 1u];
+        }
+
+        /// \returns An iterator to the first character.
+        const char* begin() const noexcept
+        {
+            return str_;
+        }
+
+        /// \returns An iterator one past the last character.
+        const char* end() const noexcept
+        {
+            return str_ + length_;
+        }
+
+        /// \returns A copy of the spelling.
+        operator std::string() const
+        {
+            return std::string(str_, length_);
+        }
+
+    private:
+        const char* str_;
+        std::size_t length_;
+    };
+
+    /// \returns Whether or not the spellings are equal.
+    inline bool operator==(const cpp_token_spelling& lhs, const cpp_token_spelling& rhs) noexcept
+    {
+        return lhs.length() == rhs.length()
+               && std::memcmp(lhs.c_str(), rhs.c_str(), lhs.length()) == 0;
+    }
+
+    /// \returns Whether or not the spelling is equal to the string.
+    inline bool operator==(const cpp_token_spelling& lhs, const char* rhs) noexcept
+    {
+        return std::strncmp(lhs.c_str(), rhs, lhs.length()) == 0 && rhs[lhs.length()] == '\0';
+    }
+
+    /// \returns Whether or not the spelling is equal to the string.
+    inline bool operator==(const char* lhs, const cpp_token_spelling& rhs) noexcept
+    {
+        return rhs == lhs;
+    }
+
+    /// \returns Whether or not the spelling is equal to the string.
+    inline bool operator==(const cpp_token_spelling& lhs, const std::string& rhs) noexcept
+    {
+        return lhs == cpp_token_spelling(rhs.c_str(), rhs.length());
+    }
+
+    /// \returns Whether or not the spelling is equal to the string.
+    inline bool operator==(const std::string& lhs, const cpp_token_spelling& rhs) noexcept
+    {
+        return rhs == lhs;
+    }
+
+    /// \returns Whether or not the spelling is different from the other one.
+    template <typename T>
+    bool operator!=(const cpp_token_spelling& lhs, const T& rhs) noexcept
+    {
+        return !(lhs == rhs);
+    }
+
+    /// \returns Whether or not the spelling is different from the other one.
+    template <typename T>
+    bool operator!=(const T& lhs, const cpp_token_spelling& rhs) noexcept
+    {
+        return !(lhs == rhs);
+    }
+
+    /// \returns Whether or not the spellings are different.
+    inline bool operator!=(const cpp_token_spelling& lhs, const cpp_token_spelling& rhs) noexcept
+    {
+        return !(lhs == rhs);
+    }
+
     /// A C++ token.
     struct cpp_token
     {
@@ -46,9 +182,69 @@ namespace cppast
         }
     };
 
+    /// A reference to a C++ token in a [cppast::cpp_token_string]().
+    ///
+    /// It has the same members as a [cppast::cpp_token](),
+    /// but doesn't own the spelling.
+    struct cpp_token_view
+    {
+        cpp_token_spelling spelling;
+        cpp_token_kind     kind;
+
+        cpp_token_view(cpp_token_kind kind, cpp_token_spelling spelling) noexcept
+        : spelling(spelling), kind(kind)
+        {
+        }
+
+        /// \returns A copy of the token.
+        operator cpp_token() const
+        {
+            return cpp_token(kind, spelling);
+        }
+
+        friend bool operator==(const cpp_token_view& lhs, const cpp_token_view& rhs) noexcept
+        {
+            return lhs.spelling == rhs.spelling;
+        }
+
+        friend bool operator==(const cpp_token_view& lhs, const cpp_token& rhs) noexcept
+        {
+            return lhs.spelling == rhs.spelling;
+        }
+
+        friend bool operator==(const cpp_token& lhs, const cpp_token_view& rhs) noexcept
+        {
+            return rhs == lhs;
+        }
+
+        friend bool operator!=(const cpp_token_view& lhs, const cpp_token_view& rhs) noexcept
+        {
+            return !(lhs == rhs);
+        }
+
+        friend bool operator!=(const cpp_token_view& lhs, const cpp_token& rhs) noexcept
+        {
+            return !(lhs == rhs);
+        }
+
+        friend bool operator!=(const cpp_token& lhs, const cpp_token_view& rhs) noexcept
+        {
+            return !(lhs == rhs);
+        }
+    };
+
     /// A combination of multiple C++ tokens.
+    ///
+    /// The spellings of all tokens are stored in a single buffer,
+    /// the tokens are accessed as [cppast::cpp_token_view]() objects.
     class cpp_token_string
     {
+        struct token_info
+        {
+            std::uint32_t  offset; // of the spelling in the buffer
+            cpp_token_kind kind;
+        };
+
     public:
         /// Builds a token string.
         class builder
@@ -57,9 +253,17 @@ namespace cppast
             builder() = default;
 
             /// \effects Adds a token.
-            void add_token(cpp_token tok)
+            void add_token(const cpp_token& tok)
+            {
+                add_token(tok.kind, tok.spelling.c_str(), tok.spelling.length());
+            }
+
+            /// \effects Adds a token given its kind and spelling.
+            void add_token(cpp_token_kind kind, const char* spelling, std::size_t length)
             {
-                tokens_.push_back(std::move(tok));
+                tokens_.push_back(token_info{std::uint32_t(buffer_.size()), kind});
+                buffer_.append(spelling, length);
+                buffer_ += '\0';
             }
 
             /// \effects Converts a trailing `>>` to `>` token.
@@ -68,11 +272,12 @@ namespace cppast
             /// \returns The finished string.
             cpp_token_string finish()
             {
-                return cpp_token_string(std::move(tokens_));
+                return cpp_token_string(std::move(buffer_), tokens_);
             }
 
         private:
-            std::vector<cpp_token> tokens_;
+            std::string             buffer_; // each spelling is followed by a null character
+            std::vector<token_info> tokens_;
         };
 
         /// Tokenizes a string.
@@ -82,10 +287,16 @@ namespace cppast
         static cpp_token_string tokenize(std::string str);
 
         /// \effects Creates it from a sequence of tokens.
-        cpp_token_string(std::vector<cpp_token> tokens) : tokens_(std::move(tokens)) {}
+        cpp_token_string(const std::vector<cpp_token>& tokens)
+        {
+            builder b;
+            for (auto& tok : tokens)
+                b.add_token(tok);
+            *this = b.finish();
+        }
 
         /// \exclude target
-        using iterator = std::vector<cpp_token>::const_iterator;
+        using iterator = std::vector<cpp_token_view>::const_iterator;
 
         /// \returns An iterator to the first token.
         iterator begin() const noexcept
@@ -105,14 +316,20 @@ namespace cppast
             return tokens_.empty();
         }
 
+        /// \returns The number of tokens.
+        std::size_t size() const noexcept
+        {
+            return tokens_.size();
+        }
+
         /// \returns A reference to the first token.
-        const cpp_token& front() const noexcept
+        const cpp_token_view& front() const noexcept
         {
             return tokens_.front();
         }
 
         /// \returns A reference to the last token.
-        const cpp_token& back() const noexcept
+        const cpp_token_view& back() const noexcept
         {
             return tokens_.back();
         }
@@ -121,7 +338,11 @@ namespace cppast
         std::string as_string() const;
 
     private:
-        std::vector<cpp_token> tokens_;
+        cpp_token_string(std::string buffer, const std::vector<token_info>& tokens);
+
+        // shared by the copies, it is never modified, so the views stay valid
+        std::shared_ptr<const std::string> buffer_; // nullptr if there are no tokens
+        std::vector<cpp_token_view>        tokens_;
 
         friend bool operator==(const cpp_token_string& lhs, const cpp_token_string& rhs);
     };
@@ -132,6 +353,45 @@ namespace cppast
     {
         return !(lhs == rhs);
     }
+
+    namespace detail
+    {
+        // a token string that is either tokenized already,
+        // or a slice of a source buffer that is only tokenized when it is accessed
+        class lazy_token_string
+        {
+        public:
+            lazy_token_string(cpp_token_string str)
+            : eager_(std::move(str)), offset_(0u), length_(0u)
+            {
+            }
+
+            // the slice must consist of valid tokens, see cpp_token_string::tokenize()
+            lazy_token_string(std::shared_ptr<const std::string> buffer, std::uint32_t offset,
+                              std::uint32_t length)
+            : eager_(cpp_token_string::builder().finish()),
+              buffer_(std::move(buffer)),
+              offset_(offset),
+              length_(length)
+            {
+            }
+
+            // tokenizes a slice on the first call, thread safe
+            const cpp_token_string& get() const
+            {
+                return buffer_ ? get_slice() : eager_;
+            }
+
+        private:
+            const cpp_token_string& get_slice() const;
+
+            cpp_token_string eager_; // empty for a slice
+            // shared by all slices of a file, nullptr if tokenized already
+            std::shared_ptr<const std::string>              buffer_;
+            mutable std::shared_ptr<const cpp_token_string> slice_tokens_; // once tokenized
+            std::uint32_t                                   offset_, length_;
+        };
+    } // namespace detail
 } // namespace cppast
 
 #endif // CPPAST_CPP_TOKEN_HPP_INCLUDED
@@ -0,0 +1,124 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#ifndef CPPAST_LAZY_ENTITY_INDEX_HPP_INCLUDED
+#define CPPAST_LAZY_ENTITY_INDEX_HPP_INCLUDED
+
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <type_safe/optional_ref.hpp>
+
+#include <cppast/cpp_entity_index.hpp>
+#include <cppast/cpp_entity_index_snapshot.hpp>
+
+namespace cppast
+{
+    class cpp_entity;
+    class cpp_file;
+
+    /// An index over the entities of a whole project that loads the files only when needed.
+    ///
+    /// It uses a [cppast::cpp_entity_index_snapshot]() to find the file an entity lives in,
+    /// and materializes that file using a loader function on first access,
+    /// e.g. by parsing it again.
+    /// Files that weren't accessed recently are unloaded once the loaded files exceed a budget.
+    /// The entities are returned as owning pointers that keep their file alive,
+    /// so they stay valid even if their file is unloaded in the mean time.
+    /// \notes Don't [cppast::link]() the loaded files, linked references into unloaded files would dangle.
+    class lazy_entity_index
+    {
+    public:
+        /// The function used to load a file.
+        /// It is given the name of the file and the index the entities must be registered in,
+        /// and returns the file or `nullptr` if it could not be loaded.
+        /// It is called without holding a lock, so different files can be loaded in parallel.
+        /// For example, it can be a call to [cppast::parser::parse]().
+        using loader = std::function<std::unique_ptr<cpp_file>(const std::string&     path,
+                                                               const cpp_entity_index& idx)>;
+
+        /// \effects Creates it using the given snapshot and loader.
+        /// Loaded files are unloaded in least recently used order once they contain more than `entity_budget` entities in total,
+        /// the most recently used file is always kept.
+        lazy_entity_index(cpp_entity_index_snapshot snapshot, loader l, std::size_t entity_budget)
+        : idx_(true),
+          snapshot_(std::move(snapshot)),
+          loader_(std::move(l)),
+          budget_(entity_budget),
+          used_(0u)
+        {
+        }
+
+        lazy_entity_index(const lazy_entity_index&) = delete;
+        lazy_entity_index& operator=(const lazy_entity_index&) = delete;
+
+        ~lazy_entity_index() noexcept;
+
+        /// \returns The same as [cppast::cpp_entity_index::lookup](),
+        /// loading the file the entity lives in if necessary, or `nullptr` if there is none.
+        /// \notes The pointer keeps the file of the entity alive,
+        /// but once it is unloaded, its entities are no longer registered in the index.
+        /// \notes This operation is thread safe.
+        std::shared_ptr<const cpp_entity> lookup(const cpp_entity_id& id);
+
+        /// \returns The same as [cppast::cpp_entity_index::lookup_definition](),
+        /// loading the file the definition lives in if necessary, or `nullptr` if there is none.
+        /// \notes The pointer keeps the file of the definition alive.
+        /// \notes This operation is thread safe.
+        std::shared_ptr<const cpp_entity> lookup_definition(const cpp_entity_id& id);
+
+        /// \effects Loads the given file, if it isn't loaded already.
+        /// \returns The file or `nullptr`, if the loader failed.
+        /// If another thread is loading the same file, waits for it instead of loading it again.
+        /// \notes The pointer keeps the file alive.
+        /// \notes This operation is thread safe.
+        std::shared_ptr<const cpp_file> load_file(const std::string& path);
+
+        /// \returns The snapshot that is used to locate the entities.
+        const cpp_entity_index_snapshot& snapshot() const noexcept
+        {
+            return snapshot_;
+        }
+
+        /// \returns The number of files that are currently loaded.
+        std::size_t loaded_files() const noexcept;
+
+        /// \returns The number of entities in the files that are currently loaded.
+        std::size_t loaded_entities() const noexcept;
+
+    private:
+        struct loaded_file
+        {
+            std::string               path;
+            std::shared_ptr<cpp_file> file;
+            std::size_t               entity_count;
+        };
+
+        using lru_list = std::list<loaded_file>;
+
+        std::shared_ptr<const cpp_file> load_file_impl(std::unique_lock<std::mutex>& lock,
+                                                       const std::string&            path);
+        std::shared_ptr<const cpp_entity> touch(type_safe::optional_ref<const cpp_entity> e);
+        void                              evict();
+
+        cpp_entity_index          idx_;
+        cpp_entity_index_snapshot snapshot_;
+        loader                    loader_;
+        std::size_t               budget_, used_;
+
+        mutable std::mutex                                       mutex_;
+        lru_list                                                 files_; // most recently used first
+        std::unordered_map<std::string, lru_list::iterator>     paths_;
+        std::unordered_map<const cpp_file*, lru_list::iterator> loaded_;
+        // the files that are currently loaded by some thread
+        std::unordered_map<std::string, std::shared_future<std::shared_ptr<cpp_file>>> loading_;
+    };
+} // namespace cppast
+
+#endif // CPPAST_LAZY_ENTITY_INDEX_HPP_INCLUDED
@@ -5,8 +5,11 @@
 #ifndef CPPAST_LIBCLANG_PARSER_HPP_INCLUDED
 #define CPPAST_LIBCLANG_PARSER_HPP_INCLUDED
 
+#include <functional>
+#include <map>
 #include <stdexcept>
 
+#include <cppast/cpp_entity_kind.hpp>
 #include <cppast/parser.hpp>
 
 namespace cppast
@@ -29,6 +32,26 @@ namespace cppast
             static bool fast_preprocessing(const libclang_compile_config& config);
 
             static bool remove_comments_in_macro(const libclang_compile_config& config);
+
+            static bool parse_comments(const libclang_compile_config& config);
+
+            static bool lazy_unexposed(const libclang_compile_config& config);
+
+            static const std::map<std::string, std::string>& unsaved_files(
+                const libclang_compile_config& config);
+
+            static const std::string& preprocessed_input(const libclang_compile_config& config);
+
+            static const std::string& prelude(const libclang_compile_config& config);
+
+            static const std::string& precompiled_header(const libclang_compile_config& config);
+
+            // writes the whole configuration into a string, so it can be sent to another process
+            static std::string serialize(const libclang_compile_config& config);
+
+            // restores a configuration written by serialize(),
+            // throws libclang_error if it is malformed
+            static libclang_compile_config deserialize(const std::string& data);
         };
 
         void for_each_file(const libclang_compilation_database& database, void* user_data,
@@ -87,6 +110,8 @@ namespace cppast
         friend libclang_compile_config;
         friend void detail::for_each_file(const libclang_compilation_database& database,
                                           void* user_data, void (*callback)(void*, std::string));
+        friend type_safe::optional<std::vector<std::string>> find_dependencies_for(
+            const libclang_compilation_database& database, const std::string& file_name);
     };
 
     /// Compilation config for the [cppast::libclang_parser]().
@@ -155,7 +180,85 @@ namespace cppast
             remove_comments_in_macro_ = b;
         }
 
+        /// \effects Sets whether or not documentation comments are collected.
+        /// Default value is `true`.
+        /// \notes If this is `false`, the preprocessor removes all comments,
+        /// so no entity has a [cppast::cpp_entity::comment]() and there are no unmatched comments.
+        /// Disable it if you don't need the comments, as it makes preprocessing faster.
+        void parse_comments(bool b) noexcept
+        {
+            parse_comments_ = b;
+        }
+
+        /// \effects Sets whether or not the spellings of unexposed entities and expressions are tokenized lazily.
+        /// Default value is `false`.
+        /// \notes If this is `true`, the preprocessed source of the file is kept alive as long as any of those entities,
+        /// and they only store their position in it.
+        /// The tokens are created the first time [cppast::cpp_unexposed_entity::spelling]()
+        /// or [cppast::cpp_unexposed_expression::expression]() is called,
+        /// which saves time and memory if most of them are never looked at.
+        void lazy_unexposed(bool b) noexcept
+        {
+            lazy_unexposed_ = b;
+        }
+
+        /// \effects Adds a file that only exists in memory,
+        /// or replaces the contents of the file on disk with the same name.
+        /// It can be the file being parsed or a file it includes,
+        /// both the preprocessor and libclang will use the given contents instead of reading the file.
+        /// This allows parsing unsaved editor buffers or code snippets without writing them to disk.
+        /// \notes The name must be the one used to parse or include the file.
+        /// A relative name is relative to the current working directory.
+        /// \notes The external preprocessor can't read memory,
+        /// so the contents are still written to temporary files that are passed to it using `-ivfsoverlay`.
+        void add_unsaved_file(std::string path, std::string contents)
+        {
+            unsaved_files_[std::move(path)] = std::move(contents);
+        }
+
+        /// \effects Sets a file that already contains the preprocessed source of the file being parsed,
+        /// like the `.ii` file written by `-save-temps`.
+        /// The preprocessor is then not invoked at all,
+        /// the includes, macros and comments are recovered from the preprocessed file.
+        /// An empty path disables it, which is the default.
+        /// \notes The file must have been created by `clang -E` with the same flags as the configuration,
+        /// and it must contain linemarkers.
+        /// Macros are only available if it was created with `-dD`, comments only with `-C` or `-CC`,
+        /// and include directives are recreated from the linemarkers unless it was created with `-Xclang -dI`.
+        /// \notes libclang still parses the main file with its includes,
+        /// so they must be available using the configured include directories.
+        void set_preprocessed_input(std::string path)
+        {
+            preprocessed_input_ = std::move(path);
+        }
+
+        /// \effects Sets a header that is included before the file being parsed, like `-include`.
+        /// An empty path disables it, which is the default.
+        /// \notes The [cppast::libclang_parser]() precompiles the prelude once for each distinct set of flags,
+        /// and libclang uses the precompiled header for every file parsed with those flags.
+        /// Put the headers every file includes into it, so that they are only parsed once.
+        /// The preprocessor includes the prelude normally, so the macros are the same.
+        /// \notes The prelude is ignored if a precompiled header is set as well.
+        void set_prelude(std::string header)
+        {
+            prelude_ = std::move(header);
+        }
+
+        /// \effects Sets a precompiled header that is used when parsing, like `-include-pch`.
+        /// An empty path disables it, which is the default.
+        /// \notes The precompiled header is passed to both the preprocessor and libclang,
+        /// so it must have been created by the same version of clang with compatible flags.
+        /// \notes When the configuration is created from a compilation database,
+        /// this is set from `-include-pch` and the prelude from the first `-include`.
+        void set_precompiled_header(std::string path)
+        {
+            precompiled_header_ = std::move(path);
+        }
+
     private:
+        // creates a configuration with exactly the given flags and default options
+        explicit libclang_compile_config(std::vector<std::string> flags);
+
         void do_set_flags(cpp_standard standard, compile_flags flags) override;
 
         void do_add_include_dir(std::string path) override;
@@ -169,11 +272,18 @@ namespace cppast
             return "libclang";
         }
 
+        std::map<std::string, std::string> unsaved_files_;
+        std::string                        preprocessed_input_;
+        std::string                        prelude_;
+        std::string                        precompiled_header_;
+
         std::string clang_binary_;
         int         clang_version_;
         bool        write_preprocessed_ : 1;
         bool        fast_preprocessing_ : 1;
         bool        remove_comments_in_macro_ : 1;
+        bool        parse_comments_ : 1;
+        bool        lazy_unexposed_ : 1;
 
         friend detail::libclang_compile_config_access;
     };
@@ -187,6 +297,78 @@ namespace cppast
     type_safe::optional<libclang_compile_config> find_config_for(
         const libclang_compilation_database& database, std::string file_name);
 
+    /// Finds the files a file includes using the dependency file written by the build system.
+    ///
+    /// The dependency file is the Make-style `.d` file written by the compile command in the database:
+    /// either the file given with `-MF`, or, if `-MD` or `-MMD` is used,
+    /// the object file given with `-o` with the extension replaced by `.d`.
+    /// \returns The prerequisites of the dependency file without the file itself,
+    /// i.e. all files it includes directly or indirectly, with relative paths completed using the directory of the command.
+    /// If the database contains no command for the file that writes a dependency file or it doesn't exist,
+    /// returns an empty optional.
+    /// \notes This doesn't run the preprocessor,
+    /// so it can be used to decide whether a file needs to be parsed again.
+    /// The result is only as recent as the last build.
+    type_safe::optional<std::vector<std::string>> find_dependencies_for(
+        const libclang_compilation_database& database, const std::string& file_name);
+
+    /// Information about an entity the [cppast::libclang_parser]() is about to parse,
+    /// passed to its [cppast::libclang_parser::entity_filter]().
+    class libclang_entity_info
+    {
+    public:
+        /// Function that computes whether the entity described by `data` has attributes.
+        using attribute_checker = bool (*)(const void* data);
+
+        /// \effects Creates it giving the kind, name and the function to check for attributes,
+        /// which is only called when [*has_attributes]() is.
+        /// \notes This is used by the parser, there is no need to create it yourself.
+        libclang_entity_info(cpp_entity_kind kind, const char* name, attribute_checker checker,
+                             const void* data) noexcept
+        : kind_(kind), name_(name), checker_(checker), data_(data), has_attributes_(unknown)
+        {
+        }
+
+        /// \returns The kind of the entity that will be created.
+        /// \notes Template specializations are reported with the kind of the primary template,
+        /// and entities cppast doesn't know are reported as [cppast::cpp_entity_kind::unexposed_t]().
+        cpp_entity_kind kind() const noexcept
+        {
+            return kind_;
+        }
+
+        /// \returns The name of the entity.
+        const char* name() const noexcept
+        {
+            return name_;
+        }
+
+        /// \returns Whether there are attributes in front of the name,
+        /// like `[[attr]] void f();` or `struct [[attr]] foo {};`.
+        /// \notes This requires tokenizing the declaration,
+        /// so it is only computed if it is called.
+        bool has_attributes() const
+        {
+            if (has_attributes_ == unknown)
+                has_attributes_ = checker_(data_) ? yes : no;
+            return has_attributes_ == yes;
+        }
+
+    private:
+        enum attribute_state : unsigned char
+        {
+            unknown,
+            yes,
+            no,
+        };
+
+        cpp_entity_kind         kind_;
+        const char*             name_;
+        attribute_checker       checker_;
+        const void*             data_;
+        mutable attribute_state has_attributes_;
+    };
+
     /// A parser that uses libclang.
     class libclang_parser final : public parser
     {
@@ -201,12 +383,67 @@ namespace cppast
 
         ~libclang_parser() noexcept override;
 
+        /// \effects Sets whether the threads libclang creates while parsing run with background priority.
+        /// `indexing` affects the parsing of translation units, `editing` code completion and reparsing.
+        /// \notes Concurrent calls to `parse()` use separate libclang indices from a pool,
+        /// the option applies to every parse started afterwards.
+        void use_background_priority(bool indexing, bool editing = false);
+
+        /// \effects Sets the directory where libclang writes the compiler invocation of each translation unit before parsing it,
+        /// so that a libclang crash can be reproduced.
+        /// An empty path disables it, which is the default.
+        /// \notes This requires libclang 6.0 or higher, otherwise it has no effect.
+        /// \notes Like [*use_background_priority](), it applies to every parse started afterwards.
+        void set_invocation_emission_path(std::string path);
+
+        /// The function that decides whether an entity is parsed.
+        using entity_filter = std::function<bool(const libclang_entity_info&)>;
+
+        /// \effects Sets the filter that decides which entities are parsed.
+        /// Before a declaration is parsed, the filter is called with cheap information about it.
+        /// If it returns `false`, the declaration is skipped,
+        /// before any tokenization or type parsing happens.
+        /// Namespaces and language linkage specifications are always parsed,
+        /// the filter is only called for their members.
+        /// The members of a rejected class or class template are still visited and filtered,
+        /// if any of them is accepted, the class is kept as a scope for them:
+        /// a [cppast::cpp_class]() that has only a name, kind, access specifiers
+        /// and the accepted members, and which isn't registered in the index.
+        /// The members of an accepted class are all parsed, unless `filter_members` is `true`.
+        /// \notes An empty filter parses everything, which is the default.
+        /// \notes This function must not be called while a file is being parsed.
+        void set_entity_filter(entity_filter filter, bool filter_members = false)
+        {
+            filter_         = std::move(filter);
+            filter_members_ = filter_members;
+        }
+
+        /// The function that is given the entities parsed by [*parse_streaming]().
+        using entity_consumer = std::function<void(std::unique_ptr<cpp_entity>)>;
+
+        /// \effects Parses the given file like [cppast::parser::parse](),
+        /// but instead of building a [cppast::cpp_file](),
+        /// it passes each top-level entity to the `consumer` as soon as it has been parsed.
+        /// The consumer takes ownership of the entity and can keep, transform or drop it.
+        /// If `idx` is set, the entities are registered in it and must live as long as the index;
+        /// otherwise they aren't registered anywhere,
+        /// so memory usage doesn't grow with the file unless the consumer keeps the entities.
+        /// \returns `false` if a fatal error occurred, `true` otherwise.
+        /// \notes The entities have no parent, so the file isn't part of their [cppast::full_name]().
+        /// Unmatched documentation comments are dropped.
+        /// \notes This function is thread safe.
+        bool parse_streaming(type_safe::optional_ref<const cpp_entity_index> idx,
+                             const std::string& path, const libclang_compile_config& config,
+                             const entity_consumer& consumer) const;
+
     private:
         std::unique_ptr<cpp_file> do_parse(const cpp_entity_index& idx, std::string path,
                                            const compile_config& config) const override;
 
         struct impl;
         std::unique_ptr<impl> pimpl_;
+        entity_filter         filter_;
+        bool                  filter_members_;
     };
 
     /// Parses multiple files using a [cppast::libclang_parser]() and a compilation database.
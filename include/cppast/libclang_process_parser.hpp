@@ -0,0 +1,107 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#ifndef CPPAST_LIBCLANG_PROCESS_PARSER_HPP_INCLUDED
+#define CPPAST_LIBCLANG_PROCESS_PARSER_HPP_INCLUDED
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <cppast/libclang_parser.hpp>
+
+namespace cppast
+{
+    /// The result of [cppast::libclang_process_parser::parse]().
+    struct libclang_process_result
+    {
+        std::vector<std::string> parsed;    //< The files that have been parsed.
+        std::vector<std::string> failed;    //< The files where a fatal error occurred.
+        std::vector<std::string> crashed;   //< The files skipped as the worker crashed on the last attempt.
+        std::vector<std::string> timed_out; //< The files skipped as the worker timed out on the last attempt.
+    };
+
+    /// Parses many files using a pool of worker processes.
+    ///
+    /// Each worker process owns its own [cppast::libclang_parser]()
+    /// and receives the files to parse over a pipe.
+    /// If libclang crashes or the parser aborts or hangs while parsing a file,
+    /// only the worker dies:
+    /// a new worker is started and the file is tried again or skipped.
+    ///
+    /// The workers are new instances of a program started using `posix_spawn()`,
+    /// by default the program that is currently running.
+    /// That program must call [*run_worker]() at the beginning of `main()`.
+    ///
+    /// As the ASTs live in the worker processes,
+    /// the result of a run is a [cppast::cpp_entity_index_snapshot]() containing all entities of all files.
+    /// Use it together with a [cppast::lazy_entity_index]() to load the ASTs that are actually needed.
+    /// \notes This requires a POSIX system, on other systems [*parse]() throws a [cppast::libclang_error]().
+    class libclang_process_parser
+    {
+    public:
+        /// A file to parse with the configuration to use.
+        struct job
+        {
+            std::string             path;
+            libclang_compile_config config;
+        };
+
+        /// \effects Creates it giving the number of worker processes and how often a file is parsed,
+        /// before it is skipped because the worker crashed or timed out each time.
+        /// Crashes and timeouts are logged using the given logger.
+        /// \requires `no_workers` and `max_attempts` must not be `0`.
+        libclang_process_parser(type_safe::object_ref<const diagnostic_logger> logger,
+                                unsigned no_workers, unsigned max_attempts = 2u);
+
+        /// \effects Runs the worker and exits the process, if the process has been started as a worker by [*parse]().
+        /// Otherwise, does nothing.
+        /// The [cppast::libclang_parser]() of the worker uses the given filter,
+        /// see [cppast::libclang_parser::set_entity_filter]() for it and `filter_members`,
+        /// and logs using the [cppast::default_logger]().
+        /// \notes Call it at the beginning of `main()`, before anything else happens,
+        /// in every program that is used as worker executable.
+        static void run_worker(int argc, char* argv[], libclang_parser::entity_filter filter = {},
+                               bool filter_members = false);
+
+        /// \effects Sets the program that is started for each worker,
+        /// it must call [*run_worker]().
+        /// The default is the program that is currently running,
+        /// on systems where it can't be determined, it must be set.
+        void set_worker_executable(std::string path)
+        {
+            executable_ = std::move(path);
+        }
+
+        /// \effects Sets how long a worker may take for a single file,
+        /// before it is killed and treated like a crash.
+        /// A duration of zero disables the timeout, the default is ten minutes.
+        void set_timeout(std::chrono::milliseconds timeout) noexcept
+        {
+            timeout_ = timeout;
+        }
+
+        /// \effects Parses all the files in the worker processes,
+        /// and writes a snapshot of the entities of all files that could be parsed to `snapshot_path`.
+        /// \returns Which files were parsed and which were skipped.
+        /// \throws [cppast::libclang_error]() if the worker processes could not be started,
+        /// [cppast::snapshot_error]() if the snapshot could not be written.
+        /// \notes The workers write temporary snapshots next to `snapshot_path`, which are removed afterwards.
+        libclang_process_result parse(const std::vector<job>& jobs,
+                                      const std::string&      snapshot_path) const;
+
+    private:
+        type_safe::object_ref<const diagnostic_logger> logger_;
+        std::string                                    executable_;
+        std::chrono::milliseconds                      timeout_;
+        unsigned                                       no_workers_, max_attempts_;
+    };
+
+    /// \returns The jobs to parse all the files specified in a compilation database,
+    /// with the configuration specified in the database.
+    std::vector<libclang_process_parser::job> get_jobs(
+        const libclang_compilation_database& database);
+} // namespace cppast
+
+#endif // CPPAST_LIBCLANG_PROCESS_PARSER_HPP_INCLUDED
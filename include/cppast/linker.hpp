@@ -0,0 +1,45 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#ifndef CPPAST_LINKER_HPP_INCLUDED
+#define CPPAST_LINKER_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include <type_safe/reference.hpp>
+
+namespace cppast
+{
+    class cpp_entity;
+    class cpp_entity_index;
+    class cpp_file;
+
+    /// A reference that could not be resolved by [cppast::link]().
+    struct unresolved_reference
+    {
+        type_safe::object_ref<const cpp_entity> entity; //< The entity that contains the reference.
+        std::string                             name;   //< The name of the reference.
+
+        unresolved_reference(type_safe::object_ref<const cpp_entity> e, std::string n)
+        : entity(e), name(std::move(n))
+        {
+        }
+    };
+
+    /// \effects Links all references in the given file,
+    /// i.e. calls `link()` on every [cppast::basic_cpp_entity_ref]() of the entities and their types.
+    /// Afterwards calls to `get()` of those references with the same index don't need to query it,
+    /// until entities are removed from the index.
+    /// \returns All references that could not be resolved to any entity,
+    /// e.g. because they refer to entities in files that weren't parsed.
+    /// \requires All files must have been parsed and registered in the index.
+    /// \notes Different files can be linked in parallel,
+    /// but a file must not be used by another thread while it is being linked.
+    /// References returned by value, like [cppast::cpp_template_specialization::primary_template](),
+    /// can't be linked.
+    std::vector<unresolved_reference> link(const cpp_entity_index& idx, const cpp_file& file);
+} // namespace cppast
+
+#endif // CPPAST_LINKER_HPP_INCLUDED
@@ -4,12 +4,129 @@
 
 #include <cppast/cpp_entity.hpp>
 
+#include <algorithm>
+
 #include <cppast/cpp_entity_index.hpp>
 #include <cppast/cpp_entity_kind.hpp>
+#include <cppast/cpp_forward_declarable.hpp>
 #include <cppast/cpp_template.hpp>
 
 using namespace cppast;
 
+namespace
+{
+    // see cpp_entity::comment() for the rules
+    void normalize_c_comment(std::string& result, const char* ptr, const char* end,
+                             unsigned column)
+    {
+        auto indent = column + 3u;
+
+        if (ptr != end && *ptr == ' ')
+        {
+            // skip one whitespace at most
+            ++ptr;
+            ++indent;
+        }
+
+        while (ptr != end)
+        {
+            if (*ptr == '\n')
+            {
+                // remove trailing spaces
+                while (!result.empty() && result.back() == ' ')
+                    result.pop_back();
+
+                // skip newline(s)
+                while (ptr != end && *ptr == '\n')
+                {
+                    ++ptr;
+                    result += '\n';
+                }
+
+                // skip indentation
+                auto actual_indent = 0u;
+                for (auto i = 0u; i < indent && ptr != end && *ptr == ' '; ++i)
+                {
+                    ++actual_indent;
+                    ++ptr;
+                }
+
+                auto extra_indent = 0u;
+                while (ptr != end && *ptr == ' ')
+                {
+                    ++extra_indent;
+                    ++ptr;
+                }
+
+                // skip continuation star, if any
+                // (the comment ends at the closing `*/`, so a star at the end isn't one)
+                if (ptr != end && *ptr == '*')
+                {
+                    ++ptr;
+                    if (ptr != end && *ptr == ' ')
+                        // skip one whitespace at most
+                        ++ptr;
+                }
+                else
+                {
+                    // insert extra indent again
+                    result.append(extra_indent, ' ');
+                    // use minimum indent in the future
+                    indent = std::min(actual_indent, indent);
+                }
+            }
+            else
+            {
+                auto line_end = std::find(ptr, end, '\n');
+                result.append(ptr, line_end);
+                ptr = line_end;
+            }
+        }
+
+        // remove trailing star
+        if (!result.empty() && result.back() == '*')
+            result.pop_back();
+        // remove trailing spaces
+        while (!result.empty() && result.back() == ' ')
+            result.pop_back();
+    }
+
+    void normalize_cpp_comment(std::string& result, const char* ptr, const char* end)
+    {
+        while (true)
+        {
+            auto line_end = std::find(ptr, end, '\n');
+            if (ptr != line_end && *ptr == ' ')
+                // skip one whitespace at most
+                ++ptr;
+
+            // remove trailing spaces
+            auto last = line_end;
+            while (last != ptr && last[-1] == ' ')
+                --last;
+            result.append(ptr, last);
+
+            if (line_end == end)
+                break;
+            result += '\n';
+            ptr = line_end + 1;
+        }
+    }
+} // namespace
+
+std::string detail::raw_doc_comment::normalize() const
+{
+    auto begin = buffer->data() + offset;
+
+    std::string result;
+    result.reserve(length);
+    if (kind == c)
+        normalize_c_comment(result, begin, begin + length, column);
+    else
+        normalize_cpp_comment(result, begin, begin + length);
+    return result;
+}
+
 cpp_scope_name::cpp_scope_name(type_safe::object_ref<const cpp_entity> entity) : entity_(entity)
 {
     if (cppast::is_templated(*entity))
@@ -58,6 +175,21 @@ std::unique_ptr<cpp_entity> cpp_unexposed_entity::build(cpp_token_string spellin
     return std::unique_ptr<cpp_entity>(new cpp_unexposed_entity("", std::move(spelling)));
 }
 
+std::unique_ptr<cpp_entity> cpp_unexposed_entity::build(const cpp_entity_index& index,
+                                                        cpp_entity_id id, std::string name,
+                                                        detail::lazy_token_string spelling)
+{
+    std::unique_ptr<cpp_entity> result(
+        new cpp_unexposed_entity(std::move(name), std::move(spelling)));
+    index.register_forward_declaration(id, type_safe::ref(*result));
+    return result;
+}
+
+std::unique_ptr<cpp_entity> cpp_unexposed_entity::build(detail::lazy_token_string spelling)
+{
+    return std::unique_ptr<cpp_entity>(new cpp_unexposed_entity("", std::move(spelling)));
+}
+
 cpp_entity_kind cpp_unexposed_entity::do_get_entity_kind() const noexcept
 {
     return kind();
@@ -71,3 +203,97 @@ bool cppast::is_templated(const cpp_entity& e) noexcept
         return false;
     return e.parent().value().name() == e.name();
 }
+
+namespace
+{
+    const std::shared_ptr<const std::string>& global_scope()
+    {
+        static const std::shared_ptr<const std::string> scope = std::make_shared<std::string>();
+        return scope;
+    }
+
+    std::string get_semantic_scope(const cpp_entity& e)
+    {
+        auto declarable = get_forward_declarable(e);
+        if (!declarable)
+            return "";
+
+        auto scope = declarable.value().semantic_scope();
+        if (scope.compare(0u, 2u, "::") == 0)
+            // explicitly global scope
+            scope.erase(0u, 2u);
+        return scope;
+    }
+} // namespace
+
+type_safe::optional_ref<const std::string> cpp_entity::comment() const
+{
+    auto cached = std::atomic_load(&comment_);
+    if (!cached && raw_comment_.buffer)
+    {
+        // another thread might normalize it as well, use the first one then
+        std::shared_ptr<const std::string> normalized =
+            std::make_shared<const std::string>(raw_comment_.normalize());
+        std::shared_ptr<const std::string> expected;
+        if (std::atomic_compare_exchange_strong(&comment_, &expected, normalized))
+            cached = std::move(normalized);
+        else
+            cached = std::move(expected);
+    }
+
+    return !cached || cached->empty() ? nullptr : type_safe::opt_ref(cached.get());
+}
+
+std::shared_ptr<const std::string> cpp_entity::children_scope() const
+{
+    auto cached = std::atomic_load(&children_scope_);
+    if (cached)
+        return cached;
+
+    std::shared_ptr<const std::string> result;
+    if (kind() == cpp_entity_kind::friend_t)
+    {
+        // friended entities are members of the scope enclosing the class
+        auto cur = parent();
+        if (cur && cppast::is_templated(cur.value()))
+            cur = cur.value().parent();
+        if (cur && cur.value().parent())
+            result = cur.value().parent().value().children_scope();
+        else
+            result = global_scope();
+    }
+    else
+    {
+        auto parent_scope = parent_ ? parent_.value().children_scope() : global_scope();
+
+        auto scope = scope_name();
+        if (cppast::is_templated(*this) || !scope || scope.value().name().empty())
+            // no new scope, or the template has already added it
+            result = std::move(parent_scope);
+        else
+            result = std::make_shared<std::string>(*parent_scope + get_semantic_scope(*this)
+                                                   + scope.value().name() + "::");
+    }
+
+    // another thread might have computed it already, use that one then
+    std::shared_ptr<const std::string> expected;
+    if (!std::atomic_compare_exchange_strong(&children_scope_, &expected, result))
+        return expected;
+    return result;
+}
+
+std::string cppast::full_name(const cpp_entity& e)
+{
+    if (e.name().empty())
+        return "";
+    else if (is_parameter(e.kind()))
+        // parameters don't have a full name
+        return e.name();
+    else if (is_templated(e))
+        // the template has the same name
+        return full_name(e.parent().value());
+    else if (!e.parent())
+        return e.name();
+
+    return *e.parent().value().children_scope() + get_semantic_scope(e) + e.name();
+}
@@ -8,9 +8,140 @@
 #include <cppast/cpp_entity.hpp>
 #include <cppast/cpp_entity_kind.hpp>
 #include <cppast/cpp_file.hpp>
+#include <cppast/cpp_forward_declarable.hpp>
+#include <cppast/cpp_namespace.hpp>
+
+#include <algorithm>
 
 using namespace cppast;
 
+namespace
+{
+    constexpr std::uint64_t hash_seed = 0x9e3779b97f4a7c15ull;
+    constexpr std::uint64_t mul_a     = 0x87c37b91114253d5ull;
+    constexpr std::uint64_t mul_b     = 0x4cf5ad432745937full;
+
+    std::uint64_t rotl(std::uint64_t x, unsigned n) noexcept
+    {
+        return (x << n) | (x >> (64u - n));
+    }
+
+    // reads 8 bytes in little endian order, independent of the platform
+    std::uint64_t read_word(const char* ptr) noexcept
+    {
+        auto bytes  = reinterpret_cast<const unsigned char*>(ptr);
+        auto result = std::uint64_t(0u);
+        for (auto i = 0u; i != 8u; ++i)
+            result |= std::uint64_t(bytes[i]) << (8u * i);
+        return result;
+    }
+} // namespace
+
+detail::id_hasher::id_hasher() noexcept : hash_(hash_seed), tail_(0u), length_(0u) {}
+
+detail::id_hasher& detail::id_hasher::append(const char* str, std::size_t length) noexcept
+{
+#ifdef CPPAST_CHECK_ID_COLLISIONS
+    key_.append(str, length);
+#endif
+
+    // complete the partial word of the previous string
+    auto tail_size = length_ % 8u;
+    length_ += length;
+    if (tail_size != 0u)
+    {
+        for (; tail_size != 8u && length != 0u; ++tail_size, ++str, --length)
+            tail_ |= std::uint64_t(static_cast<unsigned char>(*str)) << (8u * tail_size);
+        if (tail_size != 8u)
+            return *this;
+
+        mix(tail_);
+        tail_ = 0u;
+    }
+
+    for (; length >= 8u; str += 8u, length -= 8u)
+        mix(read_word(str));
+
+    for (auto i = 0u; i != length; ++i)
+        tail_ |= std::uint64_t(static_cast<unsigned char>(str[i])) << (8u * i);
+
+    return *this;
+}
+
+void detail::id_hasher::mix(std::uint64_t word) noexcept
+{
+    hash_ ^= rotl(word * mul_a, 31u) * mul_b;
+    hash_ = rotl(hash_, 27u) * 5u + 0x52dce729u;
+}
+
+std::size_t detail::id_hasher::finish() const noexcept
+{
+    auto hash = hash_ ^ (rotl(tail_ * mul_a, 31u) * mul_b) ^ std::uint64_t(length_);
+
+    // finalizer to avalanche the bits
+    hash ^= hash >> 33u;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33u;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33u;
+    return static_cast<std::size_t>(hash);
+}
+
+std::size_t detail::id_hash(const char* str, std::size_t length) noexcept
+{
+    return id_hasher().append(str, length).finish();
+}
+
+cpp_entity_index::id_collision_error::id_collision_error(const std::string& a,
+                                                         const std::string& b)
+: std::logic_error("entity id collision between '" + a + "' and '" + b + "'")
+{
+}
+
+void cpp_entity_index::check_collision(const cpp_entity_id& id) const
+{
+#ifdef CPPAST_CHECK_ID_COLLISIONS
+    auto result = keys_.emplace(id, id.key());
+    if (!result.second && result.first->second != id.key())
+        throw id_collision_error(result.first->second, id.key());
+#else
+    (void)id;
+#endif
+}
+
+bool cpp_entity_index::is_registered_key(const cpp_entity_id& id) const noexcept
+{
+#ifdef CPPAST_CHECK_ID_COLLISIONS
+    auto iter = keys_.find(id);
+    return iter == keys_.end() || iter->second == id.key();
+#else
+    (void)id;
+    return true;
+#endif
+}
+
+namespace
+{
+    std::uint64_t get_next_instance() noexcept
+    {
+        // 0 means that no index stores a definition
+        static std::atomic<std::uint64_t> next(1u);
+        return next++;
+    }
+} // namespace
+
+cpp_entity_index::cpp_entity_index(bool track_files)
+: track_files_(track_files), instance_(get_next_instance())
+{
+}
+
+void cpp_entity_index::link_definition(const cpp_entity& decl, const cpp_entity* def) const
+{
+    auto declarable = get_forward_declarable(decl);
+    if (declarable)
+        declarable.value().set_definition_entity(instance_, def);
+}
+
 cpp_entity_index::duplicate_definition_error::duplicate_definition_error()
 : std::logic_error("duplicate registration of entity definition")
 {
@@ -22,15 +153,32 @@ void cpp_entity_index::register_definition(cpp_entity_id
     DEBUG_ASSERT(entity->kind() != cpp_entity_kind::namespace_t,
                  detail::precondition_error_handler{}, "must not be a namespace");
     std::lock_guard<std::mutex> lock(mutex_);
-    auto                        result = map_.emplace(std::move(id), value(entity, true));
+    check_collision(id);
+    track(*entity, id);
+    auto result = map_.emplace(id, value(entity, true));
     if (!result.second)
     {
         // already in map, override declaration
         auto& value = result.first->second;
         if (value.is_definition)
-            throw duplicate_definition_error();
+        {
+            if (!track_files_)
+                throw duplicate_definition_error();
+            // keep it, in case the file of the first definition is unregistered
+            duplicates_[std::move(id)].push_back(entity);
+            return;
+        }
         value.is_definition = true;
         value.entity        = entity;
+
+        // link the declarations to the definition
+        for (auto& decl : value.declarations)
+            link_definition(*decl, &*entity);
+        if (!track_files_)
+        {
+            value.declarations.clear();
+            value.declarations.shrink_to_fit();
+        }
     }
 }
 
@@ -38,29 +186,160 @@ bool cpp_entity_index::register_file(cpp_entity_id                         id,
                                      type_safe::object_ref<const cpp_file> file) const
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    return map_.emplace(std::move(id), value(file, true)).second;
+    check_collision(id);
+    auto result = map_.emplace(id, value(file, true)).second;
+    if (result && track_files_)
+    {
+        // the entities registered by this thread since its last file belong to this one
+        track(*file, id);
+        auto iter        = untracked_.find(std::this_thread::get_id());
+        tracked_[&*file] = std::move(iter->second);
+        untracked_.erase(iter);
+    }
+    return result;
 }
 
 void cpp_entity_index::register_forward_declaration(
     cpp_entity_id id, type_safe::object_ref<const cpp_entity> entity) const
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    map_.emplace(std::move(id), value(entity, false));
+    check_collision(id);
+    track(*entity, id);
+    auto result = map_.emplace(std::move(id), value(entity, false));
+
+    auto& value = result.first->second;
+    if (value.is_definition)
+        link_definition(*entity, &*value.entity);
+    if (!value.is_definition || track_files_)
+        value.declarations.push_back(entity);
+}
+
+void cpp_entity_index::track(const cpp_entity& entity, const cpp_entity_id& id,
+                             bool is_namespace) const
+{
+    if (track_files_)
+        untracked_[std::this_thread::get_id()].emplace_back(entity, id, is_namespace);
+}
+
+void cpp_entity_index::unregister(const registration& r) const
+{
+    // only compares the addresses, the entity need not be alive anymore
+    auto is_entity = [&](const type_safe::object_ref<const cpp_entity>& e) {
+        return &*e == r.entity;
+    };
+
+    if (r.is_namespace)
+    {
+        auto iter = ns_.find(r.id);
+        if (iter == ns_.end())
+            return;
+        auto& namespaces = iter->second;
+        namespaces.erase(std::remove_if(namespaces.begin(), namespaces.end(),
+                                        [&](const type_safe::object_ref<const cpp_namespace>& ns) {
+                                            return &*ns == r.entity;
+                                        }),
+                         namespaces.end());
+        if (namespaces.empty())
+            ns_.erase(iter);
+        return;
+    }
+
+    auto iter = map_.find(r.id);
+    if (iter == map_.end())
+        return;
+    auto& value = iter->second;
+    value.declarations.erase(std::remove_if(value.declarations.begin(), value.declarations.end(),
+                                            is_entity),
+                             value.declarations.end());
+
+    auto duplicates = duplicates_.find(r.id);
+    if (duplicates != duplicates_.end())
+    {
+        auto& definitions = duplicates->second;
+        definitions.erase(std::remove_if(definitions.begin(), definitions.end(), is_entity),
+                          definitions.end());
+        if (is_entity(value.entity) && !definitions.empty())
+        {
+            // fall back to the next definition
+            value.entity = definitions.front();
+            definitions.erase(definitions.begin());
+            for (auto& decl : value.declarations)
+                link_definition(*decl, &*value.entity);
+        }
+        if (definitions.empty())
+            duplicates_.erase(duplicates);
+    }
+
+    if (is_entity(value.entity))
+    {
+        // fall back to the remaining declarations
+        if (value.is_definition)
+            for (auto& decl : value.declarations)
+                link_definition(*decl, nullptr);
+        if (value.declarations.empty())
+            map_.erase(iter);
+        else
+        {
+            value.entity        = value.declarations.front();
+            value.is_definition = false;
+        }
+    }
+}
+
+void cpp_entity_index::unregister_file(const cpp_file& file) const
+{
+    DEBUG_ASSERT(track_files_, detail::precondition_error_handler{}, "index must track files");
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+
+    auto iter = tracked_.find(&file);
+    if (iter == tracked_.end())
+        return;
+    for (auto& r : iter->second)
+        unregister(r);
+    tracked_.erase(iter);
 }
 
 void cpp_entity_index::register_namespace(cpp_entity_id                              id,
                                           type_safe::object_ref<const cpp_namespace> ns) const
 {
     std::lock_guard<std::mutex> lock(mutex_);
+    check_collision(id);
+    track(*ns, id, true);
     ns_[std::move(id)].push_back(ns);
 }
 
+void cpp_entity_index::clear() const noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    // the declarations still store the definitions, so they must not be used anymore
+    instance_ = get_next_instance();
+    map_.clear();
+    ns_.clear();
+    untracked_.clear();
+    tracked_.clear();
+    duplicates_.clear();
+#ifdef CPPAST_CHECK_ID_COLLISIONS
+    keys_.clear();
+#endif
+    names_.clear();
+    name_ids_.clear();
+    members_.clear();
+    member_ids_.clear();
+}
+
+std::uint64_t cpp_entity_index::generation() const noexcept
+{
+    return generation_;
+}
+
 type_safe::optional_ref<const cpp_entity> cpp_entity_index::lookup(const cpp_entity_id& id) const
     noexcept
 {
     std::lock_guard<std::mutex> lock(mutex_);
     auto                        iter = map_.find(id);
-    if (iter == map_.end())
+    if (iter == map_.end() || !is_registered_key(id))
         return {};
     return type_safe::ref(iter->second.entity.get());
 }
@@ -70,7 +349,7 @@ type_safe::optional_ref<const cpp_entity> cpp_entity_index::lookup_definition(
 {
     std::lock_guard<std::mutex> lock(mutex_);
     auto                        iter = map_.find(id);
-    if (iter == map_.end() || !iter->second.is_definition)
+    if (iter == map_.end() || !iter->second.is_definition || !is_registered_key(id))
         return {};
     return type_safe::ref(iter->second.entity.get());
 }
@@ -80,8 +359,146 @@ auto cpp_entity_index::lookup_namespace(const cpp_entity_id& id) const noexcept
 {
     std::lock_guard<std::mutex> lock(mutex_);
     auto                        iter = ns_.find(id);
-    if (iter == ns_.end())
+    if (iter == ns_.end() || !is_registered_key(id))
         return nullptr;
     auto& vec = iter->second;
     return type_safe::ref(vec.data(), vec.size());
 }
+
+namespace
+{
+    // returns the fully qualified name of the entity,
+    // scope_length is set to the length of the scope part without the trailing `::`
+    // returns an empty string if the entity is not part of the name index
+    std::string get_qualified_name(const cpp_entity& e, std::size_t& scope_length)
+    {
+        if (e.name().empty() || e.kind() == cpp_entity_kind::file_t || is_parameter(e.kind()))
+            return "";
+
+        auto name = full_name(e);
+        // the name ends with ::<e.name()> if it has a scope
+        scope_length = name.size() > e.name().size() ? name.size() - e.name().size() - 2u : 0u;
+        return name;
+    }
+
+    bool starts_with(const std::string& str, const std::string& prefix)
+    {
+        return str.compare(0u, prefix.size(), prefix) == 0;
+    }
+
+    // compares the scope part of the name
+    int compare_scope(const std::string& name, std::size_t scope_length, const std::string& scope)
+    {
+        return name.compare(0u, scope_length, scope);
+    }
+} // namespace
+
+void cpp_entity_index::build_name_index() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<std::pair<name_entry, cpp_entity_id>> entries;
+    auto add_entry = [&](const cpp_entity& e, const cpp_entity_id& id) {
+        auto scope_length = std::size_t(0u);
+        auto name         = get_qualified_name(e, scope_length);
+        if (!name.empty())
+            entries.emplace_back(name_entry(std::move(name), scope_length), id);
+    };
+    for (auto& pair : map_)
+        add_entry(*pair.second.entity, pair.first);
+    for (auto& pair : ns_)
+        // all namespaces with the same id have the same name
+        if (!pair.second.empty())
+            add_entry(*pair.second.front(), pair.first);
+
+    std::sort(entries.begin(), entries.end(),
+              [](const std::pair<name_entry, cpp_entity_id>& a,
+                 const std::pair<name_entry, cpp_entity_id>& b) {
+                  return a.first.name < b.first.name;
+              });
+
+    names_.clear();
+    name_ids_.clear();
+    names_.reserve(entries.size());
+    name_ids_.reserve(entries.size());
+    for (auto& entry : entries)
+    {
+        names_.push_back(std::move(entry.first));
+        name_ids_.push_back(entry.second);
+    }
+
+    // the members of a scope aren't contiguous in names_,
+    // so keep a second order sorted by scope
+    members_.resize(names_.size());
+    for (std::size_t i = 0u; i != members_.size(); ++i)
+        members_[i] = i;
+    std::stable_sort(members_.begin(), members_.end(), [&](std::size_t a, std::size_t b) {
+        auto& entry_a = names_[a];
+        auto& entry_b = names_[b];
+        return entry_a.name.compare(0u, entry_a.scope_length, entry_b.name, 0u,
+                                    entry_b.scope_length)
+               < 0;
+    });
+
+    member_ids_.clear();
+    member_ids_.reserve(members_.size());
+    for (auto index : members_)
+        member_ids_.push_back(name_ids_[index]);
+}
+
+auto cpp_entity_index::lookup_name(const std::string& name) const noexcept
+    -> type_safe::array_ref<const cpp_entity_id>
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto begin = std::lower_bound(names_.begin(), names_.end(), name,
+                                  [](const name_entry& entry, const std::string& name) {
+                                      return entry.name < name;
+                                  });
+    auto end   = std::upper_bound(begin, names_.end(), name,
+                                [](const std::string& name, const name_entry& entry) {
+                                    return name < entry.name;
+                                });
+    if (begin == end)
+        return nullptr;
+    return type_safe::ref(name_ids_.data() + (begin - names_.begin()), std::size_t(end - begin));
+}
+
+auto cpp_entity_index::lookup_name_prefix(const std::string& prefix) const noexcept
+    -> type_safe::array_ref<const cpp_entity_id>
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    // all names with the given prefix are contiguous, starting at the prefix itself
+    auto begin = std::lower_bound(names_.begin(), names_.end(), prefix,
+                                  [](const name_entry& entry, const std::string& prefix) {
+                                      return entry.name < prefix;
+                                  });
+    auto end   = std::upper_bound(begin, names_.end(), prefix,
+                                [](const std::string& prefix, const name_entry& entry) {
+                                    return !starts_with(entry.name, prefix);
+                                });
+    if (begin == end)
+        return nullptr;
+    return type_safe::ref(name_ids_.data() + (begin - names_.begin()), std::size_t(end - begin));
+}
+
+auto cpp_entity_index::lookup_scope_members(const std::string& scope) const noexcept
+    -> type_safe::array_ref<const cpp_entity_id>
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto begin = std::lower_bound(members_.begin(), members_.end(), scope,
+                                  [&](std::size_t index, const std::string& scope) {
+                                      auto& entry = names_[index];
+                                      return compare_scope(entry.name, entry.scope_length, scope)
+                                             < 0;
+                                  });
+    auto end   = std::upper_bound(begin, members_.end(), scope,
+                                [&](const std::string& scope, std::size_t index) {
+                                    auto& entry = names_[index];
+                                    return compare_scope(entry.name, entry.scope_length, scope)
+                                           > 0;
+                                });
+    if (begin == end)
+        return nullptr;
+    return type_safe::ref(member_ids_.data() + (begin - members_.begin()),
+                          std::size_t(end - begin));
+}
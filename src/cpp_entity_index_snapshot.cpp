@@ -0,0 +1,527 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cppast/cpp_entity_index_snapshot.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cppast/cpp_entity.hpp>
+#include <cppast/cpp_file.hpp>
+#include <cppast/cpp_namespace.hpp>
+
+using namespace cppast;
+
+namespace
+{
+    constexpr char          snapshot_magic[8] = {'c', 'p', 'p', 'a', 's', 't', 'i', 'x'};
+    constexpr std::uint32_t snapshot_version  = 3u;
+
+    std::uint64_t align(std::uint64_t offset) noexcept
+    {
+        return (offset + 7u) & ~std::uint64_t(7u);
+    }
+
+    const char* get_file_name(const cpp_entity& e)
+    {
+        auto cur = type_safe::ref(e);
+        while (cur->parent())
+            cur = type_safe::ref(cur->parent().value());
+        return cur->kind() == cpp_entity_kind::file_t ? cur->name().c_str() : "";
+    }
+
+    // the string the id was created from, if it is known
+    std::string get_id_key(const cpp_entity_id& id)
+    {
+#ifdef CPPAST_CHECK_ID_COLLISIONS
+        return id.key();
+#else
+        (void)id;
+        return "";
+#endif
+    }
+
+    class string_table
+    {
+    public:
+        std::uint32_t add(const std::string& str)
+        {
+            auto iter = offsets_.find(str);
+            if (iter != offsets_.end())
+                return iter->second;
+
+            auto offset = static_cast<std::uint32_t>(data_.size());
+            data_.insert(data_.end(), str.begin(), str.end());
+            data_.push_back('\0');
+            offsets_.emplace(str, offset);
+            return offset;
+        }
+
+        const std::vector<char>& data() const noexcept
+        {
+            return data_;
+        }
+
+    private:
+        std::vector<char>                              data_;
+        std::unordered_map<std::string, std::uint32_t> offsets_;
+    };
+
+    template <typename T>
+    void write_at(std::ofstream& out, std::uint64_t offset, const T* data, std::size_t count)
+    {
+        out.seekp(static_cast<std::streamoff>(offset));
+        out.write(reinterpret_cast<const char*>(data),
+                  static_cast<std::streamsize>(count * sizeof(T)));
+    }
+
+    // collects the entities and writes the snapshot file
+    class snapshot_builder
+    {
+    public:
+        // if there is already an entity with the same id, keeps the definition
+        void add_entity(std::uint64_t id, const std::string& file, const std::string& name,
+                        std::string full_name, const std::string& key, cpp_entity_kind kind,
+                        bool is_definition)
+        {
+            auto iter = indices_.find(id);
+            if (iter == indices_.end())
+            {
+                indices_.emplace(id, entities_.size());
+                entities_.emplace_back();
+                full_names_.emplace_back();
+                namespace_files_.emplace_back();
+            }
+            else if (entities_[iter->second].is_definition || !is_definition)
+                return;
+
+            auto  index  = iter == indices_.end() ? entities_.size() - 1u : iter->second;
+            auto& entity = entities_[index];
+            std::memset(&entity, 0, sizeof(entity));
+            entity.id            = id;
+            entity.file          = strings_.add(file);
+            entity.name          = strings_.add(name);
+            entity.kind          = static_cast<std::uint16_t>(kind);
+            entity.is_definition = is_definition;
+            entity.full_name     = strings_.add(full_name);
+            entity.key           = strings_.add(key);
+            full_names_[index]   = std::move(full_name);
+        }
+
+        // namespaces with the same id are merged
+        void add_namespace(std::uint64_t id, const std::string& name, std::string full_name,
+                           const std::string& key, const std::vector<std::string>& files)
+        {
+            if (files.empty())
+                return;
+            add_entity(id, files.front(), name, std::move(full_name), key,
+                       cpp_entity_kind::namespace_t, true);
+
+            auto& ns_files = namespace_files_[indices_[id]];
+            for (auto& file : files)
+            {
+                auto offset = strings_.add(file);
+                if (std::find(ns_files.begin(), ns_files.end(), offset) == ns_files.end())
+                    ns_files.push_back(offset);
+            }
+            entities_[indices_[id]].file = ns_files.front();
+        }
+
+        void write(const std::string& path)
+        {
+            // sort entities by id for the lookup
+            std::vector<std::uint32_t> order(entities_.size());
+            for (std::size_t i = 0u; i != order.size(); ++i)
+                order[i] = static_cast<std::uint32_t>(i);
+            std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+                return entities_[a].id < entities_[b].id;
+            });
+
+            std::vector<detail::snapshot_entity> sorted_entities;
+            std::vector<std::string>             sorted_names;
+            std::vector<std::uint32_t>           namespace_files;
+            sorted_entities.reserve(entities_.size());
+            sorted_names.reserve(entities_.size());
+            for (auto index : order)
+            {
+                sorted_entities.push_back(entities_[index]);
+                sorted_names.push_back(std::move(full_names_[index]));
+
+                auto& ns_files = namespace_files_[index];
+                auto& entity   = sorted_entities.back();
+                entity.first_namespace_file = static_cast<std::uint32_t>(namespace_files.size());
+                entity.namespace_file_count = static_cast<std::uint32_t>(ns_files.size());
+                namespace_files.insert(namespace_files.end(), ns_files.begin(), ns_files.end());
+            }
+
+            // the name index refers to the sorted entities
+            std::vector<std::uint32_t> names;
+            for (std::size_t i = 0u; i != sorted_entities.size(); ++i)
+                if (!sorted_names[i].empty()
+                    && !is_parameter(cpp_entity_kind(sorted_entities[i].kind)))
+                    names.push_back(static_cast<std::uint32_t>(i));
+            std::stable_sort(names.begin(), names.end(), [&](std::uint32_t a, std::uint32_t b) {
+                return sorted_names[a] < sorted_names[b];
+            });
+
+            detail::snapshot_header header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+            header.version                = snapshot_version;
+            header.entity_count           = static_cast<std::uint32_t>(sorted_entities.size());
+            header.namespace_file_count   = static_cast<std::uint32_t>(namespace_files.size());
+            header.name_count             = static_cast<std::uint32_t>(names.size());
+            header.entities_offset        = align(sizeof(header));
+            header.namespace_files_offset = align(header.entities_offset
+                                                  + sorted_entities.size()
+                                                        * sizeof(detail::snapshot_entity));
+            header.names_offset = align(header.namespace_files_offset
+                                        + namespace_files.size() * sizeof(std::uint32_t));
+            header.strings_offset =
+                align(header.names_offset + names.size() * sizeof(std::uint32_t));
+            header.strings_size = strings_.data().size();
+
+            std::ofstream out(path, std::ios_base::binary | std::ios_base::trunc);
+            if (!out)
+                throw snapshot_error("unable to open snapshot file '" + path + "' for writing");
+            write_at(out, 0u, &header, 1u);
+            write_at(out, header.entities_offset, sorted_entities.data(), sorted_entities.size());
+            write_at(out, header.namespace_files_offset, namespace_files.data(),
+                     namespace_files.size());
+            write_at(out, header.names_offset, names.data(), names.size());
+            write_at(out, header.strings_offset, strings_.data().data(), strings_.data().size());
+            if (!out)
+                throw snapshot_error("unable to write snapshot file '" + path + "'");
+        }
+
+    private:
+        string_table                                   strings_;
+        std::vector<detail::snapshot_entity>           entities_;
+        std::vector<std::string>                       full_names_;
+        std::vector<std::vector<std::uint32_t>>        namespace_files_;
+        std::unordered_map<std::uint64_t, std::size_t> indices_;
+    };
+
+    std::uint64_t get_key(const cpp_entity_id& id) noexcept
+    {
+        return static_cast<std::uint64_t>(static_cast<std::size_t>(id));
+    }
+} // namespace
+
+void cpp_entity_index::write_snapshot(const std::string& path) const
+{
+    snapshot_builder builder;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& pair : map_)
+        {
+            auto& e = *pair.second.entity;
+            builder.add_entity(get_key(pair.first), get_file_name(e), e.name(),
+                               e.kind() == cpp_entity_kind::file_t ? e.name() : full_name(e),
+                               get_id_key(pair.first), e.kind(), pair.second.is_definition);
+        }
+        for (auto& pair : ns_)
+        {
+            if (pair.second.empty())
+                continue;
+
+            std::vector<std::string> files;
+            for (auto& ns : pair.second)
+                files.push_back(get_file_name(*ns));
+            builder.add_namespace(get_key(pair.first), pair.second.front()->name(),
+                                  full_name(*pair.second.front()),
+                                  get_id_key(pair.first), files);
+        }
+    }
+    builder.write(path);
+}
+
+void cpp_entity_index_snapshot::merge(const std::vector<std::string>& inputs,
+                                      const std::string&              output)
+{
+    snapshot_builder builder;
+    for (auto& input : inputs)
+    {
+        cpp_entity_index_snapshot snapshot(input);
+        auto                      files =
+            reinterpret_cast<const std::uint32_t*>(snapshot.data_
+                                                   + snapshot.header().namespace_files_offset);
+        for (auto i = 0u; i != snapshot.header().entity_count; ++i)
+        {
+            auto& entity = snapshot.entities()[i];
+            if (cpp_entity_kind(entity.kind) == cpp_entity_kind::namespace_t)
+            {
+                std::vector<std::string> ns_files;
+                for (auto j = 0u; j != entity.namespace_file_count; ++j)
+                    ns_files.emplace_back(snapshot.string(files[entity.first_namespace_file + j]));
+                builder.add_namespace(entity.id, snapshot.string(entity.name),
+                                      snapshot.string(entity.full_name),
+                                      snapshot.string(entity.key), ns_files);
+            }
+            else
+                builder.add_entity(entity.id, snapshot.string(entity.file),
+                                   snapshot.string(entity.name), snapshot.string(entity.full_name),
+                                   snapshot.string(entity.key), cpp_entity_kind(entity.kind),
+                                   entity.is_definition != 0u);
+        }
+    }
+    builder.write(output);
+}
+
+cpp_entity_index_snapshot::cpp_entity_index_snapshot(const std::string& path)
+: data_(nullptr), size_(0u), is_mapped_(false)
+{
+#ifndef _WIN32
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            auto mapping =
+                ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED)
+            {
+                data_      = static_cast<const char*>(mapping);
+                size_      = static_cast<std::size_t>(info.st_size);
+                is_mapped_ = true;
+            }
+        }
+        ::close(fd);
+    }
+#endif
+
+    if (!data_)
+    {
+        // fallback: read it into memory
+        std::ifstream file(path, std::ios_base::binary);
+        if (!file)
+            throw snapshot_error("unable to open snapshot file '" + path + "'");
+        std::vector<char> buffer((std::istreambuf_iterator<char>(file)),
+                                 std::istreambuf_iterator<char>());
+        auto              memory = new char[buffer.size() + 1u];
+        std::memcpy(memory, buffer.data(), buffer.size());
+        data_ = memory;
+        size_ = buffer.size();
+    }
+
+    if (!validate())
+    {
+        release();
+        throw snapshot_error("invalid snapshot file '" + path + "'");
+    }
+}
+
+bool cpp_entity_index_snapshot::validate() const noexcept
+{
+    if (size_ < sizeof(detail::snapshot_header))
+        return false;
+    auto& h = header();
+    if (std::memcmp(h.magic, snapshot_magic, sizeof(h.magic)) != 0
+        || h.version != snapshot_version)
+        return false;
+
+    // the sections must be inside the file, written so that corrupt sizes cannot overflow
+    auto in_file = [&](std::uint64_t offset, std::uint64_t count, std::uint64_t size) {
+        return offset <= size_ && (size_ - offset) / size >= count;
+    };
+    if (!in_file(h.entities_offset, h.entity_count, sizeof(detail::snapshot_entity))
+        || !in_file(h.namespace_files_offset, h.namespace_file_count, sizeof(std::uint32_t))
+        || !in_file(h.names_offset, h.name_count, sizeof(std::uint32_t))
+        || !in_file(h.strings_offset, h.strings_size, 1u))
+        return false;
+    if (h.entities_offset % alignof(detail::snapshot_entity) != 0u
+        || h.namespace_files_offset % alignof(std::uint32_t) != 0u
+        || h.names_offset % alignof(std::uint32_t) != 0u)
+        return false;
+
+    // every string must start inside the table and the last one must be terminated,
+    // then string() always returns a terminated string inside the file
+    if (h.strings_size == 0u)
+        return h.entity_count == 0u && h.namespace_file_count == 0u;
+    else if (data_[h.strings_offset + h.strings_size - 1u] != '\0')
+        return false;
+    auto valid_string = [&](std::uint32_t offset) { return offset < h.strings_size; };
+
+    auto files = reinterpret_cast<const std::uint32_t*>(data_ + h.namespace_files_offset);
+    for (auto i = 0u; i != h.namespace_file_count; ++i)
+        if (!valid_string(files[i]))
+            return false;
+
+    for (auto i = 0u; i != h.entity_count; ++i)
+    {
+        auto& entity = entities()[i];
+        if (!valid_string(entity.file) || !valid_string(entity.name)
+            || !valid_string(entity.full_name) || !valid_string(entity.key)
+            || entity.first_namespace_file > h.namespace_file_count
+            || h.namespace_file_count - entity.first_namespace_file < entity.namespace_file_count)
+            return false;
+        else if (i > 0u && entities()[i - 1u].id >= entity.id)
+            return false;
+    }
+
+    for (auto i = 0u; i != h.name_count; ++i)
+        if (names()[i] >= h.entity_count)
+            return false;
+
+    return true;
+}
+
+cpp_entity_index_snapshot::cpp_entity_index_snapshot(cpp_entity_index_snapshot&& other) noexcept
+: data_(other.data_), size_(other.size_), is_mapped_(other.is_mapped_)
+{
+    other.data_ = nullptr;
+    other.size_ = 0u;
+}
+
+cpp_entity_index_snapshot::~cpp_entity_index_snapshot() noexcept
+{
+    release();
+}
+
+void cpp_entity_index_snapshot::release() noexcept
+{
+    if (!data_)
+        return;
+#ifndef _WIN32
+    if (is_mapped_)
+        ::munmap(const_cast<char*>(data_), size_);
+    else
+#endif
+        delete[] data_;
+    data_ = nullptr;
+}
+
+cpp_entity_index_snapshot& cpp_entity_index_snapshot::operator=(
+    cpp_entity_index_snapshot&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        data_       = other.data_;
+        size_       = other.size_;
+        is_mapped_  = other.is_mapped_;
+        other.data_ = nullptr;
+        other.size_ = 0u;
+    }
+    return *this;
+}
+
+std::size_t cpp_entity_index_snapshot::size() const noexcept
+{
+    return header().entity_count;
+}
+
+type_safe::optional<cpp_entity_index_snapshot::entity_info> cpp_entity_index_snapshot::lookup(
+    const cpp_entity_id& id) const noexcept
+{
+    auto key   = static_cast<std::uint64_t>(static_cast<std::size_t>(id));
+    auto begin = entities();
+    auto end   = begin + header().entity_count;
+    auto iter  = std::lower_bound(begin, end, key,
+                                 [](const detail::snapshot_entity& entity, std::uint64_t key) {
+                                     return entity.id < key;
+                                 });
+    if (iter == end || iter->id != key)
+        return type_safe::nullopt;
+    return get_info(*iter);
+}
+
+std::vector<const char*> cpp_entity_index_snapshot::lookup_namespace(const cpp_entity_id& id) const
+{
+    std::vector<const char*> result;
+
+    auto info = lookup(id);
+    if (!info || info.value().kind != cpp_entity_kind::namespace_t)
+        return result;
+
+    // lookup() has found it, so the index is valid
+    auto key    = static_cast<std::uint64_t>(static_cast<std::size_t>(id));
+    auto entity = std::lower_bound(entities(), entities() + header().entity_count, key,
+                                   [](const detail::snapshot_entity& entity, std::uint64_t key) {
+                                       return entity.id < key;
+                                   });
+    auto files =
+        reinterpret_cast<const std::uint32_t*>(data_ + header().namespace_files_offset);
+    for (auto i = 0u; i != entity->namespace_file_count; ++i)
+        result.push_back(string(files[entity->first_namespace_file + i]));
+    return result;
+}
+
+std::vector<cpp_entity_index_snapshot::entity_info> cpp_entity_index_snapshot::lookup_name(
+    const std::string& name) const
+{
+    auto begin = names();
+    auto end   = begin + header().name_count;
+
+    std::vector<entity_info> result;
+    auto first = std::lower_bound(begin, end, name,
+                                  [&](std::uint32_t index, const std::string& name) {
+                                      return name.compare(string(entities()[index].full_name)) > 0;
+                                  });
+    for (auto iter = first; iter != end && name == string(entities()[*iter].full_name); ++iter)
+        result.push_back(get_info(entities()[*iter]));
+    return result;
+}
+
+std::vector<cpp_entity_index_snapshot::entity_info> cpp_entity_index_snapshot::lookup_name_prefix(
+    const std::string& prefix) const
+{
+    auto begin = names();
+    auto end   = begin + header().name_count;
+
+    std::vector<entity_info> result;
+    // all names with the given prefix are contiguous, starting at the prefix itself
+    auto first = std::lower_bound(begin, end, prefix,
+                                  [&](std::uint32_t index, const std::string& prefix) {
+                                      return prefix.compare(string(entities()[index].full_name))
+                                             > 0;
+                                  });
+    auto has_prefix = [&](std::uint32_t index) {
+        return std::strncmp(string(entities()[index].full_name), prefix.c_str(), prefix.size())
+               == 0;
+    };
+    for (auto iter = first; iter != end && has_prefix(*iter); ++iter)
+        result.push_back(get_info(entities()[*iter]));
+    return result;
+}
+
+const detail::snapshot_header& cpp_entity_index_snapshot::header() const noexcept
+{
+    return *reinterpret_cast<const detail::snapshot_header*>(data_);
+}
+
+const detail::snapshot_entity* cpp_entity_index_snapshot::entities() const noexcept
+{
+    return reinterpret_cast<const detail::snapshot_entity*>(data_ + header().entities_offset);
+}
+
+const std::uint32_t* cpp_entity_index_snapshot::names() const noexcept
+{
+    return reinterpret_cast<const std::uint32_t*>(data_ + header().names_offset);
+}
+
+const char* cpp_entity_index_snapshot::string(std::uint32_t offset) const noexcept
+{
+    // validate() has checked the offset
+    return data_ + header().strings_offset + offset;
+}
+
+cpp_entity_index_snapshot::entity_info cpp_entity_index_snapshot::get_info(
+    const detail::snapshot_entity& entity) const noexcept
+{
+    return entity_info{cpp_entity_id(cpp_entity_id::from_hash_tag{},
+                                     static_cast<std::size_t>(entity.id), string(entity.key)),
+                       string(entity.file), string(entity.name), string(entity.full_name),
+                       static_cast<cpp_entity_kind>(entity.kind), entity.is_definition != 0u};
+}
@@ -4,6 +4,8 @@
 
 #include <cppast/cpp_enum.hpp>
 
+#include <algorithm>
+
 #include <cppast/cpp_entity_kind.hpp>
 
 using namespace cppast;
@@ -13,12 +15,12 @@ cpp_entity_kind cpp_enum_value::kind() noexcept
     return cpp_entity_kind::enum_value_t;
 }
 
-std::unique_ptr<cpp_enum_value> cpp_enum_value::build(const cpp_entity_index& idx, cpp_entity_id id,
-                                                      std::string                     name,
-                                                      std::unique_ptr<cpp_expression> value)
+std::unique_ptr<cpp_enum_value> cpp_enum_value::build(
+    const cpp_entity_index& idx, cpp_entity_id id, std::string name,
+    std::unique_ptr<cpp_expression> value, type_safe::optional<cpp_integral_value> evaluated_value)
 {
-    auto result =
-        std::unique_ptr<cpp_enum_value>(new cpp_enum_value(std::move(name), std::move(value)));
+    auto result = std::unique_ptr<cpp_enum_value>(
+        new cpp_enum_value(std::move(name), std::move(value), std::move(evaluated_value)));
     idx.register_definition(std::move(id), type_safe::ref(*result));
     return result;
 }
@@ -44,3 +46,63 @@ type_safe::optional<cpp_scope_name> cpp_enum::do_get_scope_name() const
         return type_safe::ref(*this);
     return type_safe::nullopt;
 }
+
+cpp_enum_value_table::cpp_enum_value_table(const cpp_enum& e)
+{
+    for (auto& enumerator : e)
+        if (enumerator.evaluated_value())
+            entries_.push_back(entry{enumerator.evaluated_value().value(), &enumerator});
+
+    // stable, so the first enumerator of each value comes first
+    std::stable_sort(entries_.begin(), entries_.end(),
+                     [](const entry& lhs, const entry& rhs) { return lhs.value < rhs.value; });
+    entries_.erase(std::unique(entries_.begin(), entries_.end(),
+                               [](const entry& lhs, const entry& rhs) {
+                                   return lhs.value == rhs.value;
+                               }),
+                   entries_.end());
+    if (entries_.empty())
+        return;
+
+    // the distance between the values, computed modulo 2^64, which is exact as it is non-negative
+    auto range = entries_.back().value.unsigned_value() - entries_.front().value.unsigned_value();
+    if (range < 2u * entries_.size())
+    {
+        dense_.resize(std::size_t(range) + 1u, 0u);
+        for (auto i = 0u; i != entries_.size(); ++i)
+        {
+            auto offset = entries_[i].value.unsigned_value()
+                          - entries_.front().value.unsigned_value();
+            dense_[std::size_t(offset)] = i + 1u;
+        }
+    }
+}
+
+type_safe::optional_ref<const cpp_enum_value> cpp_enum_value_table::lookup(
+    const cpp_integral_value& value) const noexcept
+{
+    if (entries_.empty())
+        return type_safe::nullopt;
+    else if (is_dense())
+    {
+        auto offset = value.unsigned_value() - entries_.front().value.unsigned_value();
+        if (offset >= dense_.size() || dense_[std::size_t(offset)] == 0u)
+            return type_safe::nullopt;
+
+        // the offset wraps around, so make sure it is actually the same value
+        auto& result = entries_[dense_[std::size_t(offset)] - 1u];
+        if (result.value != value)
+            return type_safe::nullopt;
+        return type_safe::opt_cref(result.enumerator);
+    }
+    else
+    {
+        auto iter = std::lower_bound(entries_.begin(), entries_.end(), value,
+                                     [](const entry& lhs, const cpp_integral_value& rhs) {
+                                         return lhs.value < rhs;
+                                     });
+        if (iter == entries_.end() || iter->value != value)
+            return type_safe::nullopt;
+        return type_safe::opt_cref(iter->enumerator);
+    }
+}
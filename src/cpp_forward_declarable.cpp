@@ -79,7 +79,11 @@ namespace
             // not declarable or is a definition
             // return reference to entity itself
             return type_safe::ref(e);
-        // else lookup definition
+        else if (auto definition = declarable.value().definition_entity(idx))
+            // use the definition stored by the index
+            return definition;
+        // else lookup definition,
+        // the declaration might not be registered in this index
         return idx.lookup_definition(declarable.value().definition().value());
     }
 } // namespace
@@ -90,6 +94,12 @@ bool cppast::is_definition(const cpp_entity& e) noexcept
     return declarable && declarable.value().is_definition();
 }
 
+type_safe::optional_ref<const cpp_forward_declarable> cppast::get_forward_declarable(
+    const cpp_entity& e) noexcept
+{
+    return get_declarable(e);
+}
+
 type_safe::optional_ref<const cpp_entity> cppast::get_definition(const cpp_entity_index& idx,
                                                                  const cpp_entity&       e)
 {
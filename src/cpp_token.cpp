@@ -7,7 +7,7 @@
 #include <algorithm>
 #include <cctype>
 #include <cstring>
-#include <type_safe/optional.hpp>
+#include <initializer_list>
 
 #include <cppast/detail/assert.hpp>
 
@@ -15,587 +15,571 @@ using namespace cppast;
 
 void cpp_token_string::builder::unmunch()
 {
-    DEBUG_ASSERT(!tokens_.empty() && tokens_.back().spelling == ">>", detail::assert_handler{});
-    tokens_.back().spelling = ">";
+    DEBUG_ASSERT(!tokens_.empty() && buffer_.compare(tokens_.back().offset, 3u, ">>\0", 3u) == 0,
+                 detail::assert_handler{});
+    // the last spelling is at the end of the buffer, so remove one '>' and keep the terminator
+    buffer_.erase(buffer_.size() - 2u, 1u);
 }
 
 namespace
 {
-    template <std::size_t N>
-    bool starts_with(const char* ptr, const char (&str)[N])
+    enum char_class : unsigned char
     {
-        return std::strncmp(ptr, str, N - 1u) == 0;
-    }
-
-    bool starts_with(const char* ptr, const std::string& str)
+        whitespace           = 1u << 0,
+        identifier_nondigit  = 1u << 1,
+        digit                = 1u << 2,
+        hexadecimal_digit    = 1u << 3,
+        identifier_character = identifier_nondigit | digit,
+    };
+
+    struct char_class_table
     {
-        return std::strncmp(ptr, str.c_str(), str.size()) == 0;
-    }
+        unsigned char classes[256];
 
-    template <std::size_t N>
-    bool bump_if(const char*& ptr, const char (&str)[N])
-    {
-        if (starts_with(ptr, str))
+        char_class_table() noexcept : classes()
         {
-            ptr += N - 1;
-            return true;
+            for (auto c : {' ', '\t', '\n', '\r', '\v', '\f'})
+                classes[static_cast<unsigned char>(c)] = whitespace;
+
+            // technically \uXXX is allowed in identifiers as well,
+            // but I haven't seen that used ever
+            for (auto c = 'a'; c <= 'z'; ++c)
+                classes[static_cast<unsigned char>(c)] = identifier_nondigit;
+            for (auto c = 'A'; c <= 'Z'; ++c)
+                classes[static_cast<unsigned char>(c)] = identifier_nondigit;
+            classes[static_cast<unsigned char>('_')] = identifier_nondigit;
+            // extension
+            classes[static_cast<unsigned char>('$')] = identifier_nondigit;
+            // UTF-8 encoded characters, clang accepts them in identifiers
+            for (auto c = 0x80u; c <= 0xFFu; ++c)
+                classes[c] = identifier_nondigit;
+
+            for (auto c = '0'; c <= '9'; ++c)
+                classes[static_cast<unsigned char>(c)] = digit | hexadecimal_digit;
+            for (auto c = 'a'; c <= 'f'; ++c)
+                classes[static_cast<unsigned char>(c)] |= hexadecimal_digit;
+            for (auto c = 'A'; c <= 'F'; ++c)
+                classes[static_cast<unsigned char>(c)] |= hexadecimal_digit;
         }
-        else
-            return false;
-    }
 
-    bool bump_if(const char*& ptr, const std::string& str)
-    {
-        if (starts_with(ptr, str))
+        bool is(char c, unsigned char mask) const noexcept
         {
-            ptr += str.size();
-            return true;
+            return (classes[static_cast<unsigned char>(c)] & mask) != 0u;
         }
-        else
-            return false;
-    }
+    };
 
-    bool is_identifier_nondigit(char c)
+    const char_class_table& get_char_classes() noexcept
     {
-        // assume ASCII
-        if (c >= 'a' && c <= 'z')
-            return true;
-        else if (c >= 'A' && c <= 'Z')
-            return true;
-        else if (c == '_')
-            return true;
-        else
-            // technically \uXXX is allowed as well, but I haven't seen that used ever
-            return false;
-    }
-
-    bool is_digit(char c)
-    {
-        return c >= '0' && c <= '9';
+        static const char_class_table table;
+        return table;
     }
 
-    bool is_hexadecimal_digit(char c)
+    // tokenizes a null-terminated string straight into the builder,
+    // spellings are added as slices of the input wherever possible
+    class lexer
     {
-        return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
-    }
+    public:
+        lexer(const char* ptr, cpp_token_string::builder& builder) noexcept
+        : classes_(get_char_classes()), builder_(builder), ptr_(ptr)
+        {
+        }
 
-    type_safe::optional<std::string> bump_identifier(const char*& ptr)
-    {
-        if (is_identifier_nondigit(*ptr))
+        void tokenize()
         {
-            std::string result;
-            result += *ptr++;
+            while (*ptr_)
+            {
+                if (classes_.is(*ptr_, whitespace))
+                    skip_run(whitespace);
+                else if (classes_.is(*ptr_, digit) || (*ptr_ == '.' && classes_.is(ptr_[1], digit)))
+                    numeric_literal();
+                else if (classes_.is(*ptr_, identifier_nondigit))
+                {
+                    if (!prefixed_literal())
+                        identifier();
+                }
+                else if (*ptr_ == '\'')
+                    character_literal(ptr_);
+                else if (*ptr_ == '"')
+                    string_literal(ptr_);
+                else if (!digraph() && !punctuation())
+                {
+                    // not part of any token, like a stray backslash,
+                    // keep it so the string doesn't lose characters
+                    add_punctuation(ptr_, 1u);
+                    ++ptr_;
+                }
+            }
+        }
 
-            while (is_identifier_nondigit(*ptr) || is_digit(*ptr))
-                result += *ptr++;
+    private:
+        void add_token(cpp_token_kind kind, const char* begin)
+        {
+            builder_.add_token(kind, begin, std::size_t(ptr_ - begin));
+        }
 
-            return result;
+        void skip_run(unsigned char mask) noexcept
+        {
+            while (classes_.is(*ptr_, mask))
+                ++ptr_;
         }
-        else
-            return type_safe::nullopt;
-    }
 
-    type_safe::optional<cpp_token> identifier_token(const char*& ptr)
-    {
-        auto identifier = bump_identifier(ptr);
-        if (!identifier)
-            return type_safe::nullopt;
-
-        static constexpr const char* keywords[] = {"alignas",
-                                                   "alignof",
-                                                   "asm",
-                                                   "auto",
-                                                   "bool",
-                                                   "break",
-                                                   "case",
-                                                   "catch",
-                                                   "char",
-                                                   "char16_t",
-                                                   "char32_t",
-                                                   "class",
-                                                   "const",
-                                                   "constexpr",
-                                                   "const_cast",
-                                                   "continue",
-                                                   "decltype",
-                                                   "default",
-                                                   "delete",
-                                                   "do",
-                                                   "double",
-                                                   "dynamic_cast",
-                                                   "else",
-                                                   "enum",
-                                                   "explicit",
-                                                   "export",
-                                                   "extern",
-                                                   "false",
-                                                   "float",
-                                                   "for",
-                                                   "friend",
-                                                   "goto",
-                                                   "if",
-                                                   "inline",
-                                                   "int",
-                                                   "long",
-                                                   "mutable",
-                                                   "namespace",
-                                                   "new",
-                                                   "noexcept",
-                                                   "nullptr",
-                                                   "operator",
-                                                   "private",
-                                                   "protected",
-                                                   "public",
-                                                   "register",
-                                                   "reinterpret_cast",
-                                                   "return",
-                                                   "short",
-                                                   "signed",
-                                                   "sizeof",
-                                                   "static",
-                                                   "static_assert",
-                                                   "static_cast",
-                                                   "struct",
-                                                   "switch",
-                                                   "template",
-                                                   "this",
-                                                   "thread_local",
-                                                   "throw",
-                                                   "true",
-                                                   "try",
-                                                   "typedef",
-                                                   "typeid",
-                                                   "typename",
-                                                   "union",
-                                                   "unsigned",
-                                                   "using",
-                                                   "virtual",
-                                                   "void",
-                                                   "volatile",
-                                                   "wchar_t",
-                                                   "while"};
-        auto find_keyword = std::find(std::begin(keywords), std::end(keywords), identifier.value());
-        if (find_keyword != std::end(keywords))
-            return cpp_token(cpp_token_kind::keyword, identifier.value());
-        else if (identifier == "and")
-            return cpp_token(cpp_token_kind::punctuation, "&&");
-        else if (identifier == "and_eq")
-            return cpp_token(cpp_token_kind::punctuation, "&=");
-        else if (identifier == "bitand")
-            return cpp_token(cpp_token_kind::punctuation, "&");
-        else if (identifier == "bitor")
-            return cpp_token(cpp_token_kind::punctuation, "|");
-        else if (identifier == "compl")
-            return cpp_token(cpp_token_kind::punctuation, "~");
-        else if (identifier == "not")
-            return cpp_token(cpp_token_kind::punctuation, "!");
-        else if (identifier == "not_eq")
-            return cpp_token(cpp_token_kind::punctuation, "!=");
-        else if (identifier == "or")
-            return cpp_token(cpp_token_kind::punctuation, "||");
-        else if (identifier == "or_eq")
-            return cpp_token(cpp_token_kind::punctuation, "|=");
-        else if (identifier == "xor")
-            return cpp_token(cpp_token_kind::punctuation, "^");
-        else if (identifier == "xor_eq")
-            return cpp_token(cpp_token_kind::punctuation, "^=");
-        else
-            return cpp_token(cpp_token_kind::identifier, identifier.value());
-    }
+        //=== identifiers ===//
+        struct identifier_info
+        {
+            const char*    name;
+            cpp_token_kind kind;
+            const char*    spelling; // nullptr if it is the name
+        };
 
-    void append_udl_suffix(std::string& literal, const char*& ptr)
-    {
-        if (auto id = identifier_token(ptr))
-            literal += id.value().spelling;
-    }
+        // returns the keyword or alternative token, if it is one
+        static const identifier_info* lookup_identifier(const char* str, std::size_t length)
+        {
+            // sorted by name
+            static constexpr identifier_info identifiers[] = {
+        {"alignas", cpp_token_kind::keyword, nullptr},
+        {"alignof", cpp_token_kind::keyword, nullptr},
+        {"and", cpp_token_kind::punctuation, "&&"},
+        {"and_eq", cpp_token_kind::punctuation, "&="},
+        {"asm", cpp_token_kind::keyword, nullptr},
+        {"auto", cpp_token_kind::keyword, nullptr},
+        {"bitand", cpp_token_kind::punctuation, "&"},
+        {"bitor", cpp_token_kind::punctuation, "|"},
+        {"bool", cpp_token_kind::keyword, nullptr},
+        {"break", cpp_token_kind::keyword, nullptr},
+        {"case", cpp_token_kind::keyword, nullptr},
+        {"catch", cpp_token_kind::keyword, nullptr},
+        {"char", cpp_token_kind::keyword, nullptr},
+        {"char16_t", cpp_token_kind::keyword, nullptr},
+        {"char32_t", cpp_token_kind::keyword, nullptr},
+        {"class", cpp_token_kind::keyword, nullptr},
+        {"compl", cpp_token_kind::punctuation, "~"},
+        {"const", cpp_token_kind::keyword, nullptr},
+        {"const_cast", cpp_token_kind::keyword, nullptr},
+        {"constexpr", cpp_token_kind::keyword, nullptr},
+        {"continue", cpp_token_kind::keyword, nullptr},
+        {"decltype", cpp_token_kind::keyword, nullptr},
+        {"default", cpp_token_kind::keyword, nullptr},
+        {"delete", cpp_token_kind::keyword, nullptr},
+        {"do", cpp_token_kind::keyword, nullptr},
+        {"double", cpp_token_kind::keyword, nullptr},
+        {"dynamic_cast", cpp_token_kind::keyword, nullptr},
+        {"else", cpp_token_kind::keyword, nullptr},
+        {"enum", cpp_token_kind::keyword, nullptr},
+        {"explicit", cpp_token_kind::keyword, nullptr},
+        {"export", cpp_token_kind::keyword, nullptr},
+        {"extern", cpp_token_kind::keyword, nullptr},
+        {"false", cpp_token_kind::keyword, nullptr},
+        {"float", cpp_token_kind::keyword, nullptr},
+        {"for", cpp_token_kind::keyword, nullptr},
+        {"friend", cpp_token_kind::keyword, nullptr},
+        {"goto", cpp_token_kind::keyword, nullptr},
+        {"if", cpp_token_kind::keyword, nullptr},
+        {"inline", cpp_token_kind::keyword, nullptr},
+        {"int", cpp_token_kind::keyword, nullptr},
+        {"long", cpp_token_kind::keyword, nullptr},
+        {"mutable", cpp_token_kind::keyword, nullptr},
+        {"namespace", cpp_token_kind::keyword, nullptr},
+        {"new", cpp_token_kind::keyword, nullptr},
+        {"noexcept", cpp_token_kind::keyword, nullptr},
+        {"not", cpp_token_kind::punctuation, "!"},
+        {"not_eq", cpp_token_kind::punctuation, "!="},
+        {"nullptr", cpp_token_kind::keyword, nullptr},
+        {"operator", cpp_token_kind::keyword, nullptr},
+        {"or", cpp_token_kind::punctuation, "||"},
+        {"or_eq", cpp_token_kind::punctuation, "|="},
+        {"private", cpp_token_kind::keyword, nullptr},
+        {"protected", cpp_token_kind::keyword, nullptr},
+        {"public", cpp_token_kind::keyword, nullptr},
+        {"register", cpp_token_kind::keyword, nullptr},
+        {"reinterpret_cast", cpp_token_kind::keyword, nullptr},
+        {"return", cpp_token_kind::keyword, nullptr},
+        {"short", cpp_token_kind::keyword, nullptr},
+        {"signed", cpp_token_kind::keyword, nullptr},
+        {"sizeof", cpp_token_kind::keyword, nullptr},
+        {"static", cpp_token_kind::keyword, nullptr},
+        {"static_assert", cpp_token_kind::keyword, nullptr},
+        {"static_cast", cpp_token_kind::keyword, nullptr},
+        {"struct", cpp_token_kind::keyword, nullptr},
+        {"switch", cpp_token_kind::keyword, nullptr},
+        {"template", cpp_token_kind::keyword, nullptr},
+        {"this", cpp_token_kind::keyword, nullptr},
+        {"thread_local", cpp_token_kind::keyword, nullptr},
+        {"throw", cpp_token_kind::keyword, nullptr},
+        {"true", cpp_token_kind::keyword, nullptr},
+        {"try", cpp_token_kind::keyword, nullptr},
+        {"typedef", cpp_token_kind::keyword, nullptr},
+        {"typeid", cpp_token_kind::keyword, nullptr},
+        {"typename", cpp_token_kind::keyword, nullptr},
+        {"union", cpp_token_kind::keyword, nullptr},
+        {"unsigned", cpp_token_kind::keyword, nullptr},
+        {"using", cpp_token_kind::keyword, nullptr},
+        {"virtual", cpp_token_kind::keyword, nullptr},
+        {"void", cpp_token_kind::keyword, nullptr},
+        {"volatile", cpp_token_kind::keyword, nullptr},
+        {"wchar_t", cpp_token_kind::keyword, nullptr},
+        {"while", cpp_token_kind::keyword, nullptr},
+        {"xor", cpp_token_kind::punctuation, "^"},
+        {"xor_eq", cpp_token_kind::punctuation, "^="},
+            };
+
+            auto iter = std::lower_bound(std::begin(identifiers), std::end(identifiers), str,
+                                         [&](const identifier_info& info, const char* value) {
+                                             return compare(info.name, value, length) < 0;
+                                         });
+            if (iter != std::end(identifiers) && compare(iter->name, str, length) == 0)
+                return iter;
+            else
+                return nullptr;
+        }
 
-    template <typename DigitPredicate>
-    std::string parse_digit_sequence(const char*& ptr, DigitPredicate is_digit)
-    {
-        std::string result;
-        for (; is_digit(*ptr) || *ptr == '\''; ++ptr)
-            if (*ptr != '\'')
-                result += *ptr;
-        DEBUG_ASSERT(result.empty() || result.back() != '\'', detail::assert_handler{});
-        return result;
-    }
+        // compares the null-terminated name with the string of the given length
+        static int compare(const char* name, const char* str, std::size_t length) noexcept
+        {
+            auto result = std::strncmp(name, str, length);
+            if (result != 0)
+                return result;
+            // name has str as a prefix, so it is greater if it has more characters
+            return name[length] == '\0' ? 0 : 1;
+        }
 
-    void append_integer_suffix(std::string& literal, const char*& ptr)
-    {
-        auto append_unsigned_suffix = [](std::string& literal, const char*& ptr) {
-            if (*ptr == 'u' || *ptr == 'U')
-            {
-                literal += *ptr++;
-                return true;
-            }
+        void identifier()
+        {
+            auto begin = ptr_;
+            skip_run(identifier_character);
+
+            auto info = lookup_identifier(begin, std::size_t(ptr_ - begin));
+            if (!info)
+                add_token(cpp_token_kind::identifier, begin);
+            else if (!info->spelling)
+                add_token(info->kind, begin);
             else
-                return false;
-        };
-        auto append_long_suffix = [](std::string& literal, const char*& ptr) {
-            if (starts_with(ptr, "ll") || starts_with(ptr, "LL"))
-            {
-                literal += *ptr++;
-                literal += *ptr++;
-                return true;
-            }
-            else if (*ptr == 'l' || *ptr == 'L')
+                builder_.add_token(info->kind, info->spelling, std::strlen(info->spelling));
+        }
+
+        void udl_suffix() noexcept
+        {
+            if (classes_.is(*ptr_, identifier_nondigit))
+                skip_run(identifier_character);
+        }
+
+        //=== numeric literals ===//
+        template <typename DigitPredicate>
+        void digit_sequence_if(DigitPredicate is_digit) noexcept
+        {
+            for (; is_digit(*ptr_) || *ptr_ == '\''; ++ptr_)
+                if (*ptr_ == '\'')
+                    has_separator_ = true;
+        }
+
+        void digit_sequence(unsigned char mask) noexcept
+        {
+            digit_sequence_if([&](char c) { return classes_.is(c, mask); });
+        }
+
+        bool floating_point_exponent() noexcept
+        {
+            if (*ptr_ == 'e' || *ptr_ == 'E' || *ptr_ == 'p' || *ptr_ == 'P')
             {
-                literal += *ptr++;
+                ++ptr_;
+                if (*ptr_ == '+' || *ptr_ == '-')
+                    ++ptr_;
+                digit_sequence(digit);
                 return true;
             }
             else
                 return false;
-        };
-
-        if (append_unsigned_suffix(literal, ptr))
-            append_long_suffix(literal, ptr);
-        else if (append_long_suffix(literal, ptr))
-            append_unsigned_suffix(literal, ptr);
-        else
-            append_udl_suffix(literal, ptr);
-    }
-
-    void append_floating_point_suffix(std::string& literal, const char*& ptr)
-    {
-        if (*ptr == 'f' || *ptr == 'F')
-            literal += *ptr++;
-        else if (*ptr == 'l' || *ptr == 'L')
-            literal += *ptr++;
-        else
-            append_udl_suffix(literal, ptr);
-    }
+        }
 
-    type_safe::optional<std::string> parse_floating_point_exponent(const char*& ptr)
-    {
-        if (*ptr == 'e' || *ptr == 'E' || *ptr == 'p' || *ptr == 'P')
+        void integer_suffix() noexcept
         {
-            std::string result;
-            result += *ptr++;
-            if (*ptr == '+' || *ptr == '-')
-                result += *ptr++;
-
-            result += parse_digit_sequence(ptr, &is_digit);
-            return result;
+            auto unsigned_suffix = [&] {
+                if (*ptr_ == 'u' || *ptr_ == 'U')
+                {
+                    ++ptr_;
+                    return true;
+                }
+                else
+                    return false;
+            };
+            auto long_suffix = [&] {
+                if ((ptr_[0] == 'l' && ptr_[1] == 'l') || (ptr_[0] == 'L' && ptr_[1] == 'L'))
+                {
+                    ptr_ += 2;
+                    return true;
+                }
+                else if (*ptr_ == 'l' || *ptr_ == 'L')
+                {
+                    ++ptr_;
+                    return true;
+                }
+                else
+                    return false;
+            };
+
+            if (unsigned_suffix())
+                long_suffix();
+            else if (long_suffix())
+                unsigned_suffix();
+            else
+                udl_suffix();
         }
-        else
-            return type_safe::nullopt;
-    }
 
-    type_safe::optional<cpp_token> numeric_literal_token(const char*& ptr)
-    {
-        if (starts_with(ptr, "0b") || starts_with(ptr, "0B")) // binary integer literal
+        void floating_point_suffix() noexcept
         {
-            std::string result;
-            result += *ptr++;
-            result += *ptr++;
-            result += parse_digit_sequence(ptr, [](char c) { return c == '0' || c == '1'; });
-            append_integer_suffix(result, ptr);
-            return cpp_token(cpp_token_kind::int_literal, result);
+            if (*ptr_ == 'f' || *ptr_ == 'F' || *ptr_ == 'l' || *ptr_ == 'L')
+                ++ptr_;
+            else
+                udl_suffix();
         }
-        else if (starts_with(ptr, "0x") || starts_with(ptr, "0X")) // hexadecimal literal
+
+        void numeric_literal()
         {
-            std::string result;
-            result += *ptr++;
-            result += *ptr++;
-            result += parse_digit_sequence(ptr, &is_hexadecimal_digit);
+            auto begin     = ptr_;
+            auto is_float  = false;
+            has_separator_ = false;
 
-            auto is_float = false;
-            if (*ptr == '.')
+            if (ptr_[0] == '0' && (ptr_[1] == 'b' || ptr_[1] == 'B')) // binary integer literal
             {
-                // floating point hexadecimal
-                is_float = true;
-                result += *ptr++;
-                result += parse_digit_sequence(ptr, &is_hexadecimal_digit);
+                ptr_ += 2;
+                digit_sequence_if([](char c) { return c == '0' || c == '1'; });
             }
-
-            if (auto exp = parse_floating_point_exponent(ptr))
+            else if (ptr_[0] == '0' && (ptr_[1] == 'x' || ptr_[1] == 'X')) // hexadecimal literal
             {
-                is_float = true;
+                ptr_ += 2;
+                digit_sequence(hexadecimal_digit);
+                if (*ptr_ == '.')
+                {
+                    // floating point hexadecimal
+                    is_float = true;
+                    ++ptr_;
+                    digit_sequence(hexadecimal_digit);
+                }
                 // floating point exponent
-                result += exp.value();
+                is_float |= floating_point_exponent();
             }
-
-            if (is_float)
-                append_floating_point_suffix(result, ptr);
-            else
-                append_integer_suffix(result, ptr);
-
-            return cpp_token(is_float ? cpp_token_kind::float_literal : cpp_token_kind::int_literal,
-                             result);
-        }
-        else if (is_digit(*ptr)) // octal and decimal literals
-        {
-            std::string result;
-            result += parse_digit_sequence(ptr, &is_digit);
-
-            auto is_float = false;
-            if (*ptr == '.')
+            else if (*ptr_ == '.') // floating point fraction
             {
-                // floating point decimal
                 is_float = true;
-                result += *ptr++;
-                result += parse_digit_sequence(ptr, &is_hexadecimal_digit);
+                ++ptr_;
+                digit_sequence(digit);
+                floating_point_exponent();
             }
-
-            if (auto exp = parse_floating_point_exponent(ptr))
+            else // octal and decimal literals
             {
+                digit_sequence(digit);
+                if (*ptr_ == '.')
+                {
+                    // floating point decimal
+                    is_float = true;
+                    ++ptr_;
+                    digit_sequence(digit);
+                }
                 // floating point exponent
-                is_float = true;
-                result += exp.value();
+                is_float |= floating_point_exponent();
             }
 
             if (is_float)
-                append_floating_point_suffix(result, ptr);
+                floating_point_suffix();
             else
-                append_integer_suffix(result, ptr);
+                integer_suffix();
 
-            return cpp_token(is_float ? cpp_token_kind::float_literal : cpp_token_kind::int_literal,
-                             result);
+            auto kind = is_float ? cpp_token_kind::float_literal : cpp_token_kind::int_literal;
+            if (!has_separator_)
+                add_token(kind, begin);
+            else
+            {
+                // digit separators are not part of the spelling
+                std::string spelling;
+                std::remove_copy(begin, ptr_, std::back_inserter(spelling), '\'');
+                builder_.add_token(kind, spelling.c_str(), spelling.length());
+            }
         }
-        else if (*ptr == '.' && is_digit(ptr[1]))
-        {
-            std::string result;
 
-            // floating point fraction
-            result += *ptr++;
-            result += parse_digit_sequence(ptr, &is_digit);
-
-            if (auto exp = parse_floating_point_exponent(ptr))
-                result += exp.value();
-
-            append_floating_point_suffix(result, ptr);
-            return cpp_token(cpp_token_kind::float_literal, result);
+        //=== character and string literals ===//
+        // parses a literal starting with an encoding prefix or raw string literal
+        bool prefixed_literal()
+        {
+            auto begin = ptr_;
+            if (ptr_[0] == 'u' && ptr_[1] == '8')
+                ptr_ += 2;
+            else if (*ptr_ == 'u' || *ptr_ == 'U' || *ptr_ == 'L')
+                ++ptr_;
+
+            if (*ptr_ == '\'')
+                character_literal(begin);
+            else if (*ptr_ == '"' || (ptr_[0] == 'R' && ptr_[1] == '"'))
+                string_literal(begin);
+            else
+            {
+                ptr_ = begin;
+                return false;
+            }
+            return true;
         }
-        else
-            return type_safe::nullopt;
-    }
 
-    type_safe::optional<std::string> parse_encoding_prefix(const char*& ptr)
-    {
-        if (bump_if(ptr, "u8"))
-            return "u8";
-        else if (bump_if(ptr, "u"))
-            return "u";
-        else if (bump_if(ptr, "U"))
-            return "U";
-        else if (bump_if(ptr, "L"))
-            return "L";
-        else
-            return type_safe::nullopt;
-    }
-
-    type_safe::optional<cpp_token> character_literal(const char*& ptr)
-    {
-        auto save   = ptr;
-        auto prefix = parse_encoding_prefix(ptr);
-        if (*ptr != '\'')
+        // skips until the unescaped terminator,
+        // an unterminated literal extends to the end of the string
+        void skip_quoted(char terminator) noexcept
         {
-            ptr = save;
-            return type_safe::nullopt;
+            ++ptr_;
+            while (*ptr_ && *ptr_ != terminator)
+            {
+                if (*ptr_ == '\\' && ptr_[1])
+                    ++ptr_;
+                ++ptr_;
+            }
+            if (*ptr_)
+                ++ptr_;
         }
-        else
+
+        void character_literal(const char* begin)
         {
-            auto result = prefix.value_or("");
-            result += *ptr++;
+            skip_quoted('\'');
+            udl_suffix();
+            add_token(cpp_token_kind::char_literal, begin);
+        }
 
-            while (*ptr != '\'')
+        void string_literal(const char* begin)
+        {
+            if (*ptr_ == 'R')
             {
-                DEBUG_ASSERT(*ptr, detail::assert_handler{});
-
-                if (*ptr == '\\')
-                    result += *ptr++;
-                result += *ptr++;
+                // raw string literal, ends at )delimiter"
+                ptr_ += 2;
+                auto delimiter = ptr_;
+                while (*ptr_ && *ptr_ != '(')
+                    ++ptr_;
+
+                std::string terminator = ")";
+                terminator.append(delimiter, ptr_);
+                terminator += '"';
+
+                auto end = std::strstr(ptr_, terminator.c_str());
+                ptr_     = end ? end + terminator.size() : ptr_ + std::strlen(ptr_);
             }
-            result += *ptr++;
+            else
+                // regular string literal
+                skip_quoted('"');
 
-            append_udl_suffix(result, ptr);
-            return cpp_token(cpp_token_kind::char_literal, result);
+            udl_suffix();
+            add_token(cpp_token_kind::string_literal, begin);
         }
-    }
 
-    type_safe::optional<cpp_token> string_literal(const char*& ptr)
-    {
-        auto save   = ptr;
-        auto prefix = parse_encoding_prefix(ptr);
-        if (starts_with(ptr, "R\""))
+        //=== punctuation ===//
+        void add_punctuation(const char* spelling, std::size_t length)
         {
-            // raw string literal
-            auto result = prefix.value_or("");
-            result += *ptr++;
-            result += *ptr++;
-
-            std::string terminator;
-            terminator += ")";
-            while (*ptr != '(')
+            builder_.add_token(cpp_token_kind::punctuation, spelling, length);
+        }
+
+        bool digraph()
+        {
+            auto c0 = ptr_[0], c1 = ptr_[1];
+            if (c0 == '<' && c1 == '%')
+                add_punctuation("{", 1u);
+            else if (c0 == '%' && c1 == '>')
+                add_punctuation("}", 1u);
+            else if (c0 == '<' && c1 == ':')
             {
-                result += *ptr;
-                terminator += *ptr++;
+                // don't detect digraph in std::vector<::std::string>
+                if (ptr_[2] == ':' && ptr_[3] != ':' && ptr_[3] != '>')
+                    return false;
+                add_punctuation("[", 1u);
             }
-            result += *ptr++;
-            terminator += '"';
-
-            while (!bump_if(ptr, terminator))
+            else if (c0 == ':' && c1 == '>')
+                add_punctuation("]", 1u);
+            else if (c0 == '%' && c1 == ':')
             {
-                DEBUG_ASSERT(ptr, detail::assert_handler{});
-                result += *ptr++;
+                if (ptr_[2] == '%' && ptr_[3] == ':')
+                {
+                    add_punctuation("##", 2u);
+                    ptr_ += 2;
+                }
+                else
+                    add_punctuation("#", 1u);
             }
-            result += terminator;
+            else
+                return false;
 
-            append_udl_suffix(result, ptr);
-            return cpp_token(cpp_token_kind::string_literal, result);
+            ptr_ += 2;
+            return true;
         }
-        else if (starts_with(ptr, "\""))
-        {
-            // regular string literal
-            auto result = prefix.value_or("");
-            result += *ptr++;
 
-            while (*ptr != '"')
+        // returns the length of the longest punctuation token at the pointer, 0 if there is none
+        static std::size_t punctuation_length(const char* ptr) noexcept
+        {
+            switch (ptr[0])
             {
-                DEBUG_ASSERT(*ptr, detail::assert_handler{});
-
-                if (*ptr == '\\')
-                    result += *ptr++;
-                result += *ptr++;
+            case '#':
+            case ':':
+                // ## ::
+                return ptr[1] == ptr[0] ? 2u : 1u;
+            case '.':
+                // ... .*
+                if (ptr[1] == '.' && ptr[2] == '.')
+                    return 3u;
+                return ptr[1] == '*' ? 2u : 1u;
+            case '+':
+                // += ++
+                return ptr[1] == '=' || ptr[1] == '+' ? 2u : 1u;
+            case '-':
+                // ->* -> -- -=
+                if (ptr[1] == '>')
+                    return ptr[2] == '*' ? 3u : 2u;
+                return ptr[1] == '-' || ptr[1] == '=' ? 2u : 1u;
+            case '*':
+            case '/':
+            case '%':
+            case '^':
+            case '!':
+            case '=':
+                // *= /= %= ^= != ==
+                return ptr[1] == '=' ? 2u : 1u;
+            case '&':
+            case '|':
+                // &= && |= ||
+                return ptr[1] == '=' || ptr[1] == ptr[0] ? 2u : 1u;
+            case '<':
+            case '>':
+                // <<= << <= >>= >> >=
+                if (ptr[1] == ptr[0])
+                    return ptr[2] == '=' ? 3u : 2u;
+                return ptr[1] == '=' ? 2u : 1u;
+            case '~':
+            case ';':
+            case '?':
+            case ',':
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case '(':
+            case ')':
+                return 1u;
+            default:
+                return 0u;
             }
-            result += *ptr++;
-
-            append_udl_suffix(result, ptr);
-            return cpp_token(cpp_token_kind::string_literal, result);
         }
-        else
+
+        bool punctuation()
         {
-            ptr = save;
-            return type_safe::nullopt;
+            auto length = punctuation_length(ptr_);
+            if (length == 0u)
+                return false;
+            add_punctuation(ptr_, length);
+            ptr_ += length;
+            return true;
         }
-    }
-
-    type_safe::optional<cpp_token> digraph_token(const char*& ptr)
-    {
-        if (bump_if(ptr, "<%"))
-            return cpp_token(cpp_token_kind::punctuation, "{");
-        else if (bump_if(ptr, "%>"))
-            return cpp_token(cpp_token_kind::punctuation, "}");
-        else if (starts_with(ptr, "<::") && ptr[3] != ':' && ptr[3] != '>')
-            // don't detect digraph in std::vector<::std::string>
-            return type_safe::nullopt;
-        else if (bump_if(ptr, "<:"))
-            return cpp_token(cpp_token_kind::punctuation, "[");
-        else if (bump_if(ptr, ":>"))
-            return cpp_token(cpp_token_kind::punctuation, "]");
-        else if (bump_if(ptr, "%:%:"))
-            return cpp_token(cpp_token_kind::punctuation, "##");
-        else if (bump_if(ptr, "%:"))
-            return cpp_token(cpp_token_kind::punctuation, "#");
-        else
-            return type_safe::nullopt;
-    }
 
-    type_safe::optional<cpp_token> punctuation_token(const char*& ptr)
-    {
-        static constexpr const char* punctuations[] = {
-            // tokens staring with #
-            "##",
-            "#",
-            // tokens starting with .
-            "...",
-            ".*",
-            ".",
-            // tokens starting with :
-            "::",
-            ":",
-            // tokens starting with +
-            "+=",
-            "++",
-            "+",
-            // tokens starting with -
-            "->*",
-            "->",
-            "--",
-            "-=",
-            "-",
-            // tokens starting with *
-            "*=",
-            "*",
-            // tokens starting with /
-            "/=",
-            "/",
-            // tokens starting with %
-            "%=",
-            "%",
-            // tokens starting with ^
-            "^=",
-            "^",
-            // tokens starting with &
-            "&=",
-            "&&",
-            "&",
-            // tokens starting with |
-            "|=",
-            "||",
-            "|",
-            // tokens starting with <
-            "<<=",
-            "<<",
-            "<=",
-            "<",
-            // tokens starting with >
-            ">>=",
-            ">>",
-            ">=",
-            ">",
-            // tokens starting with !
-            "!=",
-            "!",
-            // tokens starting with =
-            "==",
-            "=",
-            // single tokens
-            "~",
-            ";",
-            "?",
-            ",",
-            "{",
-            "}",
-            "[",
-            "]",
-            "(",
-            ")",
-        };
-
-        for (auto punct : punctuations)
-            if (bump_if(ptr, punct))
-                return cpp_token(cpp_token_kind::punctuation, punct);
-
-        return type_safe::nullopt;
-    }
+        const char_class_table&    classes_;
+        cpp_token_string::builder& builder_;
+        const char*                ptr_;
+        bool                       has_separator_ = false;
+    };
 } // namespace
 
 cpp_token_string cpp_token_string::tokenize(std::string str)
 {
     cpp_token_string::builder builder;
-
-    auto ptr = str.c_str();
-    while (*ptr)
-    {
-        if (auto num = numeric_literal_token(ptr))
-            builder.add_token(num.value());
-        else if (auto char_lit = character_literal(ptr))
-            builder.add_token(char_lit.value());
-        else if (auto str_lit = string_literal(ptr))
-            builder.add_token(str_lit.value());
-        else if (auto digraphs = digraph_token(ptr))
-            builder.add_token(digraphs.value());
-        else if (auto punct = punctuation_token(ptr))
-            builder.add_token(punct.value());
-        else if (auto id = identifier_token(ptr))
-            builder.add_token(id.value());
-        else if (*ptr == ' ' || *ptr == '\t' || *ptr == '\n' || *ptr == '\r')
-            ++ptr;
-        else
-            DEBUG_UNREACHABLE(detail::assert_handler{});
-    }
-
+    lexer(str.c_str(), builder).tokenize();
     return builder.finish();
 }
 
@@ -607,22 +591,59 @@ namespace
     }
 } // namespace
 
+cpp_token_string::cpp_token_string(std::string buffer, const std::vector<token_info>& tokens)
+{
+    if (tokens.empty())
+        return;
+    buffer_ = std::make_shared<const std::string>(std::move(buffer));
+
+    tokens_.reserve(tokens.size());
+    for (auto i = 0u; i != tokens.size(); ++i)
+    {
+        auto offset = tokens[i].offset;
+        auto end    = i + 1u == tokens.size() ? buffer_->size() : tokens[i + 1u].offset;
+        tokens_.emplace_back(tokens[i].kind,
+                             cpp_token_spelling(buffer_->c_str() + offset, end - offset - 1u));
+    }
+}
+
 std::string cpp_token_string::as_string() const
 {
     std::string result;
-    for (auto& token : tokens_)
+    result.reserve(buffer_ ? buffer_->size() : 0u);
+    for (auto& token : *this)
     {
         DEBUG_ASSERT(!token.spelling.empty(), detail::assert_handler{});
         if (!result.empty() && is_identifier(result.back()) && is_identifier(token.spelling[0u]))
             result += ' ';
-        result += token.spelling;
+        result.append(token.spelling.c_str(), token.spelling.length());
     }
     return result;
 }
 
 bool cppast::operator==(const cpp_token_string& lhs, const cpp_token_string& rhs)
 {
-    if (lhs.tokens_.size() != rhs.tokens_.size())
-        return false;
-    return std::equal(lhs.tokens_.begin(), lhs.tokens_.end(), rhs.tokens_.begin());
+    // the spellings are separated by null characters,
+    // so equal buffers mean the same number of tokens with the same spellings
+    if (!lhs.buffer_ || !rhs.buffer_)
+        return lhs.empty() && rhs.empty();
+    return *lhs.buffer_ == *rhs.buffer_;
+}
+
+const cpp_token_string& detail::lazy_token_string::get_slice() const
+{
+    auto cached = std::atomic_load(&slice_tokens_);
+    if (!cached)
+    {
+        // another thread might tokenize it as well, use the first one then
+        std::shared_ptr<const cpp_token_string> tokens = std::make_shared<const cpp_token_string>(
+            cpp_token_string::tokenize(buffer_->substr(offset_, length_)));
+        std::shared_ptr<const cpp_token_string> expected;
+        if (std::atomic_compare_exchange_strong(&slice_tokens_, &expected, tokens))
+            cached = std::move(tokens);
+        else
+            cached = std::move(expected);
+    }
+    // the cached string is never replaced, so it lives as long as this
+    return *cached;
 }
@@ -0,0 +1,177 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cppast/lazy_entity_index.hpp>
+
+#include <cppast/cpp_file.hpp>
+#include <cppast/visitor.hpp>
+
+using namespace cppast;
+
+namespace
+{
+    const cpp_file& get_file(const cpp_entity& e)
+    {
+        auto cur = &e;
+        while (cur->parent())
+            cur = &cur->parent().value();
+        return static_cast<const cpp_file&>(*cur);
+    }
+
+    std::size_t count_entities(const cpp_file& file)
+    {
+        auto count = std::size_t(0u);
+        visit(file, [&](const cpp_entity&, const visitor_info& info) {
+            if (info.is_new_entity())
+                ++count;
+        });
+        return count;
+    }
+} // namespace
+
+lazy_entity_index::~lazy_entity_index() noexcept
+{
+    // unregister before the files are destroyed
+    for (auto& loaded : files_)
+        idx_.unregister_file(*loaded.file);
+}
+
+std::shared_ptr<const cpp_entity> lazy_entity_index::lookup(const cpp_entity_id& id)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto                         result = touch(idx_.lookup_definition(id));
+    if (!result)
+    {
+        // the snapshot stores the file of the definition, if there is one,
+        // so this prefers the definition like cpp_entity_index::lookup() does
+        auto info = snapshot_.lookup(id);
+        if (info)
+            load_file_impl(lock, info.value().file);
+        result = touch(idx_.lookup(id));
+    }
+    return result;
+}
+
+std::shared_ptr<const cpp_entity> lazy_entity_index::lookup_definition(
+    const cpp_entity_id& id)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto                         result = touch(idx_.lookup_definition(id));
+    if (!result)
+    {
+        // if there is a definition, the snapshot stores its file
+        auto info = snapshot_.lookup(id);
+        if (info && info.value().is_definition && load_file_impl(lock, info.value().file))
+            result = touch(idx_.lookup_definition(id));
+    }
+    return result;
+}
+
+std::shared_ptr<const cpp_file> lazy_entity_index::load_file(const std::string& path)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return load_file_impl(lock, path);
+}
+
+std::size_t lazy_entity_index::loaded_files() const noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return files_.size();
+}
+
+std::size_t lazy_entity_index::loaded_entities() const noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return used_;
+}
+
+std::shared_ptr<const cpp_file> lazy_entity_index::load_file_impl(
+    std::unique_lock<std::mutex>& lock, const std::string& path)
+{
+    auto iter = paths_.find(path);
+    if (iter != paths_.end())
+    {
+        files_.splice(files_.begin(), files_, iter->second);
+        return files_.front().file;
+    }
+
+    auto loading = loading_.find(path);
+    if (loading != loading_.end())
+    {
+        // wait for the other thread instead of loading it twice
+        auto future = loading->second;
+        lock.unlock();
+        future.wait();
+        lock.lock();
+
+        iter = paths_.find(path);
+        if (iter != paths_.end())
+            files_.splice(files_.begin(), files_, iter->second);
+        // it could have been unloaded already, but the pointer still keeps it alive
+        return future.get();
+    }
+
+    // load it without holding the lock, so other files can be looked up and loaded meanwhile
+    std::promise<std::shared_ptr<cpp_file>> promise;
+    loading_.emplace(path, promise.get_future().share());
+    lock.unlock();
+
+    std::shared_ptr<cpp_file> file;
+    try
+    {
+        file = loader_(path, idx_);
+    }
+    catch (...)
+    {
+        lock.lock();
+        loading_.erase(path);
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    lock.lock();
+    loading_.erase(path);
+    promise.set_value(file);
+    if (!file)
+        return nullptr;
+
+    auto count = count_entities(*file);
+    files_.push_front(loaded_file{path, std::move(file), count});
+    paths_.emplace(path, files_.begin());
+    loaded_.emplace(files_.front().file.get(), files_.begin());
+    used_ += count;
+
+    auto result = files_.front().file;
+    evict();
+    return result;
+}
+
+std::shared_ptr<const cpp_entity> lazy_entity_index::touch(
+    type_safe::optional_ref<const cpp_entity> e)
+{
+    if (!e)
+        return nullptr;
+
+    // the file name need not be the path given to the loader, so use the file itself
+    auto iter = loaded_.find(&get_file(e.value()));
+    if (iter == loaded_.end())
+        // another thread is still loading the file
+        return nullptr;
+    files_.splice(files_.begin(), files_, iter->second);
+    // share ownership with the file, so the entity stays alive even if the file is unloaded
+    return std::shared_ptr<const cpp_entity>(iter->second->file, &e.value());
+}
+
+void lazy_entity_index::evict()
+{
+    while (used_ > budget_ && files_.size() > 1u)
+    {
+        auto& loaded = files_.back();
+        idx_.unregister_file(*loaded.file);
+        used_ -= loaded.entity_count;
+        paths_.erase(loaded.path);
+        loaded_.erase(loaded.file.get());
+        files_.pop_back();
+    }
+}
@@ -0,0 +1,178 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include "child_process.hpp"
+
+#ifdef _WIN32
+#include <process.hpp>
+#else
+#include <cerrno>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+#include <cppast/libclang_parser.hpp>
+
+using namespace cppast;
+
+#ifdef _WIN32
+int detail::run_process(const std::string& cmd, const process_output& on_stdout,
+                        const process_output& on_stderr)
+{
+    TinyProcessLib::Process process(cmd, "", on_stdout, on_stderr);
+    return process.get_exit_status();
+}
+#else
+namespace
+{
+    // the pipe must not leak into processes spawned by other threads in the meantime
+    void make_pipe(int (&fds)[2])
+    {
+#if defined(__linux__)
+        if (::pipe2(fds, O_CLOEXEC) != 0)
+            throw libclang_error("unable to create pipe for child process");
+#else
+        if (::pipe(fds) != 0)
+            throw libclang_error("unable to create pipe for child process");
+        ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+    }
+
+    class file_actions
+    {
+    public:
+        file_actions()
+        {
+            if (posix_spawn_file_actions_init(&actions_) != 0)
+                throw libclang_error("unable to spawn child process");
+        }
+
+        file_actions(const file_actions&) = delete;
+        file_actions& operator=(const file_actions&) = delete;
+
+        ~file_actions() noexcept
+        {
+            posix_spawn_file_actions_destroy(&actions_);
+        }
+
+        posix_spawn_file_actions_t* get() noexcept
+        {
+            return &actions_;
+        }
+
+    private:
+        posix_spawn_file_actions_t actions_;
+    };
+
+    // reads from both pipes until they are closed
+    void read_output(int out, int err, const detail::process_output& on_stdout,
+                     const detail::process_output& on_stderr)
+    {
+        pollfd fds[] = {{out, POLLIN, 0}, {err, POLLIN, 0}};
+        const detail::process_output* callbacks[] = {&on_stdout, &on_stderr};
+
+        char buffer[4096];
+        auto open = 2;
+        while (open > 0)
+        {
+            if (::poll(fds, 2, -1) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw libclang_error("unable to read output of child process");
+            }
+
+            for (auto i = 0; i != 2; ++i)
+            {
+                if (fds[i].fd < 0 || fds[i].revents == 0)
+                    continue;
+
+                auto n = ::read(fds[i].fd, buffer, sizeof(buffer));
+                if (n < 0 && errno == EINTR)
+                    continue;
+                else if (n <= 0)
+                {
+                    // closed, ignore from now on
+                    fds[i].fd = -1;
+                    --open;
+                }
+                else if (*callbacks[i])
+                    (*callbacks[i])(buffer, std::size_t(n));
+            }
+        }
+    }
+} // namespace
+
+int detail::run_process(const std::string& cmd, const process_output& on_stdout,
+                        const process_output& on_stderr)
+{
+    int out[2], err[2];
+    make_pipe(out);
+    try
+    {
+        make_pipe(err);
+    }
+    catch (...)
+    {
+        ::close(out[0]);
+        ::close(out[1]);
+        throw;
+    }
+
+    pid_t pid;
+    auto  spawn_result = [&] {
+        file_actions actions;
+        posix_spawn_file_actions_addopen(actions.get(), STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_adddup2(actions.get(), out[1], STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(actions.get(), err[1], STDERR_FILENO);
+
+        const char* args[] = {"sh", "-c", cmd.c_str(), nullptr};
+        return posix_spawn(&pid, "/bin/sh", actions.get(), nullptr, const_cast<char**>(args),
+                           environ);
+    }();
+    ::close(out[1]);
+    ::close(err[1]);
+
+    if (spawn_result != 0)
+    {
+        ::close(out[0]);
+        ::close(err[0]);
+        throw libclang_error("unable to spawn child process for command '" + cmd + "'");
+    }
+
+    try
+    {
+        read_output(out[0], err[0], on_stdout, on_stderr);
+    }
+    catch (...)
+    {
+        ::close(out[0]);
+        ::close(err[0]);
+        ::waitpid(pid, nullptr, 0);
+        throw;
+    }
+    ::close(out[0]);
+    ::close(err[0]);
+
+    int status;
+    while (::waitpid(pid, &status, 0) < 0)
+        if (errno != EINTR)
+            throw libclang_error("unable to wait for child process");
+
+    if (WIFEXITED(status))
+        return WEXITSTATUS(status);
+    else if (WIFSIGNALED(status))
+        // same as the shell
+        return 128 + WTERMSIG(status);
+    return -1;
+}
+#endif
@@ -0,0 +1,29 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#ifndef CPPAST_CHILD_PROCESS_HPP_INCLUDED
+#define CPPAST_CHILD_PROCESS_HPP_INCLUDED
+
+#include <functional>
+#include <string>
+
+namespace cppast
+{
+    namespace detail
+    {
+        // receives the output of the process in chunks
+        using process_output = std::function<void(const char*, std::size_t)>;
+
+        // runs the command in a shell and waits for it to finish
+        // stdout and stderr are passed to the callbacks, stdin is empty
+        // returns the exit code
+        //
+        // on POSIX systems this uses posix_spawn(), which doesn't copy the page tables like fork(),
+        // so the cost doesn't grow with the memory used by the current process
+        int run_process(const std::string& cmd, const process_output& on_stdout,
+                        const process_output& on_stderr);
+    } // namespace detail
+} // namespace cppast
+
+#endif // CPPAST_CHILD_PROCESS_HPP_INCLUDED
@@ -12,11 +12,17 @@ using namespace cppast;
 
 namespace
 {
-    cpp_class_kind parse_class_kind(detail::cxtoken_stream& stream)
+    CXCursorKind get_class_cursor_kind(const CXCursor& cur)
     {
-        auto kind = clang_getTemplateCursorKind(stream.cursor());
+        auto kind = clang_getTemplateCursorKind(cur);
         if (kind == CXCursor_NoDeclFound)
-            kind = clang_getCursorKind(stream.cursor());
+            kind = clang_getCursorKind(cur);
+        return kind;
+    }
+
+    cpp_class_kind parse_class_kind(detail::cxtoken_stream& stream)
+    {
+        auto kind = get_class_cursor_kind(stream.cursor());
 
         if (detail::skip_if(stream, "template"))
             // skip template parameters
@@ -108,6 +114,67 @@ namespace
         auto& base = builder.base_class(std::move(name), std::move(type), access, is_virtual);
         base.add_attribute(attributes);
     }
+
+    bool is_class_member(CXCursorKind kind)
+    {
+        // other children due to templates and stuff
+        // (UnexposedAttr: I have no idea what this is, but happens on Windows)
+        return kind != CXCursor_TemplateTypeParameter && kind != CXCursor_NonTypeTemplateParameter
+               && kind != CXCursor_TemplateTemplateParameter && kind != CXCursor_ParmDecl
+               && !clang_isExpression(kind) && !clang_isReference(kind)
+               && kind != CXCursor_UnexposedAttr;
+    }
+
+    type_safe::optional<cpp_entity_ref> parse_semantic_parent(const detail::parse_context& context,
+                                                              const CXCursor&              cur)
+    {
+        if (clang_equalCursors(clang_getCursorSemanticParent(cur),
+                               clang_getCursorLexicalParent(cur)))
+            return type_safe::nullopt;
+
+        // out-of-line definition
+        detail::cxtokenizer    tokenizer(context.tu, context.file, cur);
+        detail::cxtoken_stream stream(tokenizer, cur);
+
+        std::string name = detail::get_cursor_name(cur).c_str();
+        auto        pos  = name.find('<');
+        if (pos != std::string::npos)
+            name.erase(pos, std::string::npos);
+
+        std::string scope;
+        while (!detail::skip_if(stream, name.c_str()))
+        {
+            if (!detail::append_scope(stream, scope))
+                stream.bump();
+        }
+        if (scope.empty())
+            return type_safe::nullopt;
+        return cpp_entity_ref(detail::get_entity_id(context, clang_getCursorSemanticParent(cur)),
+                              std::move(scope));
+    }
+
+    // sets whether the filter is used for the members while they are parsed
+    class member_filter
+    {
+    public:
+        member_filter(const detail::parse_context& context, bool use_filter) noexcept
+        : context_(context), old_(context.use_filter)
+        {
+            context.use_filter = use_filter;
+        }
+
+        ~member_filter() noexcept
+        {
+            context_.use_filter = old_;
+        }
+
+        member_filter(const member_filter&) = delete;
+        member_filter& operator=(const member_filter&) = delete;
+
+    private:
+        const detail::parse_context& context_;
+        bool                         old_;
+    };
 }
 
 std::unique_ptr<cpp_entity> detail::parse_cpp_class(const detail::parse_context& context,
@@ -126,31 +193,11 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_class(const detail::parse_context&
     type_safe::optional<cpp_entity_ref> semantic_parent;
     if (!is_friend)
     {
-        if (!clang_equalCursors(clang_getCursorSemanticParent(cur),
-                                clang_getCursorLexicalParent(cur)))
-        {
-            // out-of-line definition
-            detail::cxtokenizer    tokenizer(context.tu, context.file, cur);
-            detail::cxtoken_stream stream(tokenizer, cur);
-
-            std::string name = detail::get_cursor_name(cur).c_str();
-            auto        pos  = name.find('<');
-            if (pos != std::string::npos)
-                name.erase(pos, std::string::npos);
-
-            std::string scope;
-            while (!detail::skip_if(stream, name.c_str()))
-            {
-                if (!detail::append_scope(stream, scope))
-                    stream.bump();
-            }
-            if (!scope.empty())
-                semantic_parent =
-                    cpp_entity_ref(detail::get_entity_id(clang_getCursorSemanticParent(cur)),
-                                   std::move(scope));
-        }
+        semantic_parent = parse_semantic_parent(context, cur);
 
         context.comments.match(builder.get(), cur);
+        // the members of an accepted class are only filtered if requested
+        member_filter filter(context, context.filter_members);
         detail::visit_children(cur, [&](const CXCursor& child) {
             auto kind = clang_getCursorKind(child);
             if (kind == CXCursor_CXXAccessSpecifier)
@@ -159,13 +206,7 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_class(const detail::parse_context&
                 add_base_class(builder, context, child, cur);
             else if (kind == CXCursor_CXXFinalAttr)
                 builder.is_final();
-            else if (
-                kind == CXCursor_TemplateTypeParameter || kind == CXCursor_NonTypeTemplateParameter
-                || kind == CXCursor_TemplateTemplateParameter || kind == CXCursor_ParmDecl
-                || clang_isExpression(kind) || clang_isReference(kind)
-                || kind
-                       == CXCursor_UnexposedAttr) // I have no idea what this is, but happens on Windows
-                // other children due to templates and stuff
+            else if (!is_class_member(kind))
                 return;
             else if (auto entity = parse_entity(context, &builder.get(), child))
                 builder.add_child(std::move(entity));
@@ -180,3 +221,38 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_class(const detail::parse_context&
         return is_templated ? builder.finish_declaration(detail::get_entity_id(cur)) :
                               builder.finish_declaration(*context.idx, get_entity_id(cur));
 }
+
+std::unique_ptr<cpp_entity> detail::parse_cpp_class_scope(const detail::parse_context& context,
+                                                          const CXCursor&              cur)
+{
+    auto kind = get_class_cursor_kind(cur);
+    if ((kind != CXCursor_ClassDecl && kind != CXCursor_StructDecl && kind != CXCursor_UnionDecl)
+        || !clang_isCursorDefinition(cur))
+        return nullptr;
+
+    // the name and kind are known without tokenizing the class, bases and attributes are skipped
+    auto builder = cpp_class::builder(detail::get_cursor_name(cur).c_str(),
+                                      kind == CXCursor_ClassDecl ?
+                                          cpp_class_kind::class_t :
+                                          kind == CXCursor_StructDecl ? cpp_class_kind::struct_t :
+                                                                        cpp_class_kind::union_t);
+    auto has_members = false;
+    detail::visit_children(cur, [&](const CXCursor& child) {
+        auto kind = clang_getCursorKind(child);
+        if (kind == CXCursor_CXXAccessSpecifier)
+            add_access_specifier(builder, child);
+        else if (!is_class_member(kind) || kind == CXCursor_CXXBaseSpecifier
+                 || kind == CXCursor_CXXFinalAttr)
+            return;
+        else if (auto entity = parse_entity(context, &builder.get(), child))
+        {
+            builder.add_child(std::move(entity));
+            has_members = true;
+        }
+    });
+    if (!has_members)
+        return nullptr;
+
+    // not registered, it is not the complete class
+    return builder.finish(parse_semantic_parent(context, cur));
+}
@@ -5,6 +5,7 @@
 #include "cxtokenizer.hpp"
 
 #include <cctype>
+#include <cstring>
 
 #include "libclang_visitor.hpp"
 #include "parse_error.hpp"
@@ -14,6 +15,8 @@ using namespace cppast;
 detail::cxtoken::cxtoken(const CXTranslationUnit& tu_unit, const CXToken& token)
 : value_(clang_getTokenSpelling(tu_unit, token)), kind_(clang_getTokenKind(token))
 {
+    clang_getSpellingLocation(clang_getTokenLocation(tu_unit, token), nullptr, nullptr, nullptr,
+                              &offset_);
 }
 
 namespace
@@ -85,6 +88,44 @@ namespace
         return spelling == token_str;
     }
 
+    bool cursor_is_container(CXCursorKind kind)
+    {
+        return kind == CXCursor_ClassDecl || kind == CXCursor_StructDecl
+               || kind == CXCursor_UnionDecl || kind == CXCursor_ClassTemplate
+               || kind == CXCursor_ClassTemplatePartialSpecialization
+               || kind == CXCursor_Namespace;
+    }
+
+    bool cursor_is_member(CXCursorKind kind)
+    {
+        return clang_isDeclaration(kind) && kind != CXCursor_TemplateTypeParameter
+               && kind != CXCursor_NonTypeTemplateParameter
+               && kind != CXCursor_TemplateTemplateParameter;
+    }
+
+    // returns the start of the first member of the container,
+    // or the null location if there is none in the main file
+    CXSourceLocation get_first_member_start(const CXCursor& cur, const CXSourceLocation& begin)
+    {
+        unsigned begin_offset;
+        clang_getSpellingLocation(begin, nullptr, nullptr, nullptr, &begin_offset);
+
+        auto result = clang_getNullLocation();
+        detail::visit_children(cur, [&](const CXCursor& child) {
+            if (!clang_equalLocations(result, clang_getNullLocation())
+                || !cursor_is_member(clang_getCursorKind(child)))
+                return;
+
+            auto start = clang_getRangeStart(clang_getCursorExtent(child));
+
+            unsigned offset;
+            clang_getSpellingLocation(start, nullptr, nullptr, nullptr, &offset);
+            if (clang_Location_isFromMainFile(start) && offset > begin_offset)
+                result = start;
+        });
+        return result;
+    }
+
     // clang_getCursorExtent() is somehow broken in various ways
     // this function returns the actual CXSourceRange that covers all parts required for parsing
     // might include more tokens
@@ -294,6 +335,16 @@ namespace
             if (token_after_is(tu, file, end, ";", 0))
                 end = get_next_location(tu, file, end);
         }
+        else if (cursor_is_container(kind)
+                 && (kind == CXCursor_Namespace || clang_isCursorDefinition(cur)))
+        {
+            // the members are parsed using their own cursors,
+            // so only the head is required
+            // this way, the bodies of inline member functions are never tokenized
+            auto member_start = get_first_member_start(cur, begin);
+            if (!clang_equalLocations(member_start, clang_getNullLocation()))
+                end = member_start;
+        }
 
         return clang_getRange(begin, end);
     }
@@ -310,6 +361,28 @@ detail::cxtokenizer::cxtokenizer(const CXTranslationUnit& tu, const CXFile& file
         tokens_.emplace_back(tu, tokenizer[i]);
 }
 
+bool detail::has_attributes_before_name(const CXTranslationUnit& tu, const CXFile& file,
+                                        const CXCursor& cur)
+{
+    auto begin = clang_getRangeStart(clang_getCursorExtent(cur));
+    // attributes in front of functions and variables aren't part of the extent,
+    // see get_extent()
+    if (token_after_is(tu, file, begin, "]", -2) && token_after_is(tu, file, begin, "]", -3))
+        return true;
+
+    simple_tokenizer tokenizer(tu, clang_getRange(begin, clang_getCursorLocation(cur)));
+    for (auto i = 0u; i != tokenizer.size(); ++i)
+    {
+        detail::cxstring spelling(clang_getTokenSpelling(tu, tokenizer[i]));
+        if (spelling == "alignas" || spelling == "__attribute__" || spelling == "__declspec")
+            return true;
+        else if (spelling == "[" && i + 1u != tokenizer.size()
+                 && detail::cxstring(clang_getTokenSpelling(tu, tokenizer[i + 1u])) == "[")
+            return true;
+    }
+    return false;
+}
+
 void detail::skip(detail::cxtoken_stream& stream, const char* str)
 {
     if (*str)
@@ -615,12 +688,12 @@ namespace
 
         case CXToken_Literal:
         {
-            auto spelling = token.value().std_str();
-            if (spelling.find('.') != std::string::npos)
+            auto& spelling = token.value();
+            if (std::strchr(spelling.c_str(), '.') != nullptr)
                 return cpp_token_kind::float_literal;
-            else if (std::isdigit(spelling.front()))
+            else if (std::isdigit(spelling[0u]))
                 return cpp_token_kind::int_literal;
-            else if (spelling.back() == '\'')
+            else if (spelling[spelling.length() - 1u] == '\'')
                 return cpp_token_kind::char_literal;
             else
                 return cpp_token_kind::string_literal;
@@ -642,7 +715,7 @@ cpp_token_string detail::to_string(cxtoken_stream& stream, cxtoken_iterator end)
     while (stream.cur() != end)
     {
         auto& token = stream.get();
-        builder.add_token(cpp_token(get_kind(token), token.c_str()));
+        builder.add_token(get_kind(token), token.c_str(), token.value().length());
     }
 
     if (stream.unmunch())
@@ -651,6 +724,27 @@ cpp_token_string detail::to_string(cxtoken_stream& stream, cxtoken_iterator end)
     return builder.finish();
 }
 
+detail::lazy_token_string detail::to_lazy_string(cxtoken_stream& stream, cxtoken_iterator end,
+                                                 const std::shared_ptr<const std::string>& source)
+{
+    if (!source || stream.cur() == end)
+        return to_string(stream, end);
+
+    auto begin  = stream.cur()->offset();
+    auto last   = std::prev(end);
+    auto length = last->offset() + last->value().length() - begin;
+    if (stream.unmunch())
+    {
+        DEBUG_ASSERT(*last == ">>", detail::assert_handler{});
+        // the slice ends in the middle of the token
+        --length;
+    }
+    DEBUG_ASSERT(begin + length <= source->size(), detail::assert_handler{});
+
+    stream.set_cur(end);
+    return lazy_token_string(source, std::uint32_t(begin), std::uint32_t(length));
+}
+
 bool detail::append_scope(detail::cxtoken_stream& stream, std::string& scope)
 {
     // add identifiers and "::" to current scope name,
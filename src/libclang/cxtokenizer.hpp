@@ -5,6 +5,7 @@
 #ifndef CPPAST_CXTOKENIZER_HPP_INCLUDED
 #define CPPAST_CXTOKENIZER_HPP_INCLUDED
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -37,9 +38,16 @@ namespace cppast
                 return kind_;
             }
 
+            // offset of the token in the file
+            unsigned offset() const noexcept
+            {
+                return offset_;
+            }
+
         private:
             cxstring    value_;
             CXTokenKind kind_;
+            unsigned    offset_;
         };
 
         inline bool operator==(const cxtoken& tok, const char* str) noexcept
@@ -93,6 +101,11 @@ namespace cppast
             bool                 unmunch_;
         };
 
+        // whether there are attributes in front of the name of the cursor,
+        // only looks at the tokens up to the name
+        bool has_attributes_before_name(const CXTranslationUnit& tu, const CXFile& file,
+                                        const CXCursor& cur);
+
         class cxtoken_stream
         {
         public:
@@ -197,6 +210,11 @@ namespace cppast
         // converts a token range to a string
         cpp_token_string to_string(cxtoken_stream& stream, cxtoken_iterator end);
 
+        // converts a token range to a string,
+        // it is only tokenized when it is accessed if the source of the file is given
+        lazy_token_string to_lazy_string(cxtoken_stream& stream, cxtoken_iterator end,
+                                         const std::shared_ptr<const std::string>& source);
+
         // appends token to scope, if it is still valid
         // else clears it
         // note: does not consume the token if it is not valid,
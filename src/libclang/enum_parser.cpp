@@ -4,6 +4,8 @@
 
 #include <cppast/cpp_enum.hpp>
 
+#include <limits>
+
 #include "parse_functions.hpp"
 #include "libclang_visitor.hpp"
 
@@ -11,8 +13,50 @@ using namespace cppast;
 
 namespace
 {
-    std::unique_ptr<cpp_enum_value> parse_enum_value(const detail::parse_context& context,
-                                                     const CXCursor&              cur)
+    bool is_unsigned(const CXType& type)
+    {
+        switch (clang_getCanonicalType(type).kind)
+        {
+        case CXType_Bool:
+        case CXType_Char_U:
+        case CXType_UChar:
+        case CXType_Char16:
+        case CXType_Char32:
+        case CXType_UShort:
+        case CXType_UInt:
+        case CXType_ULong:
+        case CXType_ULongLong:
+        case CXType_UInt128:
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    type_safe::optional<cpp_integral_value> get_next_value(
+        const type_safe::optional<cpp_integral_value>& last)
+    {
+        // the next value isn't representable at the maximum, the enum would be ill-formed
+        if (!last)
+            return type_safe::nullopt;
+        else if (last.value().is_signed())
+            return last.value().signed_value() == std::numeric_limits<std::int64_t>::max() ?
+                       type_safe::nullopt :
+                       type_safe::make_optional(
+                           cpp_integral_value::make_signed(last.value().signed_value() + 1));
+        else
+            return last.value().unsigned_value() == std::numeric_limits<std::uint64_t>::max() ?
+                       type_safe::nullopt :
+                       type_safe::make_optional(
+                           cpp_integral_value::make_unsigned(last.value().unsigned_value() + 1u));
+    }
+
+    // last is the value of the previous enumerator,
+    // it is only used inside templates where libclang doesn't compute the values
+    std::unique_ptr<cpp_enum_value> parse_enum_value(
+        const detail::parse_context& context, const CXCursor& cur, bool in_template,
+        bool is_unsigned, type_safe::optional<cpp_integral_value>& last)
     {
         if (clang_isAttribute(clang_getCursorKind(cur)))
             return nullptr;
@@ -40,8 +84,25 @@ namespace
             });
         }
 
+        type_safe::optional<cpp_integral_value> evaluated;
+        if (in_template)
+        {
+            // the values of enumerators in templates aren't computed, even if they could be,
+            // so use the value of the expression or count from the previous one
+            if (value)
+                evaluated = value->evaluated_value();
+            else
+                evaluated = get_next_value(last);
+            last = evaluated;
+        }
+        else if (is_unsigned)
+            evaluated =
+                cpp_integral_value::make_unsigned(clang_getEnumConstantDeclUnsignedValue(cur));
+        else
+            evaluated = cpp_integral_value::make_signed(clang_getEnumConstantDeclValue(cur));
+
         auto result = cpp_enum_value::build(*context.idx, detail::get_entity_id(cur), name.c_str(),
-                                            std::move(value));
+                                            std::move(value), std::move(evaluated));
         result->add_attribute(attributes);
         return result;
     }
@@ -65,7 +126,7 @@ namespace
                                   "unexpected tokens in enum name");
         if (!scope.empty())
             semantic_parent =
-                cpp_entity_ref(detail::get_entity_id(clang_getCursorSemanticParent(cur)),
+                cpp_entity_ref(detail::get_entity_id(context, clang_getCursorSemanticParent(cur)),
                                std::move(scope));
 
         // parse type
@@ -86,10 +147,15 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_enum(const detail::parse_context&
     type_safe::optional<cpp_entity_ref> semantic_parent;
     auto                                builder = make_enum_builder(context, cur, semantic_parent);
     context.comments.match(builder.get(), cur);
+
+    auto in_template = detail::is_in_template(cur);
+    auto is_unsigned = ::is_unsigned(clang_getEnumDeclIntegerType(cur));
+    // the first enumerator without a value is zero
+    type_safe::optional<cpp_integral_value> last = cpp_integral_value::make_signed(-1);
     detail::visit_children(cur, [&](const CXCursor& child) {
         try
         {
-            auto entity = parse_enum_value(context, child);
+            auto entity = parse_enum_value(context, child, in_template, is_unsigned, last);
             if (entity)
             {
                 context.comments.match(*entity, child);
@@ -4,10 +4,80 @@
 
 #include <cppast/cpp_expression.hpp>
 
+#include "libclang_visitor.hpp"
 #include "parse_functions.hpp"
 
 using namespace cppast;
 
+namespace
+{
+    // whether the expression only consists of literals and operators,
+    // so it can't depend on a template parameter
+    bool is_self_contained(const CXCursor& expr)
+    {
+        auto kind = clang_getCursorKind(expr);
+        if (kind == CXCursor_IntegerLiteral || kind == CXCursor_CharacterLiteral
+            || kind == CXCursor_CXXBoolLiteralExpr)
+            return true;
+        else if (kind != CXCursor_UnaryOperator && kind != CXCursor_BinaryOperator
+                 && kind != CXCursor_ConditionalOperator && kind != CXCursor_ParenExpr
+                 && kind != CXCursor_UnexposedExpr)
+            return false;
+
+        auto has_children = false, result = true;
+        detail::visit_children(expr, [&](const CXCursor& child) {
+            has_children = true;
+            if (!is_self_contained(child))
+                result = false;
+        });
+        // an unexposed expression without children could be anything
+        return result && (has_children || kind != CXCursor_UnexposedExpr);
+    }
+} // namespace
+
+bool detail::is_in_template(CXCursor cur)
+{
+    for (; !clang_isInvalid(clang_getCursorKind(cur))
+           && clang_getCursorKind(cur) != CXCursor_TranslationUnit;
+         cur = clang_getCursorSemanticParent(cur))
+    {
+        // the semantic parent of a template parameter is the scope of the template,
+        // so check for the parameter itself
+        auto kind = clang_getCursorKind(cur);
+        if (kind == CXCursor_ClassTemplate || kind == CXCursor_ClassTemplatePartialSpecialization
+            || kind == CXCursor_FunctionTemplate || kind == CXCursor_TypeAliasTemplateDecl
+            || kind == CXCursor_NonTypeTemplateParameter)
+            return true;
+    }
+    return false;
+}
+
+type_safe::optional<cpp_integral_value> detail::evaluate_integral(const CXCursor& expr)
+{
+    DEBUG_ASSERT(clang_isExpression(clang_getCursorKind(expr)), detail::assert_handler{});
+    if (is_in_template(clang_getCursorSemanticParent(expr)) && !is_self_contained(expr))
+        return type_safe::nullopt;
+
+    auto eval = clang_Cursor_Evaluate(expr);
+    if (!eval)
+        return type_safe::nullopt;
+
+    type_safe::optional<cpp_integral_value> result;
+    if (clang_EvalResult_getKind(eval) == CXEval_Int)
+    {
+#if CINDEX_VERSION_MINOR >= 43
+        if (clang_EvalResult_isUnsignedInt(eval))
+            result = cpp_integral_value::make_unsigned(clang_EvalResult_getAsUnsigned(eval));
+        else
+            result = cpp_integral_value::make_signed(clang_EvalResult_getAsLongLong(eval));
+#else
+        result = cpp_integral_value::make_signed(clang_EvalResult_getAsInt(eval));
+#endif
+    }
+    clang_EvalResult_dispose(eval);
+    return result;
+}
+
 std::unique_ptr<cpp_expression> detail::parse_expression(const detail::parse_context& context,
                                                          const CXCursor&              cur)
 {
@@ -17,9 +87,9 @@ std::unique_ptr<cpp_expression> detail::parse_expression(const detail::parse_con
     detail::cxtokenizer    tokenizer(context.tu, context.file, cur);
     detail::cxtoken_stream stream(tokenizer, cur);
 
-    auto type = parse_type(context, cur, clang_getCursorType(cur));
-    auto expr = to_string(stream, stream.end());
-    if (kind == CXCursor_CallExpr && (expr.empty() || expr.back().spelling != ")"))
+    auto type      = parse_type(context, cur, clang_getCursorType(cur));
+    auto evaluated = evaluate_integral(cur);
+    if (kind == CXCursor_CallExpr && (stream.done() || *std::prev(stream.end()) != ")"))
     {
         // we have a call expression that doesn't end in a closing parentheses
         // this means default constructor, don't parse it at all
@@ -30,19 +100,24 @@ std::unique_ptr<cpp_expression> detail::parse_expression(const detail::parse_con
              || kind == CXCursor_FloatingLiteral || kind == CXCursor_ImaginaryLiteral
              || kind == CXCursor_IntegerLiteral || kind == CXCursor_StringLiteral
              || kind == CXCursor_CXXBoolLiteralExpr || kind == CXCursor_CXXNullPtrLiteralExpr)
-        return cpp_literal_expression::build(std::move(type), expr.as_string());
+        return cpp_literal_expression::build(std::move(type),
+                                             to_string(stream, stream.end()).as_string(),
+                                             std::move(evaluated));
     else
-        return cpp_unexposed_expression::build(std::move(type), std::move(expr));
+        return cpp_unexposed_expression::build(std::move(type),
+                                               to_lazy_string(stream, stream.end(),
+                                                              context.source),
+                                               std::move(evaluated));
 }
 
-std::unique_ptr<cpp_expression> detail::parse_raw_expression(const parse_context&,
-                                                             cxtoken_stream&           stream,
-                                                             cxtoken_iterator          end,
-                                                             std::unique_ptr<cpp_type> type)
+std::unique_ptr<cpp_expression> detail::parse_raw_expression(
+    const parse_context& context, cxtoken_stream& stream, cxtoken_iterator end,
+    std::unique_ptr<cpp_type> type, type_safe::optional<cpp_integral_value> evaluated)
 {
     if (stream.done())
         return nullptr;
 
-    auto expr = to_string(stream, std::prev(end)->value() == ";" ? std::prev(end) : end);
-    return cpp_unexposed_expression::build(std::move(type), std::move(expr));
+    auto expr = to_lazy_string(stream, std::prev(end)->value() == ";" ? std::prev(end) : end,
+                               context.source);
+    return cpp_unexposed_expression::build(std::move(type), std::move(expr), std::move(evaluated));
 }
@@ -0,0 +1,303 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include "file_cache.hpp"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <fstream>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cppast/cpp_entity_index.hpp>
+
+using namespace cppast;
+
+namespace
+{
+    // identifies a version of a file
+    struct file_stamp
+    {
+        std::uint64_t size;
+        std::int64_t  mtime_sec, mtime_nsec;
+
+        bool operator==(const file_stamp& other) const noexcept
+        {
+            return size == other.size && mtime_sec == other.mtime_sec
+                   && mtime_nsec == other.mtime_nsec;
+        }
+    };
+
+#ifdef _WIN32
+    bool get_stamp(const std::string& path, file_stamp& stamp)
+    {
+        struct _stat64 st;
+        if (::_stat64(path.c_str(), &st) != 0)
+            return false;
+        stamp = file_stamp{std::uint64_t(st.st_size), std::int64_t(st.st_mtime), 0};
+        return true;
+    }
+#else
+    file_stamp make_stamp(const struct stat& st)
+    {
+#if defined(__APPLE__)
+        auto nsec = st.st_mtimespec.tv_nsec;
+#else
+        auto nsec = st.st_mtim.tv_nsec;
+#endif
+        return file_stamp{std::uint64_t(st.st_size), std::int64_t(st.st_mtime),
+                          std::int64_t(nsec)};
+    }
+
+    bool get_stamp(const std::string& path, file_stamp& stamp)
+    {
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0)
+            return false;
+        stamp = make_stamp(st);
+        return true;
+    }
+#endif
+
+    struct cache_entry
+    {
+        file_stamp                                   stamp;
+        std::shared_ptr<const detail::file_contents> contents;
+    };
+
+    struct file_cache
+    {
+        std::mutex                                   mutex;
+        std::unordered_map<std::string, cache_entry> entries;
+        std::size_t                                  size = 0u; // of all contents in bytes
+
+        // the maximal size before contents are evicted
+        static constexpr std::size_t max_size = std::size_t(256u) * 1024u * 1024u;
+
+        void insert(const std::string& path, cache_entry entry)
+        {
+            auto& slot = entries[path];
+            if (slot.contents)
+                size -= slot.contents->size();
+            size += entry.contents->size();
+            slot = std::move(entry);
+
+            if (size > max_size)
+                evict();
+        }
+
+        // removes contents only the cache refers to, until it is well below the maximal size,
+        // so that the scan doesn't happen on every insertion
+        void evict()
+        {
+            for (auto iter = entries.begin(); iter != entries.end() && size > max_size / 4u * 3u;)
+            {
+                if (iter->second.contents.use_count() == 1)
+                {
+                    size -= iter->second.contents->size();
+                    iter = entries.erase(iter);
+                }
+                else
+                    ++iter;
+            }
+        }
+    };
+
+    file_cache& get_file_cache()
+    {
+        // leaked, so it is still usable during static destruction
+        static auto cache = new file_cache;
+        return *cache;
+    }
+
+    template <std::size_t N>
+    void bump_until(const char*& iter, const char* end, const char (&str)[N])
+    {
+        auto ptr = &str[0];
+        while (ptr != &str[N - 1] && iter != end)
+        {
+            if (*iter != *ptr)
+            {
+                // try again
+                ptr = &str[0];
+                if (*iter == *ptr)
+                    ++ptr; // it was the first character again
+            }
+            else
+                // okay, move forward
+                ++ptr;
+
+            ++iter;
+        }
+    }
+
+    template <typename Iter>
+    void skip_whitespace(Iter& begin, Iter end)
+    {
+        while (begin != end && (*begin == ' ' || *begin == '\t'))
+            ++begin;
+    }
+
+    std::string get_line(const char*& begin, const char* end)
+    {
+        std::string line;
+        for (; begin != end && *begin != '\n'; ++begin)
+            if (*begin != '\r')
+                line += *begin;
+        if (begin != end)
+            ++begin; // newline
+        return line;
+    }
+} // namespace
+
+type_safe::optional<std::string> detail::get_include_guard_macro(const char* begin,
+                                                                 const char* end)
+{
+    auto iter = begin;
+    while (iter != end)
+    {
+        if (*iter == '/')
+        {
+            ++iter;
+            if (iter == end)
+                break;
+            else if (*iter == '/')
+                // C++ style comment, bump until \n
+                bump_until(iter, end, "\n");
+            else if (*iter == '*')
+                // C style comment
+                bump_until(iter, end, "*/");
+        }
+        else if (*iter == ' ' || *iter == '\t' || *iter == '\n' || *iter == '\r')
+            ++iter; // empty
+        else if (*iter == '#')
+        {
+            // preprocessor line
+            auto if_line = get_line(iter, end);
+            if (if_line.compare(0, 3, "#if") != 0)
+                // not something starting with #if
+                break;
+
+            skip_whitespace(iter, end);
+
+            auto macro_line = get_line(iter, end);
+            if (macro_line.compare(0, 7, "#define") != 0)
+                // not a corresponding define
+                break;
+
+            auto macro_name_begin = std::next(macro_line.begin(), 7);
+            // skip whitespace after define
+            skip_whitespace(macro_name_begin, macro_line.end());
+
+            auto macro_name_end = macro_name_begin;
+            // skip over identifier
+            while (macro_name_end != macro_line.end()
+                   && (*macro_name_end == '_' || std::isalnum(*macro_name_end)))
+                ++macro_name_end;
+
+            auto trailing_ws = macro_line.rbegin();
+            skip_whitespace(trailing_ws, macro_line.rend());
+            if (macro_name_end != trailing_ws.base())
+                // anything else after macro
+                break;
+
+            std::string macro_name(macro_name_begin, macro_name_end);
+            if (if_line.find(macro_name) == std::string::npos)
+                // macro name doesn't occur in if line
+                break;
+            else
+                return macro_name;
+        }
+        else
+            // line is neither empty, comment, nor preprocessor
+            break;
+    }
+
+    // assume no include guard followed a bad line
+    return type_safe::nullopt;
+}
+
+void detail::file_contents::init_facts()
+{
+    hash_          = detail::id_hash(data(), size());
+    include_guard_ = get_include_guard_macro(data(), data() + size());
+}
+
+std::shared_ptr<const detail::file_contents> detail::read_file(const std::string& path)
+{
+    auto& cache = get_file_cache();
+
+    file_stamp stamp;
+    if (!get_stamp(path, stamp))
+        return nullptr;
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+
+        auto iter = cache.entries.find(path);
+        if (iter != cache.entries.end() && iter->second.stamp == stamp)
+            return iter->second.contents;
+    }
+
+    // read without holding the lock, other files can be looked up in the meantime
+    std::shared_ptr<file_contents> contents(new file_contents());
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return nullptr;
+    contents->buffer_.assign(std::istreambuf_iterator<char>(file),
+                             std::istreambuf_iterator<char>());
+#else
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    // use the stamp of the file that is actually read, it might have changed in the meantime
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+    stamp = make_stamp(st);
+
+    // read until the end, the size is only a hint, e.g. for pipes or files that are written to
+    contents->buffer_.resize(std::size_t(st.st_size) + 1u);
+    auto size = std::size_t(0u);
+    while (true)
+    {
+        if (size == contents->buffer_.size())
+            contents->buffer_.resize(2u * size);
+
+        auto n = ::read(fd, &contents->buffer_[size], contents->buffer_.size() - size);
+        if (n > 0)
+            size += std::size_t(n);
+        else if (n == 0)
+            break;
+        else if (errno != EINTR)
+        {
+            ::close(fd);
+            return nullptr;
+        }
+    }
+    contents->buffer_.resize(size);
+    ::close(fd);
+#endif
+    contents->init_facts();
+
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    cache.insert(path, cache_entry{stamp, contents});
+    return contents;
+}
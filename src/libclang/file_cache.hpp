@@ -0,0 +1,74 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#ifndef CPPAST_FILE_CACHE_HPP_INCLUDED
+#define CPPAST_FILE_CACHE_HPP_INCLUDED
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <type_safe/optional.hpp>
+
+namespace cppast
+{
+    namespace detail
+    {
+        // the contents of a file together with the facts derived from them,
+        // so that each file is only read and scanned once
+        class file_contents
+        {
+        public:
+            file_contents(const file_contents&) = delete;
+            file_contents& operator=(const file_contents&) = delete;
+
+            const char* data() const noexcept
+            {
+                return buffer_.data();
+            }
+
+            std::size_t size() const noexcept
+            {
+                return buffer_.size();
+            }
+
+            // detail::id_hash() of the contents
+            std::size_t hash() const noexcept
+            {
+                return hash_;
+            }
+
+            const type_safe::optional<std::string>& include_guard() const noexcept
+            {
+                return include_guard_;
+            }
+
+        private:
+            file_contents() noexcept : hash_(0u) {}
+
+            void init_facts();
+
+            // owned, so the contents don't change if the file is modified
+            std::string                      buffer_;
+            std::size_t                      hash_;
+            type_safe::optional<std::string> include_guard_;
+
+            friend std::shared_ptr<const file_contents> read_file(const std::string& path);
+        };
+
+        // returns the contents of the file or nullptr if it can't be read
+        // the contents are cached process wide and read again if the size or modification time
+        // of the file changed, the returned object stays valid and unchanged in any case
+        // contents no one else is using are evicted once the cache gets too big
+        // this function is thread safe
+        std::shared_ptr<const file_contents> read_file(const std::string& path);
+
+        // returns the include guard macro of a file with the given contents,
+        // if it starts with one
+        type_safe::optional<std::string> get_include_guard_macro(const char* begin,
+                                                                 const char* end);
+    } // namespace detail
+} // namespace cppast
+
+#endif // CPPAST_FILE_CACHE_HPP_INCLUDED
@@ -18,7 +18,7 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_friend(const detail::parse_context
 {
     DEBUG_ASSERT(clang_getCursorKind(cur) == CXCursor_FriendDecl, detail::assert_handler{});
 
-    std::string                                                   comment;
+    auto                                                          steal_comment = false;
     std::unique_ptr<cpp_entity>                                   entity;
     std::unique_ptr<cpp_type>                                     type;
     std::string                                                   namespace_str;
@@ -37,7 +37,7 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_friend(const detail::parse_context
             else if (clang_getCursorKind(referenced) == CXCursor_TemplateTypeParameter)
                 // parse template parameter type
                 type = cpp_template_parameter_type::build(
-                    cpp_template_type_parameter_ref(detail::get_entity_id(referenced),
+                    cpp_template_type_parameter_ref(detail::get_entity_id(context, referenced),
                                                     detail::get_cursor_name(child).c_str()));
             else if (!namespace_str.empty())
             {
@@ -45,17 +45,17 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_friend(const detail::parse_context
                 // we can't use the other branch here,
                 // as then the class name would be wrong
                 auto name = detail::get_cursor_name(referenced);
-                type =
-                    cpp_user_defined_type::build(cpp_type_ref(detail::get_entity_id(referenced),
-                                                              namespace_str + "::" + name.c_str()));
+                type = cpp_user_defined_type::build(
+                    cpp_type_ref(detail::get_entity_id(context, referenced),
+                                 namespace_str + "::" + name.c_str()));
             }
             else
             {
                 // for some reason libclang gives a type ref here
                 // we actually need a class decl cursor, so parse the referenced one
                 // this might be a definition, so give friend information to the parser
-                entity  = parse_entity(context, nullptr, referenced, cur);
-                comment = type_safe::copy(entity->comment()).value_or("");
+                entity        = parse_entity(context, nullptr, referenced, cur);
+                steal_comment = false;
             }
         }
         else if (kind == CXCursor_NamespaceRef)
@@ -64,8 +64,9 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_friend(const detail::parse_context
         {
             if (!namespace_str.empty())
                 namespace_str += "::";
-            auto templ = cpp_template_ref(detail::get_entity_id(clang_getCursorReferenced(child)),
-                                          namespace_str + detail::get_cursor_name(child).c_str());
+            auto templ =
+                cpp_template_ref(detail::get_entity_id(context, clang_getCursorReferenced(child)),
+                                 namespace_str + detail::get_cursor_name(child).c_str());
             namespace_str.clear();
             if (!inst_builder)
                 inst_builder = cpp_template_instantiation_type::builder(std::move(templ));
@@ -76,11 +77,7 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_friend(const detail::parse_context
         {
             entity = parse_entity(context, nullptr, child, cur);
             if (entity)
-            {
-                // steal comment
-                comment = type_safe::copy(entity->comment()).value_or("");
-                entity->set_comment(type_safe::nullopt);
-            }
+                steal_comment = true;
         }
         else if (inst_builder && clang_isExpression(kind))
         {
@@ -89,6 +86,7 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_friend(const detail::parse_context
         }
     });
 
+    auto                        friended = entity.get();
     std::unique_ptr<cpp_entity> result;
     if (entity)
         result = cpp_friend::build(std::move(entity));
@@ -99,9 +97,13 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_friend(const detail::parse_context
     else
         DEBUG_UNREACHABLE(detail::parse_error_handler{}, cur,
                           "unknown child entity of friend declaration");
-    if (!comment.empty())
+    if (friended)
+    {
         // set comment of entity...
-        result->set_comment(std::move(comment));
+        result->set_comment(*friended);
+        if (steal_comment)
+            friended->set_comment(type_safe::nullopt);
+    }
     // ... but override if this finds a different comment
     // due to clang_getCursorReferenced(), this may happen
     context.comments.match(*result, cur);
@@ -148,17 +148,18 @@ namespace
         return parent;
     }
 
-    bool equivalent_cursor(const CXCursor& a, const CXCursor& b)
+    bool equivalent_cursor(const detail::parse_context& context, const CXCursor& a,
+                           const CXCursor& b)
     {
         if (clang_getCursorKind(a) == clang_getCursorKind(b)
             && clang_getCursorKind(a) == CXCursor_Namespace)
-            return detail::cxstring(clang_getCursorUSR(a))
-                   == detail::cxstring(clang_getCursorUSR(b));
+            return detail::get_entity_id(context, a) == detail::get_entity_id(context, b);
         else
             return clang_equalCursors(a, b) == 1;
     }
 
-    type_safe::optional<cpp_entity_ref> parse_scope(const CXCursor& cur, bool is_friend)
+    type_safe::optional<cpp_entity_ref> parse_scope(const detail::parse_context& context,
+                                                    const CXCursor& cur, bool is_friend)
     {
         std::string scope_name;
 
@@ -174,7 +175,7 @@ namespace
 
             // remove common parents
             while (!friended_parents.empty() && !cur_parents.empty()
-                   && equivalent_cursor(friended_parents.back(), cur_parents.back()))
+                   && equivalent_cursor(context, friended_parents.back(), cur_parents.back()))
             {
                 friended_parents.pop_back();
                 cur_parents.pop_back();
@@ -189,8 +190,7 @@ namespace
             for (auto iter = friended_parents.rbegin(); iter != std::prev(friended_parents.rend());
                  ++iter)
             {
-                auto parent_name = detail::cxstring(clang_getCursorDisplayName(*iter));
-                scope_name += parent_name.std_str() + "::";
+                scope_name += context.cache.display_name(*iter) + "::";
             }
         }
         else
@@ -201,21 +201,21 @@ namespace
             // and the scope outside of the class for friend functions
             for (auto definition = get_definition_scope(cur, is_friend),
                       parent     = clang_getCursorSemanticParent(cur);
-                 !equivalent_cursor(definition, parent);
+                 !equivalent_cursor(context, definition, parent);
                  parent = clang_getCursorSemanticParent(parent))
             {
                 DEBUG_ASSERT(!clang_isTranslationUnit(clang_getCursorKind(parent)),
                              detail::parse_error_handler{}, cur,
                              "infinite loop while calculating scope");
-                auto parent_name = detail::cxstring(clang_getCursorDisplayName(parent));
-                scope_name       = parent_name.std_str() + "::" + std::move(scope_name);
+                scope_name = context.cache.display_name(parent) + "::" + std::move(scope_name);
             }
         }
 
         if (scope_name.empty())
             return type_safe::nullopt;
         else
-            return cpp_entity_ref(detail::get_entity_id(clang_getCursorSemanticParent(cur)),
+            return cpp_entity_ref(detail::get_entity_id(context,
+                                                        clang_getCursorSemanticParent(cur)),
                                   std::move(scope_name));
     }
 
@@ -557,10 +557,10 @@ namespace
 
         if (is_templated_cursor(cur))
             return builder.finish(detail::get_entity_id(cur), suffix.body_kind,
-                                  parse_scope(cur, is_friend));
+                                  parse_scope(context, cur, is_friend));
         else
             return builder.finish(*context.idx, detail::get_entity_id(cur), suffix.body_kind,
-                                  parse_scope(cur, is_friend));
+                                  parse_scope(context, cur, is_friend));
     }
 }
 
@@ -702,7 +702,7 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_member_function(const detail::pars
 
     skip_parameters(stream);
     return handle_suffix(context, cur, builder, stream, prefix.is_virtual,
-                         parse_scope(cur, is_friend));
+                         parse_scope(context, cur, is_friend));
 }
 
 std::unique_ptr<cpp_entity> detail::parse_cpp_conversion_op(const detail::parse_context& context,
@@ -765,7 +765,7 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_conversion_op(const detail::parse_
         builder.is_constexpr();
 
     return handle_suffix(context, cur, builder, stream, prefix.is_virtual,
-                         parse_scope(cur, is_friend));
+                         parse_scope(context, cur, is_friend));
 }
 
 std::unique_ptr<cpp_entity> detail::parse_cpp_constructor(const detail::parse_context& context,
@@ -807,10 +807,10 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_constructor(const detail::parse_co
 
     if (is_templated_cursor(cur))
         return builder.finish(detail::get_entity_id(cur), suffix.body_kind,
-                              parse_scope(cur, is_friend));
+                              parse_scope(context, cur, is_friend));
     else
         return builder.finish(*context.idx, detail::get_entity_id(cur), suffix.body_kind,
-                              parse_scope(cur, is_friend));
+                              parse_scope(context, cur, is_friend));
 }
 
 std::unique_ptr<cpp_entity> detail::parse_cpp_destructor(const detail::parse_context& context,
@@ -832,5 +832,5 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_destructor(const detail::parse_con
     detail::skip(stream, "(");
     detail::skip(stream, ")");
     return handle_suffix(context, cur, builder, stream, prefix_info.is_virtual,
-                         parse_scope(cur, is_friend));
+                         parse_scope(context, cur, is_friend));
 }
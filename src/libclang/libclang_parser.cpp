@@ -4,12 +4,20 @@
 
 #include <cppast/libclang_parser.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <clang-c/CXCompilationDatabase.h>
 
+#include "file_cache.hpp"
 #include "libclang_visitor.hpp"
 #include "raii_wrapper.hpp"
 #include "parse_error.hpp"
@@ -54,6 +62,155 @@ bool detail::libclang_compile_config_access::remove_comments_in_macro(
     return config.remove_comments_in_macro_;
 }
 
+bool detail::libclang_compile_config_access::parse_comments(const libclang_compile_config& config)
+{
+    return config.parse_comments_;
+}
+
+bool detail::libclang_compile_config_access::lazy_unexposed(const libclang_compile_config& config)
+{
+    return config.lazy_unexposed_;
+}
+
+const std::map<std::string, std::string>& detail::libclang_compile_config_access::unsaved_files(
+    const libclang_compile_config& config)
+{
+    return config.unsaved_files_;
+}
+
+const std::string& detail::libclang_compile_config_access::preprocessed_input(
+    const libclang_compile_config& config)
+{
+    return config.preprocessed_input_;
+}
+
+const std::string& detail::libclang_compile_config_access::prelude(
+    const libclang_compile_config& config)
+{
+    return config.prelude_;
+}
+
+const std::string& detail::libclang_compile_config_access::precompiled_header(
+    const libclang_compile_config& config)
+{
+    return config.precompiled_header_;
+}
+
+namespace
+{
+    void write_uint(std::string& out, std::uint32_t value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void write_string(std::string& out, const std::string& str)
+    {
+        write_uint(out, static_cast<std::uint32_t>(str.size()));
+        out += str;
+    }
+
+    class serialized_reader
+    {
+    public:
+        explicit serialized_reader(const std::string& data)
+        : ptr_(data.data()), end_(data.data() + data.size())
+        {
+        }
+
+        std::uint32_t read_uint()
+        {
+            std::uint32_t result;
+            std::memcpy(&result, advance(sizeof(result)), sizeof(result));
+            return result;
+        }
+
+        std::string read_string()
+        {
+            auto size = read_uint();
+            return std::string(advance(size), size);
+        }
+
+        bool done() const noexcept
+        {
+            return ptr_ == end_;
+        }
+
+    private:
+        const char* advance(std::size_t size)
+        {
+            if (std::size_t(end_ - ptr_) < size)
+                throw libclang_error("invalid serialized configuration");
+            auto result = ptr_;
+            ptr_ += size;
+            return result;
+        }
+
+        const char *ptr_, *end_;
+    };
+} // namespace
+
+std::string detail::libclang_compile_config_access::serialize(const libclang_compile_config& config)
+{
+    std::string result;
+
+    write_uint(result, static_cast<std::uint32_t>(config.get_flags().size()));
+    for (auto& flag : config.get_flags())
+        write_string(result, flag);
+
+    write_uint(result, static_cast<std::uint32_t>(config.unsaved_files_.size()));
+    for (auto& file : config.unsaved_files_)
+    {
+        write_string(result, file.first);
+        write_string(result, file.second);
+    }
+
+    write_string(result, config.preprocessed_input_);
+    write_string(result, config.prelude_);
+    write_string(result, config.precompiled_header_);
+    write_string(result, config.clang_binary_);
+    write_uint(result, static_cast<std::uint32_t>(config.clang_version_));
+    write_uint(result, (config.write_preprocessed_ ? 1u : 0u)
+                           | (config.fast_preprocessing_ ? 2u : 0u)
+                           | (config.remove_comments_in_macro_ ? 4u : 0u)
+                           | (config.parse_comments_ ? 8u : 0u)
+                           | (config.lazy_unexposed_ ? 16u : 0u));
+
+    return result;
+}
+
+libclang_compile_config detail::libclang_compile_config_access::deserialize(const std::string& data)
+{
+    serialized_reader reader(data);
+
+    std::vector<std::string> flags(reader.read_uint());
+    for (auto& flag : flags)
+        flag = reader.read_string();
+    libclang_compile_config config(std::move(flags));
+
+    for (auto count = reader.read_uint(); count != 0u; --count)
+    {
+        auto path = reader.read_string();
+        config.add_unsaved_file(std::move(path), reader.read_string());
+    }
+
+    config.preprocessed_input_ = reader.read_string();
+    config.prelude_            = reader.read_string();
+    config.precompiled_header_ = reader.read_string();
+    config.clang_binary_       = reader.read_string();
+    config.clang_version_      = static_cast<int>(reader.read_uint());
+
+    auto options                     = reader.read_uint();
+    config.write_preprocessed_       = (options & 1u) != 0u;
+    config.fast_preprocessing_       = (options & 2u) != 0u;
+    config.remove_comments_in_macro_ = (options & 4u) != 0u;
+    config.parse_comments_           = (options & 8u) != 0u;
+    config.lazy_unexposed_           = (options & 16u) != 0u;
+
+    if (!reader.done())
+        throw libclang_error("invalid serialized configuration");
+    return config;
+}
+
 libclang_compilation_database::libclang_compilation_database(const std::string& build_directory)
 {
     static_assert(std::is_same<database, CXCompilationDatabase>::value, "forgot to update type");
@@ -79,6 +236,17 @@ bool libclang_compilation_database::has_config(const char* file_name) const
     return true;
 }
 
+libclang_compile_config::libclang_compile_config(std::vector<std::string> flags)
+: compile_config(std::move(flags)),
+  clang_version_(0),
+  write_preprocessed_(false),
+  fast_preprocessing_(false),
+  remove_comments_in_macro_(false),
+  parse_comments_(true),
+  lazy_unexposed_(false)
+{
+}
+
 namespace
 {
     int parse_number(const char*& str)
@@ -97,7 +265,9 @@ libclang_compile_config::libclang_compile_config()
 : compile_config({}),
   write_preprocessed_(false),
   fast_preprocessing_(false),
-  remove_comments_in_macro_(false)
+  remove_comments_in_macro_(false),
+  parse_comments_(true),
+  lazy_unexposed_(false)
 {
     // set given clang binary
     auto ptr   = CPPAST_CLANG_VERSION_STRING;
@@ -140,8 +310,8 @@ namespace
 
     std::string get_full_path(const detail::cxstring& dir, const std::string& file)
     {
-        if (is_absolute(file))
-            // absolute file
+        if (is_absolute(file) || dir.length() == 0u)
+            // absolute file or no directory
             return file;
         else if (dir[dir.length() - 1] != '/' && dir[dir.length() - 1] != '\\')
             // relative needing separator
@@ -262,6 +432,10 @@ libclang_compile_config::libclang_compile_config(const libclang_compilation_data
             else if (flag == "-f" && (args == "ms-compatibility" || args == "ms-extensions"))
                 // other options
                 add_flag(std::move(flag) + std::move(args));
+            else if (flag == "-include-pch")
+                set_precompiled_header(get_full_path(dir, args));
+            else if (flag == "-include" && prelude_.empty())
+                set_prelude(get_full_path(dir, args));
         });
     }
 }
@@ -365,24 +539,284 @@ type_safe::optional<libclang_compile_config> cppast::find_config_for(
     return type_safe::nullopt;
 }
 
+namespace
+{
+    // returns the dependency file written by the compile command, if any
+    std::string get_dependency_file(CXCompileCommand cmd)
+    {
+        std::string dependency_file, object_file;
+        auto        writes_dependencies = false;
+
+        auto no_args = clang_CompileCommand_getNumArgs(cmd);
+        auto get_arg = [&](unsigned i) {
+            return i < no_args ? detail::cxstring(clang_CompileCommand_getArg(cmd, i)).std_str() :
+                                 std::string();
+        };
+        for (auto i = 1u /* 0 is compiler executable */; i < no_args; ++i)
+        {
+            auto arg = get_arg(i);
+            if (arg == "-MD" || arg == "-MMD")
+                writes_dependencies = true;
+            else if (arg == "-MF")
+                dependency_file = get_arg(++i);
+            else if (arg.compare(0u, 3u, "-MF") == 0)
+                dependency_file = arg.substr(3u);
+            else if (arg == "-o")
+                object_file = get_arg(++i);
+            else if (arg.size() > 2u && arg.compare(0u, 2u, "-o") == 0)
+                object_file = arg.substr(2u);
+        }
+
+        if (!dependency_file.empty())
+            return dependency_file;
+        else if (writes_dependencies && !object_file.empty())
+        {
+            // replace the extension of the object file
+            auto dot = object_file.rfind('.');
+            auto sep = object_file.find_last_of("/\\");
+            if (dot != std::string::npos && (sep == std::string::npos || dot > sep))
+                object_file.erase(dot);
+            return object_file + ".d";
+        }
+        else
+            return "";
+    }
+
+    bool is_rule_separator(const char* ptr, const char* end)
+    {
+        // a colon followed by whitespace, so it isn't a drive letter
+        return *ptr == ':'
+               && (ptr + 1 == end || ptr[1] == ' ' || ptr[1] == '\t' || ptr[1] == '\n'
+                   || ptr[1] == '\r');
+    }
+
+    // returns the prerequisites of the first rule in a Make-style dependency file
+    std::vector<std::string> parse_dependencies(const char* ptr, const char* end)
+    {
+        std::vector<std::string> result;
+
+        auto        in_prerequisites = false;
+        std::string cur;
+        auto        finish = [&] {
+            if (in_prerequisites && !cur.empty())
+                result.push_back(cur);
+            cur.clear();
+        };
+        for (; ptr != end; ++ptr)
+        {
+            auto next = ptr + 1 == end ? '\0' : ptr[1];
+            if (*ptr == '\\' && (next == '\n' || next == '\r'))
+            {
+                // line continuation
+                finish();
+                ++ptr;
+                if (*ptr == '\r' && ptr + 1 != end && ptr[1] == '\n')
+                    ++ptr;
+            }
+            else if ((*ptr == '\\' && (next == ' ' || next == '#')) || (*ptr == '$' && next == '$'))
+                // escaped character
+                cur += *++ptr;
+            else if (*ptr == ' ' || *ptr == '\t')
+                finish();
+            else if (*ptr == '\n' || *ptr == '\r')
+            {
+                finish();
+                if (in_prerequisites)
+                    // end of the rule
+                    break;
+            }
+            else if (!in_prerequisites && is_rule_separator(ptr, end))
+            {
+                // everything so far were targets
+                cur.clear();
+                in_prerequisites = true;
+            }
+            else
+                cur += *ptr;
+        }
+        finish();
+
+        return result;
+    }
+} // namespace
+
+type_safe::optional<std::vector<std::string>> cppast::find_dependencies_for(
+    const libclang_compilation_database& database, const std::string& file_name)
+{
+    auto cxcommands =
+        clang_CompilationDatabase_getCompileCommands(database.database_, file_name.c_str());
+    if (cxcommands == nullptr)
+        return type_safe::nullopt;
+    cxcompile_commands commands(cxcommands);
+
+    auto size = clang_CompileCommands_getSize(commands.get());
+    for (auto i = 0u; i != size; ++i)
+    {
+        auto cmd             = clang_CompileCommands_getCommand(commands.get(), i);
+        auto dependency_file = get_dependency_file(cmd);
+        if (dependency_file.empty())
+            continue;
+
+        auto dir      = detail::cxstring(clang_CompileCommand_getDirectory(cmd));
+        auto contents = detail::read_file(get_full_path(dir, dependency_file));
+        if (!contents)
+            continue;
+
+        auto dependencies =
+            parse_dependencies(contents->data(), contents->data() + contents->size());
+        if (!dependencies.empty())
+            // the first prerequisite is the file itself
+            dependencies.erase(dependencies.begin());
+        for (auto& dependency : dependencies)
+            dependency = get_full_path(dir, dependency);
+        return dependencies;
+    }
+
+    return type_safe::nullopt;
+}
+
+namespace
+{
+    // the precompiled preludes, one for each distinct prelude and set of flags
+    class pch_cache
+    {
+    public:
+        pch_cache() = default;
+
+        pch_cache(const pch_cache&) = delete;
+        pch_cache& operator=(const pch_cache&) = delete;
+
+        ~pch_cache() noexcept
+        {
+            // no build can be running anymore, the parser is destroyed
+            for (auto& pair : files_)
+                if (!pair.second.get().empty())
+                    std::remove(pair.second.get().c_str());
+        }
+
+        // returns the precompiled header of the prelude when parsed with the arguments,
+        // building it if necessary,
+        // returns an empty string if it could not be built
+        // this function is thread safe
+        const std::string& get(const diagnostic_logger& logger, const detail::cxindex& idx,
+                               const std::string& prelude, const std::vector<const char*>& args);
+
+    private:
+        std::string build(const diagnostic_logger& logger, const detail::cxindex& idx,
+                          const std::string& prelude, std::vector<const char*> args) const;
+
+        std::mutex                                                       mutex_;
+        std::unordered_map<std::string, std::shared_future<std::string>> files_;
+    };
+} // namespace
+
 struct libclang_parser::impl
 {
-    detail::cxindex index;
+    std::mutex                   mutex;
+    std::vector<detail::cxindex> free_indices; // indices no parse is currently using
+    unsigned                     global_options = CXGlobalOpt_None;
+    std::string                  invocation_emission_path;
+    pch_cache                    pchs;
+
+    // an index taken from the pool for one parse, returned to it on destruction
+    class index_handle
+    {
+    public:
+        explicit index_handle(impl& self) : self_(self), index_(self.checkout()) {}
+
+        index_handle(const index_handle&) = delete;
+        index_handle& operator=(const index_handle&) = delete;
+
+        ~index_handle() noexcept
+        {
+            self_.give_back(std::move(index_));
+        }
+
+        const detail::cxindex& get() const noexcept
+        {
+            return index_;
+        }
+
+    private:
+        impl&           self_;
+        detail::cxindex index_;
+    };
+
+    void apply_options(const detail::cxindex& index) const
+    {
+        clang_CXIndex_setGlobalOptions(index.get(), global_options);
+#if CINDEX_VERSION_MINOR >= 46
+        // a pooled index may still have a path set from an earlier parse
+        clang_CXIndex_setInvocationEmissionPathOption(index.get(),
+                                                      invocation_emission_path.empty() ?
+                                                          nullptr :
+                                                          invocation_emission_path.c_str());
+#endif
+    }
 
-    impl() : index(clang_createIndex(0, 0)) // no diagnostic, other one is irrelevant
+    // returns an index no one else is using, with the current options applied
+    detail::cxindex checkout()
     {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        detail::cxindex result;
+        if (free_indices.empty())
+            // no diagnostic, other one is irrelevant
+            result = detail::cxindex(clang_createIndex(0, 0));
+        else
+        {
+            result = std::move(free_indices.back());
+            free_indices.pop_back();
+        }
+        apply_options(result);
+        return result;
+    }
+
+    // keeps the index for the next parse, unless there are enough of them already
+    void give_back(detail::cxindex index) noexcept
+    {
+        auto max_free = std::max(1u, std::thread::hardware_concurrency());
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (free_indices.size() < max_free)
+            free_indices.push_back(std::move(index));
+    }
+
+    // the options are applied when an index is checked out,
+    // so indices currently in use are not affected
+    template <typename Func>
+    void set_option(Func f)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        f();
     }
 };
 
 libclang_parser::libclang_parser() : libclang_parser(default_logger()) {}
 
 libclang_parser::libclang_parser(type_safe::object_ref<const diagnostic_logger> logger)
-: parser(logger), pimpl_(new impl)
+: parser(logger), pimpl_(new impl), filter_members_(false)
 {
 }
 
 libclang_parser::~libclang_parser() noexcept {}
 
+void libclang_parser::use_background_priority(bool indexing, bool editing)
+{
+    pimpl_->set_option([&] {
+        pimpl_->global_options = CXGlobalOpt_None;
+        if (indexing)
+            pimpl_->global_options |= CXGlobalOpt_ThreadBackgroundPriorityForIndexing;
+        if (editing)
+            pimpl_->global_options |= CXGlobalOpt_ThreadBackgroundPriorityForEditing;
+    });
+}
+
+void libclang_parser::set_invocation_emission_path(std::string path)
+{
+    pimpl_->set_option([&] { pimpl_->invocation_emission_path = std::move(path); });
+}
+
 namespace
 {
     std::vector<const char*> get_arguments(const libclang_compile_config& config)
@@ -436,18 +870,130 @@ namespace
         }
     }
 
-    detail::cxtranslation_unit get_cxunit(const diagnostic_logger&       logger,
-                                          const detail::cxindex&         idx,
+    const std::string& pch_cache::get(const diagnostic_logger& logger, const detail::cxindex& idx,
+                                      const std::string&              prelude,
+                                      const std::vector<const char*>& args)
+    {
+        std::string key = prelude;
+        for (auto arg : args)
+        {
+            key += '\0';
+            key += arg;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        auto iter = files_.find(key);
+        if (iter != files_.end())
+        {
+            // wait for the thread that builds it, if it isn't done yet
+            auto future = iter->second;
+            lock.unlock();
+            return future.get();
+        }
+
+        // build it without holding the lock, so other preludes can be built meanwhile
+        std::promise<std::string> promise;
+        auto                      future = promise.get_future().share();
+        files_.emplace(key, future);
+        lock.unlock();
+
+        try
+        {
+            promise.set_value(build(logger, idx, prelude, args));
+        }
+        catch (...)
+        {
+            // the next parse tries again, the waiting ones get the exception
+            lock.lock();
+            files_.erase(key);
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+        return future.get();
+    }
+
+    std::string pch_cache::build(const diagnostic_logger& logger, const detail::cxindex& idx,
+                                 const std::string& prelude, std::vector<const char*> args) const
+    {
+        auto path = detail::get_temporary_path("cppast-pch");
+
+        // the prelude is a header, the last -x wins
+        args.push_back("-x");
+        args.push_back("c++-header");
+
+        CXTranslationUnit tu;
+        auto              flags = CXTranslationUnit_Incomplete | CXTranslationUnit_ForSerialization
+                     | CXTranslationUnit_DetailedPreprocessingRecord;
+        auto error = clang_parseTranslationUnit2(idx.get(), prelude.c_str(), args.data(),
+                                                 static_cast<int>(args.size()), nullptr, 0u,
+                                                 unsigned(flags), &tu);
+        if (error == CXError_Success)
+        {
+            detail::cxtranslation_unit unit(tu);
+            print_diagnostics(logger, tu);
+            if (clang_saveTranslationUnit(tu, path.c_str(), clang_defaultSaveOptions(tu))
+                == CXSaveError_None)
+            {
+                if (logger.is_verbose())
+                    logger.log("libclang parser",
+                               format_diagnostic(severity::debug,
+                                                 source_location::make_file(prelude),
+                                                 "precompiled prelude to '", path, "'"));
+                return path;
+            }
+        }
+
+        logger.log("libclang parser",
+                   format_diagnostic(severity::warning, source_location::make_file(prelude),
+                                     "unable to precompile prelude, including it instead"));
+        std::remove(path.c_str());
+        return "";
+    }
+
+    detail::cxtranslation_unit get_cxunit(const diagnostic_logger& logger,
+                                          const detail::cxindex& idx, pch_cache& pchs,
                                           const libclang_compile_config& config, const char* path,
                                           const std::string& source)
     {
-        CXUnsavedFile file;
-        file.Filename = path;
-        file.Contents = source.c_str();
-        file.Length   = source.length();
+        // the main file is replaced by the preprocessed source
+        std::vector<CXUnsavedFile> files(1u);
+        files.front().Filename = path;
+        files.front().Contents = source.c_str();
+        files.front().Length   = source.length();
+
+        auto main_file = detail::find_unsaved_file(config, path);
+        for (auto& unsaved : detail::libclang_compile_config_access::unsaved_files(config))
+            if (&unsaved.second != main_file)
+            {
+                CXUnsavedFile file;
+                file.Filename = unsaved.first.c_str();
+                file.Contents = unsaved.second.c_str();
+                file.Length   = unsaved.second.length();
+                files.push_back(file);
+            }
 
         auto args = get_arguments(config);
 
+        auto& precompiled_header =
+            detail::libclang_compile_config_access::precompiled_header(config);
+        auto& prelude = detail::libclang_compile_config_access::prelude(config);
+        if (!precompiled_header.empty())
+        {
+            args.push_back("-include-pch");
+            args.push_back(precompiled_header.c_str());
+        }
+        else if (!prelude.empty())
+        {
+            auto& pch = pchs.get(logger, idx, prelude, args);
+            if (!pch.empty() && logger.is_verbose())
+                logger.log("libclang parser",
+                           format_diagnostic(severity::debug, source_location::make_file(path),
+                                             "using precompiled prelude '", pch, "'"));
+            args.push_back(pch.empty() ? "-include" : "-include-pch");
+            args.push_back(pch.empty() ? prelude.c_str() : pch.c_str());
+        }
+
         CXTranslationUnit tu;
         auto              flags = CXTranslationUnit_Incomplete | CXTranslationUnit_KeepGoing
                      | CXTranslationUnit_DetailedPreprocessingRecord;
@@ -456,7 +1002,8 @@ namespace
             clang_parseTranslationUnit2(idx.get(), path, // index and path
                                         args.data(),
                                         static_cast<int>(args.size()), // arguments (ptr + size)
-                                        &file, 1,                      // unsaved files (ptr + size)
+                                        files.data(),
+                                        unsigned(files.size()), // unsaved files (ptr + size)
                                         unsigned(flags), &tu);
         if (error != CXError_Success)
         {
@@ -491,94 +1038,138 @@ namespace
     }
 } // namespace
 
-std::unique_ptr<cpp_file> libclang_parser::do_parse(const cpp_entity_index& idx, std::string path,
-                                                    const compile_config& c) const try
+namespace
 {
-    DEBUG_ASSERT(std::strcmp(c.name(), "libclang") == 0, detail::precondition_error_handler{},
-                 "config has mismatched type");
-    auto& config = static_cast<const libclang_compile_config&>(c);
-
-    // preprocess
-    auto preprocessed = detail::preprocess(config, path.c_str(), logger());
-    if (detail::libclang_compile_config_access::write_preprocessed(config))
+    // parses the file and passes every top-level entity to on_entity in source order,
+    // builder is reset to the file, which is the parent during parsing, but gets no children
+    // returns whether an error occurred
+    template <typename Callback, typename CommentCallback>
+    bool parse_tu(const diagnostic_logger& logger, const detail::cxindex& index, pch_cache& pchs,
+                  const cpp_entity_index& idx, const std::string& path,
+                  const libclang_compile_config& config,
+                  const libclang_parser::entity_filter& filter, bool filter_members,
+                  cpp_file::builder& builder, Callback on_entity,
+                  CommentCallback on_unmatched_comment)
     {
-        std::ofstream file(path + ".pp");
-        file << preprocessed.source;
-    }
+        // preprocess
+        auto preprocessed = detail::preprocess(config, path.c_str(), logger);
+        if (detail::libclang_compile_config_access::write_preprocessed(config))
+        {
+            std::ofstream file(path + ".pp");
+            file << preprocessed.source;
+        }
 
-    // parse
-    auto tu   = get_cxunit(logger(), pimpl_->index, config, path.c_str(), preprocessed.source);
-    auto file = clang_getFile(tu.get(), path.c_str());
+        // the unexposed entities refer to the source instead of copying it
+        std::shared_ptr<const std::string> source;
+        if (detail::libclang_compile_config_access::lazy_unexposed(config))
+            source = std::make_shared<const std::string>(std::move(preprocessed.source));
+        auto& source_str = source ? *source : preprocessed.source;
+
+        // parse
+        auto tu   = get_cxunit(logger, index, pchs, config, path.c_str(), source_str);
+        auto file = clang_getFile(tu.get(), path.c_str());
+
+        builder = cpp_file::builder(detail::cxstring(clang_getFileName(file)).std_str());
+        auto macro_iter   = preprocessed.macros.begin();
+        auto include_iter = preprocessed.includes.begin();
+
+        // convert entity hierarchies
+        detail::parse_context context{tu.get(),
+                                      file,
+                                      type_safe::ref(logger),
+                                      type_safe::ref(idx),
+                                      detail::comment_context(preprocessed.comments),
+                                      false,
+                                      type_safe::opt_ref(filter ? &filter : nullptr),
+                                      filter_members,
+                                      true,
+                                      {},
+                                      {},
+                                      source};
+        detail::visit_tu(tu, path.c_str(), [&](const CXCursor& cur) {
+            if (clang_getCursorKind(cur) == CXCursor_InclusionDirective)
+            {
+                if (!preprocessed.includes.empty())
+                {
+                    DEBUG_ASSERT(include_iter != preprocessed.includes.end()
+                                     && get_line_no(cur) >= include_iter->line,
+                                 detail::assert_handler{});
+
+                    auto full_path = include_iter->full_path.empty() ? include_iter->file_name :
+                                                                       include_iter->full_path;
+
+                    // if we got an absolute file path for the current file,
+                    // also use an absolute file path for the id
+                    // otherwise just use the file name as written in the source file
+                    // note: this is a hack around lack of `fs::canonical()`
+                    cpp_entity_id id("");
+                    if (is_absolute(builder.get().name()))
+                        id = cpp_entity_id(full_path.c_str());
+                    else
+                        id = cpp_entity_id(include_iter->file_name.c_str());
 
-    cpp_file::builder builder(detail::cxstring(clang_getFileName(file)).std_str());
-    auto              macro_iter   = preprocessed.macros.begin();
-    auto              include_iter = preprocessed.includes.begin();
+                    auto include = cpp_include_directive::
+                        build(cpp_file_ref(id, std::move(include_iter->file_name)),
+                              include_iter->kind, std::move(full_path));
+                    context.comments.match(*include, include_iter->line,
+                                           false); // must not skip comments,
+                                                   // includes are not reported in order
+                    on_entity(std::move(include));
 
-    // convert entity hierarchies
-    detail::parse_context context{tu.get(),
-                                  file,
-                                  type_safe::ref(logger()),
-                                  type_safe::ref(idx),
-                                  detail::comment_context(preprocessed.comments),
-                                  false};
-    detail::visit_tu(tu, path.c_str(), [&](const CXCursor& cur) {
-        if (clang_getCursorKind(cur) == CXCursor_InclusionDirective)
-        {
-            if (!preprocessed.includes.empty())
+                    ++include_iter;
+                }
+            }
+            else if (clang_getCursorKind(cur) != CXCursor_MacroDefinition
+                     && clang_getCursorKind(cur) != CXCursor_MacroExpansion)
             {
-                DEBUG_ASSERT(include_iter != preprocessed.includes.end()
-                                 && get_line_no(cur) >= include_iter->line,
-                             detail::assert_handler{});
-
-                auto full_path = include_iter->full_path.empty() ? include_iter->file_name :
-                                                                   include_iter->full_path;
-
-                // if we got an absolute file path for the current file,
-                // also use an absolute file path for the id
-                // otherwise just use the file name as written in the source file
-                // note: this is a hack around lack of `fs::canonical()`
-                cpp_entity_id id("");
-                if (is_absolute(builder.get().name()))
-                    id = cpp_entity_id(full_path.c_str());
-                else
-                    id = cpp_entity_id(include_iter->file_name.c_str());
-
-                auto include =
-                    cpp_include_directive::build(cpp_file_ref(id,
-                                                              std::move(include_iter->file_name)),
-                                                 include_iter->kind, std::move(full_path));
-                context.comments.match(*include, include_iter->line,
-                                       false); // must not skip comments,
-                                               // includes are not reported in order
-                builder.add_child(std::move(include));
-
-                ++include_iter;
+                // add macro if needed
+                for (auto line = get_line_no(cur); macro_iter != preprocessed.macros.end()
+                                                   && macro_iter->line <= line;
+                     ++macro_iter)
+                    on_entity(std::move(macro_iter->macro));
+
+                auto entity = detail::parse_entity(context, &builder.get(), cur);
+                if (entity)
+                    on_entity(std::move(entity));
             }
-        }
-        else if (clang_getCursorKind(cur) != CXCursor_MacroDefinition
-                 && clang_getCursorKind(cur) != CXCursor_MacroExpansion)
+        });
+
+        for (; macro_iter != preprocessed.macros.end(); ++macro_iter)
+            on_entity(std::move(macro_iter->macro));
+
+        for (auto& c : preprocessed.comments)
         {
-            // add macro if needed
-            for (auto line = get_line_no(cur);
-                 macro_iter != preprocessed.macros.end() && macro_iter->line <= line; ++macro_iter)
-                builder.add_child(std::move(macro_iter->macro));
-
-            auto entity = detail::parse_entity(context, &builder.get(), cur);
-            if (entity)
-                builder.add_child(std::move(entity));
-        }
-    });
+            if (!c.comment.buffer)
+                // already matched
+                continue;
 
-    for (; macro_iter != preprocessed.macros.end(); ++macro_iter)
-        builder.add_child(std::move(macro_iter->macro));
+            auto content = c.comment.normalize();
+            if (!content.empty())
+                on_unmatched_comment(cpp_doc_comment(std::move(content), c.line));
+        }
 
-    for (auto& c : preprocessed.comments)
-    {
-        if (!c.comment.empty())
-            builder.add_unmatched_comment(cpp_doc_comment(std::move(c.comment), c.line));
+        return context.error;
     }
+} // namespace
 
-    if (context.error)
+std::unique_ptr<cpp_file> libclang_parser::do_parse(const cpp_entity_index& idx, std::string path,
+                                                    const compile_config& c) const try
+{
+    DEBUG_ASSERT(std::strcmp(c.name(), "libclang") == 0, detail::precondition_error_handler{},
+                 "config has mismatched type");
+    auto& config = static_cast<const libclang_compile_config&>(c);
+
+    impl::index_handle index(*pimpl_);
+    cpp_file::builder  builder(path);
+    auto               error = parse_tu(logger(), index.get(), pimpl_->pchs, idx, path,
+                          config, filter_, filter_members_, builder,
+                          [&](std::unique_ptr<cpp_entity> entity) {
+                              builder.add_child(std::move(entity));
+                          },
+                          [&](cpp_doc_comment comment) {
+                              builder.add_unmatched_comment(std::move(comment));
+                          });
+    if (error)
         set_error();
 
     return builder.finish(idx);
@@ -589,3 +1180,34 @@ catch (detail::parse_error& ex)
     set_error();
     return nullptr;
 }
+
+bool libclang_parser::parse_streaming(type_safe::optional_ref<const cpp_entity_index> idx,
+                                      const std::string& path, const libclang_compile_config& config,
+                                      const entity_consumer& consumer) const try
+{
+    // without an index, register in a scratch index that is cleared after every entity,
+    // so nothing is kept alive
+    cpp_entity_index scratch;
+    auto&            index = idx ? idx.value() : scratch;
+
+    impl::index_handle clang_index(*pimpl_);
+    cpp_file::builder  builder(path);
+    auto               error = parse_tu(logger(), clang_index.get(), pimpl_->pchs, index, path,
+                          config, filter_, filter_members_, builder,
+                          [&](std::unique_ptr<cpp_entity> entity) {
+                              consumer(std::move(entity));
+                              if (!idx)
+                                  scratch.clear();
+                          },
+                          [](cpp_doc_comment) {});
+    if (error)
+        set_error();
+
+    return true;
+}
+catch (detail::parse_error& ex)
+{
+    logger().log("libclang parser", ex.get_diagnostic(path));
+    set_error();
+    return false;
+}
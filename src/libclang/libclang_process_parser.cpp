@@ -0,0 +1,531 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cppast/libclang_process_parser.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+#include <cppast/cpp_entity_index.hpp>
+#include <cppast/cpp_entity_index_snapshot.hpp>
+#include <cppast/cpp_file.hpp>
+#include <cppast/detail/assert.hpp>
+
+#ifndef _WIN32
+extern char** environ;
+#endif
+
+using namespace cppast;
+
+namespace
+{
+    std::string get_default_executable()
+    {
+#if defined(__linux__)
+        return "/proc/self/exe";
+#elif defined(__APPLE__)
+        char     buffer[4096];
+        uint32_t size = sizeof(buffer);
+        return _NSGetExecutablePath(buffer, &size) == 0 ? buffer : "";
+#else
+        return "";
+#endif
+    }
+} // namespace
+
+libclang_process_parser::libclang_process_parser(
+    type_safe::object_ref<const diagnostic_logger> logger, unsigned no_workers,
+    unsigned max_attempts)
+: logger_(logger),
+  executable_(get_default_executable()),
+  timeout_(std::chrono::minutes(10)),
+  no_workers_(no_workers),
+  max_attempts_(max_attempts)
+{
+    DEBUG_ASSERT(no_workers_ > 0u && max_attempts_ > 0u, detail::precondition_error_handler{},
+                 "need at least one worker and attempt");
+}
+
+std::vector<libclang_process_parser::job> cppast::get_jobs(
+    const libclang_compilation_database& database)
+{
+    struct data_t
+    {
+        const libclang_compilation_database&      database;
+        std::vector<libclang_process_parser::job> jobs;
+    } data{database, {}};
+    detail::for_each_file(database, &data, [](void* ptr, std::string file) {
+        auto& data = *static_cast<data_t*>(ptr);
+
+        libclang_compile_config config(data.database, file);
+        data.jobs.push_back({std::move(file), std::move(config)});
+    });
+    return std::move(data.jobs);
+}
+
+#ifndef _WIN32
+namespace
+{
+    constexpr std::uint32_t no_job = std::uint32_t(-1);
+
+    // the file descriptors of the pipes in the worker process
+    constexpr int worker_in = 3, worker_out = 4;
+
+    constexpr const char* worker_flag = "--cppast-worker";
+
+    // send from worker to parent after each job
+    struct job_response
+    {
+        std::uint32_t job;
+        std::uint32_t parsed;
+    };
+
+    // returns false on end of file or error
+    bool read_all(int fd, void* data, std::size_t size)
+    {
+        auto ptr = static_cast<char*>(data);
+        while (size > 0u)
+        {
+            auto result = ::read(fd, ptr, size);
+            if (result < 0 && errno == EINTR)
+                continue;
+            else if (result <= 0)
+                return false;
+            ptr += result;
+            size -= std::size_t(result);
+        }
+        return true;
+    }
+
+    bool read_string(int fd, std::string& str)
+    {
+        std::uint32_t size;
+        if (!read_all(fd, &size, sizeof(size)))
+            return false;
+        str.resize(size);
+        return size == 0u || read_all(fd, &str[0], size);
+    }
+
+    bool write_all(int fd, const void* data, std::size_t size)
+    {
+        auto ptr = static_cast<const char*>(data);
+        while (size > 0u)
+        {
+            auto result = ::write(fd, ptr, size);
+            if (result < 0 && errno == EINTR)
+                continue;
+            else if (result < 0)
+                return false;
+            ptr += result;
+            size -= std::size_t(result);
+        }
+        return true;
+    }
+
+    void append(std::string& message, const void* data, std::size_t size)
+    {
+        message.append(static_cast<const char*>(data), size);
+    }
+
+    void append_string(std::string& message, const std::string& str)
+    {
+        auto size = static_cast<std::uint32_t>(str.size());
+        append(message, &size, sizeof(size));
+        message += str;
+    }
+
+    // the job index followed by the path and the serialized configuration
+    std::string get_job_message(const std::vector<libclang_process_parser::job>& jobs,
+                                std::uint32_t                                    job)
+    {
+        std::string result;
+        append(result, &job, sizeof(job));
+        append_string(result, jobs[job].path);
+        append_string(result,
+                      detail::libclang_compile_config_access::serialize(jobs[job].config));
+        return result;
+    }
+
+    // like write_all(), but doesn't raise SIGPIPE if the worker is dead
+    bool write_job(int fd, const std::string& message)
+    {
+        sigset_t pipe_mask, old_mask;
+        sigemptyset(&pipe_mask);
+        sigaddset(&pipe_mask, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipe_mask, &old_mask);
+
+        auto result = write_all(fd, message.data(), message.size());
+        if (!result)
+        {
+            // consume the SIGPIPE that is now pending for this thread
+            sigset_t pending;
+            sigpending(&pending);
+            if (sigismember(&pending, SIGPIPE))
+            {
+                int signal;
+                sigwait(&pipe_mask, &signal);
+            }
+        }
+
+        pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+        return result;
+    }
+
+    std::string get_temporary_snapshot(const std::string& snapshot_path, std::uint32_t job)
+    {
+        return snapshot_path + "." + std::to_string(job);
+    }
+
+    using worker_clock = std::chrono::steady_clock;
+
+    struct worker
+    {
+        pid_t                    pid;
+        int                      in, out; // from the perspective of the worker
+        std::uint32_t            job;
+        worker_clock::time_point deadline;
+    };
+
+    // creates a pipe whose ends aren't inherited by the workers,
+    // they are duplicated to the right descriptors explicitly
+    bool make_pipe(int (&fds)[2])
+    {
+#ifdef __linux__
+        return ::pipe2(fds, O_CLOEXEC) == 0;
+#else
+        if (::pipe(fds) != 0)
+            return false;
+        ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        return true;
+#endif
+    }
+
+    // moves the descriptor above the ones used by the worker,
+    // so duplicating one to the worker descriptors can't overwrite the other
+    int move_above_worker_fds(int fd)
+    {
+        if (fd > worker_out)
+            return fd;
+        auto result = ::fcntl(fd, F_DUPFD_CLOEXEC, worker_out + 1);
+        ::close(fd);
+        return result;
+    }
+
+    class worker_pool
+    {
+    public:
+        worker_pool(const std::string& executable, const std::string& snapshot_path)
+        : executable_(executable), snapshot_path_(snapshot_path)
+        {
+        }
+
+        worker_pool(const worker_pool&) = delete;
+        worker_pool& operator=(const worker_pool&) = delete;
+
+        ~worker_pool() noexcept
+        {
+            while (!workers_.empty())
+                stop(workers_.size() - 1u);
+        }
+
+        std::vector<worker>& workers() noexcept
+        {
+            return workers_;
+        }
+
+        worker& start()
+        {
+            int to_worker[2], from_worker[2];
+            if (!make_pipe(to_worker))
+                throw libclang_error("unable to create pipe for worker process");
+            if (!make_pipe(from_worker))
+            {
+                ::close(to_worker[0]);
+                ::close(to_worker[1]);
+                throw libclang_error("unable to create pipe for worker process");
+            }
+            to_worker[0]   = move_above_worker_fds(to_worker[0]);
+            from_worker[1] = move_above_worker_fds(from_worker[1]);
+
+            // posix_spawn() doesn't copy the address space of this process like fork() does,
+            // and the worker starts from a clean state even if this process has threads
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_adddup2(&actions, to_worker[0], worker_in);
+            posix_spawn_file_actions_adddup2(&actions, from_worker[1], worker_out);
+
+            char* argv[] = {const_cast<char*>(executable_.c_str()),
+                            const_cast<char*>(worker_flag),
+                            const_cast<char*>(snapshot_path_.c_str()), nullptr};
+            pid_t pid;
+            auto  error = to_worker[0] < 0 || from_worker[1] < 0 ?
+                             EMFILE :
+                             ::posix_spawn(&pid, executable_.c_str(), &actions, nullptr, argv,
+                                           environ);
+            posix_spawn_file_actions_destroy(&actions);
+
+            ::close(to_worker[0]);
+            ::close(from_worker[1]);
+            if (error != 0)
+            {
+                ::close(to_worker[1]);
+                ::close(from_worker[0]);
+                throw libclang_error("unable to start worker process '" + executable_ + "'");
+            }
+
+            workers_.push_back(worker{pid, to_worker[1], from_worker[0], no_job, {}});
+            return workers_.back();
+        }
+
+        // closing the pipe makes an idle worker exit,
+        // one that is still busy with a job is killed, as it might hang
+        void stop(std::size_t index) noexcept
+        {
+            auto w = workers_[index];
+            workers_.erase(workers_.begin() + std::ptrdiff_t(index));
+
+            ::close(w.in);
+            ::close(w.out);
+            if (w.job != no_job)
+                ::kill(w.pid, SIGKILL);
+            while (::waitpid(w.pid, nullptr, 0) < 0 && errno == EINTR)
+                ;
+        }
+
+    private:
+        const std::string&  executable_;
+        const std::string&  snapshot_path_;
+        std::vector<worker> workers_;
+    };
+} // namespace
+#endif
+
+void libclang_process_parser::run_worker(int argc, char* argv[],
+                                         libclang_parser::entity_filter filter, bool filter_members)
+{
+#ifdef _WIN32
+    (void)argc;
+    (void)argv;
+    (void)filter;
+    (void)filter_members;
+#else
+    if (argc != 3 || std::strcmp(argv[1], worker_flag) != 0)
+        return;
+    std::string snapshot_path = argv[2];
+
+    {
+        // destroyed before exiting, this removes the precompiled preludes of the worker
+        libclang_parser parser(default_logger());
+        parser.set_entity_filter(std::move(filter), filter_members);
+
+        std::uint32_t job;
+        std::string   path, config;
+        while (read_all(worker_in, &job, sizeof(job)) && read_string(worker_in, path)
+               && read_string(worker_in, config))
+        {
+            auto parsed = false;
+            try
+            {
+                cpp_entity_index idx;
+                auto             file =
+                    parser.parse(idx, path,
+                                 detail::libclang_compile_config_access::deserialize(config));
+                if (file)
+                {
+                    idx.write_snapshot(get_temporary_snapshot(snapshot_path, job));
+                    parsed = true;
+                }
+            }
+            catch (std::exception& ex)
+            {
+                default_logger()->log("libclang process parser",
+                                      diagnostic{ex.what(), source_location::make_file(path),
+                                                 severity::critical});
+            }
+            parser.reset_error();
+
+            job_response response{job, parsed};
+            if (!write_all(worker_out, &response, sizeof(response)))
+                break;
+        }
+    }
+
+    std::exit(0);
+#endif
+}
+
+libclang_process_result libclang_process_parser::parse(const std::vector<job>& jobs,
+                                                       const std::string& snapshot_path) const
+{
+#ifdef _WIN32
+    (void)jobs;
+    (void)snapshot_path;
+    throw libclang_error("libclang_process_parser requires a POSIX system");
+#else
+    if (executable_.empty())
+        throw libclang_error("libclang_process_parser requires a worker executable");
+
+    libclang_process_result    result;
+    std::vector<std::uint32_t> parsed_jobs;
+
+    std::deque<std::uint32_t> pending;
+    for (auto i = 0u; i != jobs.size(); ++i)
+        pending.push_back(i);
+    std::vector<unsigned> attempts(jobs.size(), 0u);
+
+    worker_pool pool(executable_, snapshot_path);
+    auto        abort_job = [&](std::size_t index, bool timed_out) {
+        auto job = pool.workers()[index].job;
+        pool.stop(index);
+        // it might have been writing the snapshot
+        std::remove(get_temporary_snapshot(snapshot_path, job).c_str());
+
+        logger_->log("libclang process parser",
+                     diagnostic{timed_out ? "worker process timed out" : "worker process crashed",
+                                source_location::make_file(jobs[job].path), severity::error});
+        if (attempts[job] < max_attempts_)
+            pending.push_back(job);
+        else if (timed_out)
+            result.timed_out.push_back(jobs[job].path);
+        else
+            result.crashed.push_back(jobs[job].path);
+    };
+    // assigns the next pending job to the worker, returns false if the worker is dead
+    auto assign = [&](worker& w) {
+        w.job = pending.front();
+        pending.pop_front();
+        ++attempts[w.job];
+        w.deadline = worker_clock::now() + timeout_;
+        return write_job(w.in, get_job_message(jobs, w.job));
+    };
+    auto dispatch = [&] {
+        for (auto i = 0u; i < pool.workers().size() && !pending.empty();)
+        {
+            auto& w = pool.workers()[i];
+            if (w.job != no_job || assign(w))
+                ++i;
+            else
+            {
+                // the worker died after its previous job, the new one isn't to blame
+                --attempts[w.job];
+                pending.push_front(w.job);
+                w.job = no_job;
+                pool.stop(i);
+            }
+        }
+
+        // a new worker that can't even take its first job is charged,
+        // otherwise a broken executable would be started again and again
+        while (pool.workers().size() < no_workers_ && !pending.empty())
+            if (!assign(pool.start()))
+                abort_job(pool.workers().size() - 1u, false);
+    };
+
+    dispatch();
+    while (true)
+    {
+        std::vector<pollfd>      fds;
+        std::vector<std::size_t> busy;
+        auto                     wait = -1;
+        auto                     now  = worker_clock::now();
+        for (auto i = 0u; i != pool.workers().size(); ++i)
+        {
+            auto& w = pool.workers()[i];
+            if (w.job == no_job)
+                continue;
+
+            fds.push_back(pollfd{w.out, POLLIN, 0});
+            busy.push_back(i);
+            if (timeout_ != timeout_.zero())
+            {
+                // round up, so the deadline has passed when poll() returns
+                auto left =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(w.deadline - now).count()
+                    + 1;
+                auto ms = left < 0 ? 0 : static_cast<int>(left);
+                wait    = wait < 0 ? ms : std::min(wait, ms);
+            }
+        }
+        if (fds.empty())
+            break;
+
+        if (::poll(fds.data(), fds.size(), wait) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw libclang_error("unable to wait for worker processes");
+        }
+
+        // in reverse, so that stopping a worker doesn't change the indices of the others
+        now = worker_clock::now();
+        for (auto i = fds.size(); i-- != 0u;)
+        {
+            auto& w = pool.workers()[busy[i]];
+            if (fds[i].revents == 0)
+            {
+                if (timeout_ != timeout_.zero() && now >= w.deadline)
+                    abort_job(busy[i], true);
+                continue;
+            }
+
+            job_response response;
+            if (read_all(w.out, &response, sizeof(response)) && response.job == w.job)
+            {
+                if (response.parsed)
+                    parsed_jobs.push_back(w.job);
+                else
+                    result.failed.push_back(jobs[w.job].path);
+                w.job = no_job;
+            }
+            else
+                abort_job(busy[i], false);
+        }
+
+        dispatch();
+    }
+    // merge in the order of the jobs, so the result doesn't depend on the scheduling
+    std::sort(parsed_jobs.begin(), parsed_jobs.end());
+    std::vector<std::string> snapshots;
+    for (auto job : parsed_jobs)
+    {
+        result.parsed.push_back(jobs[job].path);
+        snapshots.push_back(get_temporary_snapshot(snapshot_path, job));
+    }
+
+    try
+    {
+        cpp_entity_index_snapshot::merge(snapshots, snapshot_path);
+    }
+    catch (...)
+    {
+        for (auto& snapshot : snapshots)
+            std::remove(snapshot.c_str());
+        throw;
+    }
+    for (auto& snapshot : snapshots)
+        std::remove(snapshot.c_str());
+
+    return result;
+#endif
+}
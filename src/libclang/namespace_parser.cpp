@@ -67,7 +67,7 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_namespace(const detail::parse_cont
     {
         // steal comment from parent
         DEBUG_ASSERT(parent.kind() == cpp_namespace::kind(), detail::assert_handler{});
-        builder.get().set_comment(type_safe::copy(parent.comment()));
+        builder.get().set_comment(parent);
         parent.set_comment(type_safe::nullopt);
     }
     else
@@ -24,7 +24,9 @@ cpp_entity_id detail::get_entity_id(const CXCursor& cur)
         // same workaround also applies to conversion functions,
         // there template arguments in the result are ignored
         cxstring type_spelling(clang_getTypeSpelling(clang_getCursorResultType(cur)));
-        return cpp_entity_id(std::string(usr.c_str()) + type_spelling.c_str());
+        return cpp_entity_id(detail::id_hasher()
+                                 .append(usr.c_str(), usr.length())
+                                 .append(type_spelling.c_str(), type_spelling.length()));
     }
     else if (clang_getCursorKind(cur) == CXCursor_ClassTemplatePartialSpecialization)
     {
@@ -33,10 +35,12 @@ cpp_entity_id detail::get_entity_id(const CXCursor& cur)
         // same workaround: combine display name with usr
         // (and hope this prevents all collisions...)
         cxstring display_name(clang_getCursorDisplayName(cur));
-        return cpp_entity_id(std::string(usr.c_str()) + display_name.c_str());
+        return cpp_entity_id(detail::id_hasher()
+                                 .append(usr.c_str(), usr.length())
+                                 .append(display_name.c_str(), display_name.length()));
     }
     else
-        return cpp_entity_id(usr.c_str());
+        return cpp_entity_id(usr.c_str(), usr.length());
 }
 
 detail::cxstring detail::get_cursor_name(const CXCursor& cur)
@@ -76,6 +80,22 @@ cpp_storage_class_specifiers detail::get_storage_class(const CXCursor& cur)
     return cpp_storage_class_none;
 }
 
+const cpp_entity_id& detail::cursor_cache::entity_id(const CXCursor& cur) const
+{
+    auto& entry = entries_[cur];
+    if (!entry.id)
+        entry.id = get_entity_id(cur);
+    return entry.id.value();
+}
+
+const std::string& detail::cursor_cache::display_name(const CXCursor& cur) const
+{
+    auto& entry = entries_[cur];
+    if (!entry.display_name)
+        entry.display_name = cxstring(clang_getCursorDisplayName(cur)).std_str();
+    return entry.display_name.value();
+}
+
 void detail::comment_context::match(cpp_entity& e, const CXCursor& cur) const
 {
     auto     pos = clang_getRangeStart(clang_getCursorExtent(cur));
@@ -111,6 +131,98 @@ namespace
     }
 }
 
+namespace
+{
+    cpp_entity_kind get_entity_kind(const CXCursor& cur)
+    {
+        switch (clang_getCursorKind(cur))
+        {
+        case CXCursor_NamespaceAlias:
+            return cpp_entity_kind::namespace_alias_t;
+        case CXCursor_UsingDirective:
+            return cpp_entity_kind::using_directive_t;
+        case CXCursor_UsingDeclaration:
+            return cpp_entity_kind::using_declaration_t;
+
+        case CXCursor_TypeAliasDecl:
+        case CXCursor_TypedefDecl:
+            return cpp_entity_kind::type_alias_t;
+        case CXCursor_EnumDecl:
+            return cpp_entity_kind::enum_t;
+        case CXCursor_ClassDecl:
+        case CXCursor_StructDecl:
+        case CXCursor_UnionDecl:
+            return cpp_entity_kind::class_t;
+
+        case CXCursor_VarDecl:
+            return cpp_entity_kind::variable_t;
+        case CXCursor_FieldDecl:
+            return clang_Cursor_isBitField(cur) ? cpp_entity_kind::bitfield_t :
+                                                  cpp_entity_kind::member_variable_t;
+
+        case CXCursor_FunctionDecl:
+            return cpp_entity_kind::function_t;
+        case CXCursor_CXXMethod:
+            return cpp_entity_kind::member_function_t;
+        case CXCursor_ConversionFunction:
+            return cpp_entity_kind::conversion_op_t;
+        case CXCursor_Constructor:
+            return cpp_entity_kind::constructor_t;
+        case CXCursor_Destructor:
+            return cpp_entity_kind::destructor_t;
+
+#if CPPAST_CINDEX_HAS_FRIEND
+        case CXCursor_FriendDecl:
+            return cpp_entity_kind::friend_t;
+#endif
+
+        case CXCursor_TypeAliasTemplateDecl:
+            return cpp_entity_kind::alias_template_t;
+        case CXCursor_FunctionTemplate:
+            return cpp_entity_kind::function_template_t;
+        case CXCursor_ClassTemplate:
+            return cpp_entity_kind::class_template_t;
+        case CXCursor_ClassTemplatePartialSpecialization:
+            return cpp_entity_kind::class_template_specialization_t;
+
+        case CXCursor_StaticAssert:
+            return cpp_entity_kind::static_assert_t;
+
+        default:
+            break;
+        }
+
+        return cpp_entity_kind::unexposed_t;
+    }
+
+    struct attribute_check_data
+    {
+        const detail::parse_context& context;
+        const CXCursor&              cur;
+    };
+
+    bool has_attributes(const void* data)
+    {
+        auto& check = *static_cast<const attribute_check_data*>(data);
+        return detail::has_attributes_before_name(check.context.tu, check.context.file, check.cur);
+    }
+
+    // whether the entity passes the filter, if any
+    bool is_selected(const detail::parse_context& context, const CXCursor& cur)
+    {
+        auto kind = clang_getCursorKind(cur);
+        if (!context.filter || kind == CXCursor_Namespace || kind == CXCursor_UnexposedDecl
+            || clang_isAttribute(kind))
+            // always parse containers, attributes aren't entities
+            return true;
+
+        detail::cxstring     name(clang_getCursorSpelling(cur));
+        attribute_check_data data{context, cur};
+        return context.filter.value()(
+            libclang_entity_info(get_entity_kind(cur), name.c_str(), &has_attributes, &data));
+    }
+} // namespace
+
 std::unique_ptr<cpp_entity> detail::parse_entity(const detail::parse_context& context,
                                                  cpp_entity* parent, const CXCursor& cur,
                                                  const CXCursor& parent_cur) try
@@ -123,6 +235,10 @@ std::unique_ptr<cpp_entity> detail::parse_entity(const detail::parse_context& co
                                               detail::get_cursor_kind_spelling(cur).c_str(), "'"));
     }
 
+    if (parent && context.use_filter && !is_selected(context, cur))
+        // a rejected class can still contain selected members
+        return parse_cpp_class_scope(context, cur);
+
     auto kind = clang_getCursorKind(cur);
     switch (kind)
     {
@@ -215,10 +331,10 @@ std::unique_ptr<cpp_entity> detail::parse_entity(const detail::parse_context& co
         // build unexposed entity
         detail::cxtokenizer    tokenizer(context.tu, context.file, cur);
         detail::cxtoken_stream stream(tokenizer, cur);
-        auto                   spelling = detail::to_string(stream, stream.end());
-        if (spelling.begin() + 1 == spelling.end() && spelling.front().spelling == ";")
+        if (stream.end() - stream.begin() == 1 && stream.peek() == ";")
             // unnecessary semicolon
             return nullptr;
+        auto spelling = detail::to_lazy_string(stream, stream.end(), context.source);
 
         auto name = detail::get_cursor_name(cur);
 
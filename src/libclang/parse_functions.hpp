@@ -5,7 +5,12 @@
 #ifndef CPPAST_PARSE_FUNCTIONS_HPP_INCLUDED
 #define CPPAST_PARSE_FUNCTIONS_HPP_INCLUDED
 
+#include <unordered_map>
+
 #include <cppast/cpp_entity.hpp>
+#include <cppast/cpp_expression.hpp>
+#include <cppast/cpp_type.hpp>
+#include <cppast/libclang_parser.hpp>
 #include <cppast/parser.hpp>
 
 #include "raii_wrapper.hpp"
@@ -21,7 +26,6 @@
 
 namespace cppast
 {
-    class cpp_expression;
     class cpp_type;
     enum cpp_storage_class_specifiers : int;
 
@@ -55,6 +59,99 @@ namespace cppast
             pp_doc_comment*         end_;
         };
 
+        // caches information about cursors that is requested repeatedly,
+        // like the ids of entities referenced by types,
+        // it lives as long as the translation unit
+        class cursor_cache
+        {
+        public:
+            // same as get_entity_id(cur)
+            const cpp_entity_id& entity_id(const CXCursor& cur) const;
+
+            // same as clang_getCursorDisplayName()
+            const std::string& display_name(const CXCursor& cur) const;
+
+        private:
+            struct hash
+            {
+                std::size_t operator()(const CXCursor& cur) const noexcept
+                {
+                    return clang_hashCursor(cur);
+                }
+            };
+
+            struct equal
+            {
+                bool operator()(const CXCursor& a, const CXCursor& b) const noexcept
+                {
+                    return clang_equalCursors(a, b) != 0u;
+                }
+            };
+
+            struct entry
+            {
+                type_safe::optional<cpp_entity_id> id;
+                type_safe::optional<std::string>   display_name;
+            };
+
+            mutable std::unordered_map<CXCursor, entry, hash, equal> entries_;
+        };
+
+        // caches the spelling of types,
+        // as clang_getTypeSpelling() prints the type again on every call,
+        // it lives as long as the translation unit
+        class type_cache
+        {
+        public:
+            // the spelling of the type as used at the cursor,
+            // the only thing that depends on the cursor is the scope of typedefs
+            const std::string& spelling(const CXCursor& cur, const CXType& type) const;
+
+            struct leave_spelling
+            {
+                std::string spelling; // without cv qualifiers and class keys
+                cpp_cv      cv;
+            };
+
+            // the spelling of a leave type split into name and cv qualifiers
+            const leave_spelling& leave(const CXCursor& cur, const CXType& type) const;
+
+        private:
+            struct key
+            {
+                CXType type;
+                bool   remove_scope;
+            };
+
+            struct hash
+            {
+                std::size_t operator()(const key& k) const noexcept
+                {
+                    // data[0] identifies the type including qualifiers, data[1] is the TU
+                    return std::hash<const void*>()(k.type.data[0]) * 2u + k.remove_scope;
+                }
+            };
+
+            struct equal
+            {
+                bool operator()(const key& a, const key& b) const noexcept
+                {
+                    return a.remove_scope == b.remove_scope
+                           && clang_equalTypes(a.type, b.type) != 0u;
+                }
+            };
+
+            struct entry
+            {
+                std::string                        spelling;
+                type_safe::optional<leave_spelling> leave;
+            };
+
+            entry& get_entry(const CXCursor& cur, const CXType& type) const;
+
+            mutable std::unordered_map<key, entry, hash, equal> entries_;
+        };
+
         struct parse_context
         {
             CXTranslationUnit                              tu;
@@ -63,8 +160,27 @@ namespace cppast
             type_safe::object_ref<const cpp_entity_index>  idx;
             comment_context                                comments;
             mutable bool                                   error;
+            // empty if everything should be parsed
+            type_safe::optional_ref<const libclang_parser::entity_filter> filter;
+            // whether the members of accepted classes are filtered
+            bool filter_members;
+            // whether the filter applies to the entities currently parsed,
+            // false while parsing the members of an accepted class unless they are filtered
+            mutable bool use_filter;
+            cursor_cache                                                  cache;
+            type_cache                                                    types;
+            // the preprocessed source if unexposed spellings are tokenized lazily,
+            // nullptr otherwise
+            std::shared_ptr<const std::string> source;
         };
 
+        // same as get_entity_id(cur), but cached
+        inline const cpp_entity_id& get_entity_id(const parse_context& context,
+                                                  const CXCursor&      cur)
+        {
+            return context.cache.entity_id(cur);
+        }
+
         // parse default value of variable, function parameter...
         std::unique_ptr<cpp_expression> parse_default_value(cpp_attribute_list&  attributes,
                                                             const parse_context& context,
@@ -80,16 +196,24 @@ namespace cppast
         std::unique_ptr<cpp_type> parse_raw_type(const parse_context& context,
                                                  cxtoken_stream& stream, cxtoken_iterator end);
 
+        // whether the cursor is (inside) the pattern of a template
+        bool is_in_template(CXCursor cur);
+
+        // returns the value of an integral constant expression, if it can be evaluated
+        // expressions inside templates are only evaluated if they consist of literals
+        // and operators, as they might depend on template parameters otherwise
+        type_safe::optional<cpp_integral_value> evaluate_integral(const CXCursor& expr);
+
         std::unique_ptr<cpp_expression> parse_expression(const parse_context& context,
                                                          const CXCursor&      cur);
         // parse the expression starting at the current token in the stream
         // and ends at the given iterator
         // this is required for situations where there is no expression cursor exposed,
         // like member initializers
-        std::unique_ptr<cpp_expression> parse_raw_expression(const parse_context&      context,
-                                                             cxtoken_stream&           stream,
-                                                             cxtoken_iterator          end,
-                                                             std::unique_ptr<cpp_type> type);
+        std::unique_ptr<cpp_expression> parse_raw_expression(
+            const parse_context& context, cxtoken_stream& stream, cxtoken_iterator end,
+            std::unique_ptr<cpp_type>               type,
+            type_safe::optional<cpp_integral_value> evaluated = type_safe::nullopt);
 
         // parse_entity() dispatches on the cursor type
         // it calls one of the other parse functions defined elsewhere
@@ -128,6 +252,10 @@ namespace cppast
         std::unique_ptr<cpp_entity> parse_cpp_class(const parse_context& context,
                                                     const CXCursor&      cur,
                                                     const CXCursor&      parent_cur);
+        // only the scope of a class rejected by the filter with the members that are selected,
+        // returns nullptr if it is no class definition or no member is selected
+        std::unique_ptr<cpp_entity> parse_cpp_class_scope(const parse_context& context,
+                                                          const CXCursor&      cur);
 
         std::unique_ptr<cpp_entity> parse_cpp_variable(const parse_context& context,
                                                        const CXCursor&      cur);
@@ -162,7 +290,8 @@ namespace cppast
         std::unique_ptr<cpp_entity> parse_cpp_static_assert(const parse_context& context,
                                                             const CXCursor&      cur);
 
-        // parent: used for nested namespace, doesn't matter otherwise
+        // parent: used for nested namespace, doesn't matter otherwise,
+        // only entities with a parent are checked against the filter
         // parent_cur: used when parsing templates or friends
         std::unique_ptr<cpp_entity> parse_entity(
             const parse_context& context, cpp_entity* parent, const CXCursor& cur,
@@ -7,21 +7,122 @@
 #include <algorithm>
 #include <atomic>
 #include <cctype>
+#include <cerrno>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <unordered_map>
 
-#include <process.hpp>
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
 
 #include <cppast/diagnostic.hpp>
 
+#include "child_process.hpp"
+#include "file_cache.hpp"
 #include "parse_error.hpp"
 
 using namespace cppast;
-namespace tpl = TinyProcessLib;
 namespace ts  = type_safe;
 
+namespace
+{
+    std::string get_system_temporary_directory()
+    {
+#ifdef _WIN32
+        for (auto var : {"TMP", "TEMP"})
+#else
+        for (auto var : {"TMPDIR"})
+#endif
+            if (auto dir = std::getenv(var))
+                if (*dir)
+                    return dir;
+#ifdef _WIN32
+        return ".";
+#else
+        return "/tmp";
+#endif
+    }
+
+    std::string create_temporary_directory()
+    {
+        auto dir = get_system_temporary_directory();
+        if (dir.back() != '/' && dir.back() != '\\')
+            dir += '/';
+
+#ifdef _WIN32
+        static std::atomic<unsigned> counter(0u);
+        auto                         prefix = dir + "cppast-" + std::to_string(_getpid()) + "-";
+        for (auto i = 0u; i != 100u; ++i)
+        {
+            auto name = prefix + std::to_string(++counter);
+            if (_mkdir(name.c_str()) == 0)
+                return name + '/';
+            else if (errno != EEXIST)
+                break;
+        }
+#else
+        // mkdtemp() creates the directory with access only for the current user
+        dir += "cppast-XXXXXX";
+        if (::mkdtemp(&dir[0]))
+            return dir + '/';
+#endif
+        throw libclang_error("preprocessor: unable to create temporary directory in '" + dir + "'");
+    }
+
+    const std::string& get_temporary_directory()
+    {
+        static const std::string dir = create_temporary_directory();
+        return dir;
+    }
+
+    // removes whatever is left in the temporary directory
+    void remove_temporary_directory()
+    {
+        auto& dir = get_temporary_directory();
+#ifdef _WIN32
+        _finddata_t data;
+        auto        handle = _findfirst((dir + "*").c_str(), &data);
+        if (handle != -1)
+        {
+            do
+                std::remove((dir + data.name).c_str());
+            while (_findnext(handle, &data) == 0);
+            _findclose(handle);
+        }
+        _rmdir(dir.c_str());
+#else
+        if (auto handle = ::opendir(dir.c_str()))
+        {
+            while (auto entry = ::readdir(handle))
+                if (std::strcmp(entry->d_name, ".") != 0 && std::strcmp(entry->d_name, "..") != 0)
+                    std::remove((dir + entry->d_name).c_str());
+            ::closedir(handle);
+        }
+        ::rmdir(dir.c_str());
+#endif
+    }
+} // namespace
+
+std::string detail::get_temporary_path(const char* prefix)
+{
+    // registered after the directory is created, so it runs before the string is destroyed
+    static const bool remove_on_exit
+        = (get_temporary_directory(), std::atexit(remove_temporary_directory) == 0);
+    (void)remove_on_exit;
+
+    // the directory belongs to this process, so the counter is enough to make it unique
+    static std::atomic<unsigned> counter(0u);
+    return get_temporary_directory() + prefix + "-" + std::to_string(++counter);
+}
+
 bool detail::pp_doc_comment::matches(const cpp_entity&, unsigned e_line)
 {
     if (kind == detail::pp_doc_comment::end_of_line)
@@ -164,8 +265,137 @@ namespace
         return flags;
     }
 
+    bool is_absolute_path(const std::string& path)
+    {
+        return !path.empty()
+               && (path.front() == '/' || path.front() == '\\'
+                   || (path.size() > 2u && path[1] == ':'));
+    }
+
+    std::string get_absolute_path(const std::string& path)
+    {
+        if (is_absolute_path(path))
+            return path;
+
+        std::vector<char> buffer(256u);
+#ifdef _WIN32
+        while (!_getcwd(buffer.data(), int(buffer.size())))
+#else
+        while (!::getcwd(buffer.data(), buffer.size()))
+#endif
+        {
+            if (errno != ERANGE)
+                throw libclang_error("preprocessor: unable to get current working directory");
+            buffer.resize(buffer.size() * 2u);
+        }
+
+        std::string result(buffer.data());
+        if (!result.empty() && result.back() != '/' && result.back() != '\\')
+            result += '/';
+        return result + (path.compare(0u, 2u, "./") == 0 ? path.substr(2u) : path);
+    }
+
+    std::string json_string(const std::string& str)
+    {
+        std::string result = "\"";
+        for (auto c : str)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result + '"';
+    }
+
+    // temporary files that are removed when the object is destroyed
+    class temporary_files
+    {
+    public:
+        temporary_files() = default;
+
+        temporary_files(const temporary_files&) = delete;
+        temporary_files& operator=(const temporary_files&) = delete;
+
+        ~temporary_files() noexcept
+        {
+            for (auto& file : files_)
+                std::remove(file.c_str());
+        }
+
+        // writes a new temporary file and returns its path
+        std::string write(const char* prefix, const std::string& contents)
+        {
+            files_.push_back(detail::get_temporary_path(prefix));
+
+            std::ofstream stream(files_.back(), std::ios_base::binary);
+            if (!stream.write(contents.data(), std::streamsize(contents.size())).flush())
+                throw libclang_error("preprocessor: unable to write temporary file '"
+                                     + files_.back() + "'");
+            return files_.back();
+        }
+
+    private:
+        std::vector<std::string> files_;
+    };
+
+    // the unsaved files of the config, written to disk for the external preprocessor,
+    // together with a virtual file system overlay that maps the original names to them
+    class overlay_files
+    {
+    public:
+        explicit overlay_files(const libclang_compile_config& c)
+        {
+            auto& unsaved = detail::libclang_compile_config_access::unsaved_files(c);
+            if (unsaved.empty())
+                return;
+
+            // files_ removes everything written so far if this throws
+            std::string roots;
+            for (auto& file : unsaved)
+            {
+                auto name = files_.write("cppast-unsaved", file.second);
+
+                if (!roots.empty())
+                    roots += ",\n";
+                roots += "    {\"type\": \"file\", \"name\": "
+                         + json_string(get_absolute_path(file.first))
+                         + ", \"external-contents\": " + json_string(name) + "}";
+            }
+
+            auto overlay = std::string("{\n  \"version\": 0,\n  \"use-external-names\": false,\n")
+                           + "  \"roots\": [\n" + roots + "\n  ]\n}\n";
+            overlay_ = files_.write("cppast-overlay", overlay);
+        }
+
+        // the flag that tells clang to use the overlay, if there is one
+        std::string flag() const
+        {
+            // -ivfsoverlay: use the files of the overlay instead of the ones on disk
+            return overlay_.empty() ? "" : " -ivfsoverlay " + quote(overlay_);
+        }
+
+    private:
+        temporary_files files_;
+        std::string     overlay_;
+    };
+
+    // the flags to use the prelude or precompiled header,
+    // they need to match the ones given to libclang
+    std::string prelude_flags(const libclang_compile_config& c)
+    {
+        auto& precompiled_header = detail::libclang_compile_config_access::precompiled_header(c);
+        auto& prelude            = detail::libclang_compile_config_access::prelude(c);
+        if (!precompiled_header.empty())
+            return " -include-pch " + quote(precompiled_header);
+        else if (!prelude.empty())
+            return " -include " + quote(prelude);
+        else
+            return "";
+    }
+
     // get the command that returns all macros defined in the TU
-    std::string get_macro_command(const libclang_compile_config& c, const char* full_path)
+    std::string get_macro_command(const libclang_compile_config& c, const char* full_path,
+                                  const overlay_files& overlay)
     {
         // -x c++: force C++ as input language
         // -I.: add current working directory to include search path
@@ -173,6 +403,8 @@ namespace
         // -dM: print macro definitions instead of preprocessed file
         auto flags = std::string("-x c++ -I. -E -dM");
         flags += diagnostics_flags();
+        flags += overlay.flag();
+        flags += prelude_flags(c);
 
         std::string cmd(detail::libclang_compile_config_access::clang_binary(c) + " "
                         + std::move(flags) + " ");
@@ -189,7 +421,7 @@ namespace
     // get the command that preprocess a translation unit given the macros
     // macro_file_path == nullptr <=> don't do fast preprocessing
     std::string get_preprocess_command(const libclang_compile_config& c, const char* full_path,
-                                       const char* macro_file_path)
+                                       const char* macro_file_path, const overlay_files& overlay)
     {
         // -x c++: force C++ as input language
         // -E: print preprocessor output
@@ -198,10 +430,14 @@ namespace
 
         // -CC: keep comments, even in macro
         // -C: keep comments, but not in macro
-        if (!detail::libclang_compile_config_access::remove_comments_in_macro(c))
-            flags += " -CC";
-        else
-            flags += " -C";
+        // neither: remove comments, if they aren't needed
+        if (detail::libclang_compile_config_access::parse_comments(c))
+        {
+            if (!detail::libclang_compile_config_access::remove_comments_in_macro(c))
+                flags += " -CC";
+            else
+                flags += " -C";
+        }
 
         if (macro_file_path)
             // -no*: disable default include search paths
@@ -212,13 +448,16 @@ namespace
             flags += " -Xclang -dI";
 
         flags += diagnostics_flags();
+        flags += overlay.flag();
 
         if (macro_file_path)
         {
-            // include file that defines all macros
+            // include file that defines all macros, including the ones of the prelude
             flags += " -include ";
             flags += macro_file_path;
         }
+        else
+            flags += prelude_flags(c);
 
         std::string cmd(detail::libclang_compile_config_access::clang_binary(c) + " "
                         + std::move(flags) + " ");
@@ -241,119 +480,23 @@ namespace
 
     std::string get_macro_file_name()
     {
-        static std::atomic<unsigned> counter(0u);
-        return "standardese-macro-file-" + std::to_string(++counter) + ".delete-me";
-    }
-
-    template <std::size_t N>
-    void bump_until(std::istreambuf_iterator<char>& iter, const char (&str)[N])
-    {
-        auto ptr = &str[0];
-        while (ptr != &str[N - 1])
-        {
-            if (iter == std::istreambuf_iterator<char>{})
-                // end of file
-                break;
-            else if (*iter != *ptr)
-            {
-                // try again
-                ptr = &str[0];
-                if (*iter == *ptr)
-                    ++ptr; // it was the first character again
-            }
-            else
-                // okay, move forward
-                ++ptr;
-
-            ++iter;
-        }
-    }
-
-    template <typename Iter>
-    void skip_whitespace(Iter& begin, Iter end)
-    {
-        while (begin != end && (*begin == ' ' || *begin == '\t'))
-            ++begin;
-    }
-
-    template <typename Iter>
-    std::string get_line(Iter& begin, Iter end)
-    {
-        std::string line;
-        while (begin != end && *begin != '\n')
-            line += *begin++;
-        ++begin; // newline
-        return line;
+        return detail::get_temporary_path("standardese-macro-file");
     }
 
-    type_safe::optional<std::string> get_include_guard_macro(const std::string& full_path)
+    type_safe::optional<std::string> get_include_guard_macro(const libclang_compile_config& c,
+                                                             const std::string& full_path)
     {
-        std::ifstream file(full_path);
-
-        auto iter = std::istreambuf_iterator<char>(file);
-        while (iter != std::istreambuf_iterator<char>{})
-        {
-            if (*iter == '/')
-            {
-                ++iter;
-                if (*iter == '/')
-                    // C++ style comment, bump until \n
-                    bump_until(iter, "\n");
-                else if (*iter == '*')
-                    // C style comment
-                    bump_until(iter, "*/");
-            }
-            else if (*iter == ' ' || *iter == '\t' || *iter == '\n')
-                ++iter; // empty
-            else if (*iter == '#')
-            {
-                // preprocessor line
-                auto if_line = get_line(iter, {});
-                if (if_line.compare(0, 3, "#if") != 0)
-                    // not something starting with #if
-                    break;
-
-                skip_whitespace(iter, {});
-
-                auto macro_line = get_line(iter, {});
-                if (macro_line.compare(0, 7, "#define") != 0)
-                    // not a corresponding define
-                    break;
-
-                auto macro_name_begin = std::next(macro_line.begin(), 7);
-                // skip whitespace after define
-                skip_whitespace(macro_name_begin, macro_line.end());
-
-                auto macro_name_end = macro_name_begin;
-                // skip over identifier
-                while (macro_name_end != macro_line.end()
-                       && (*macro_name_end == '_' || std::isalnum(*macro_name_end)))
-                    ++macro_name_end;
-
-                auto trailing_ws = macro_line.rbegin();
-                skip_whitespace(trailing_ws, macro_line.rend());
-                if (macro_name_end != trailing_ws.base())
-                    // anything else after macro
-                    break;
-
-                std::string macro_name(macro_name_begin, macro_name_end);
-                if (if_line.find(macro_name) == std::string::npos)
-                    // macro name doesn't occur in if line
-                    break;
-                else
-                    return macro_name;
-            }
-            else
-                // line is neither empty, comment, nor preprocessor
-                break;
-        }
-
-        // assume no include guard followed a bad line
-        return type_safe::nullopt;
+        if (auto unsaved = detail::find_unsaved_file(c, full_path))
+            return detail::get_include_guard_macro(unsaved->data(),
+                                                   unsaved->data() + unsaved->size());
+        else if (auto file = detail::read_file(full_path))
+            return file->include_guard();
+        else
+            return type_safe::nullopt;
     }
 
     std::string write_macro_file(const libclang_compile_config& c, const std::string& full_path,
-                                 const diagnostic_logger& logger)
+                                 const overlay_files& overlay, const diagnostic_logger& logger)
     {
         std::string diagnostic;
         auto        diagnostic_logger = [&](const char* str, std::size_t n) {
@@ -374,23 +517,26 @@ namespace
         auto          file = get_macro_file_name();
         std::ofstream stream(file);
 
-        auto         cmd = get_macro_command(c, full_path.c_str());
-        tpl::Process process(cmd, "",
-                             [&](const char* str, std::size_t n) {
-                                 stream.write(str, std::streamsize(n));
-                             },
-                             diagnostic_logger);
+        auto cmd       = get_macro_command(c, full_path.c_str(), overlay);
+        auto exit_code = detail::run_process(cmd,
+                                             [&](const char* str, std::size_t n) {
+                                                 stream.write(str, std::streamsize(n));
+                                             },
+                                             diagnostic_logger);
 
-        if (auto include_guard = get_include_guard_macro(full_path))
+        if (auto include_guard = get_include_guard_macro(c, full_path))
             // undefine include guard
             stream << "#undef " << include_guard.value();
 
-        auto exit_code = process.get_exit_status();
         DEBUG_ASSERT(diagnostic.empty(), detail::assert_handler{});
         if (exit_code != 0)
+        {
+            stream.close();
+            std::remove(file.c_str());
             throw libclang_error("preprocessor (macro): command '" + cmd
                                  + "' exited with non-zero exit code (" + std::to_string(exit_code)
                                  + ")");
+        }
         return file;
     }
 
@@ -400,10 +546,21 @@ namespace
         std::vector<std::string> included_files; // needed for pre-clang 4.0.0
     };
 
+    void append_preprocessed(std::string& result, const char* str, std::size_t n)
+    {
+        result.reserve(result.size() + n);
+        for (auto ptr = str; ptr != str + n; ++ptr)
+            if (*ptr == '\t')
+                result += "  "; // convert to two spaces
+            else if (*ptr != '\r')
+                result += *ptr;
+    }
+
     clang_preprocess_result clang_preprocess_impl(const libclang_compile_config& c,
                                                   const diagnostic_logger&       logger,
                                                   const std::string&             full_path,
-                                                  const char*                    macro_path)
+                                                  const char*                    macro_path,
+                                                  const overlay_files&           overlay)
     {
         clang_preprocess_result result;
 
@@ -437,19 +594,12 @@ namespace
                     diagnostic.push_back(*str);
         };
 
-        auto         cmd = get_preprocess_command(c, full_path.c_str(), macro_path);
-        tpl::Process process(cmd, "",
-                             [&](const char* str, std::size_t n) {
-                                 result.file.reserve(result.file.size() + n);
-                                 for (auto ptr = str; ptr != str + n; ++ptr)
-                                     if (*ptr == '\t')
-                                         result.file += "  "; // convert to two spaces
-                                     else if (*ptr != '\r')
-                                         result.file += *ptr;
-                             },
-                             diagnostic_handler);
-        // wait for process end
-        auto exit_code = process.get_exit_status();
+        auto output_handler = [&](const char* str, std::size_t n) {
+            append_preprocessed(result.file, str, n);
+        };
+
+        auto cmd       = get_preprocess_command(c, full_path.c_str(), macro_path, overlay);
+        auto exit_code = detail::run_process(cmd, output_handler, diagnostic_handler);
         DEBUG_ASSERT(diagnostic.empty(), detail::assert_handler{});
         if (exit_code != 0 && !expect_bad_exit_code)
             throw libclang_error("preprocessor: command '" + cmd
@@ -462,9 +612,10 @@ namespace
     clang_preprocess_result clang_preprocess(const libclang_compile_config& c,
                                              const char* full_path, const diagnostic_logger& logger)
     {
-        if (!std::ifstream(full_path))
+        if (!detail::find_unsaved_file(c, full_path) && !detail::read_file(full_path))
             throw libclang_error("preprocessor: file '" + std::string(full_path)
                                  + "' doesn't exist");
+        overlay_files overlay(c);
 
         // if we're fast preprocessing we only preprocess the main file, not includes
         // this is done by disabling all include search paths when doing the preprocessing
@@ -472,13 +623,15 @@ namespace
         // they are then manually defined before
         auto fast_preprocessing = detail::libclang_compile_config_access::fast_preprocessing(c);
 
-        auto macro_file = fast_preprocessing ? write_macro_file(c, full_path, logger) : "";
+        auto macro_file =
+            fast_preprocessing ? write_macro_file(c, full_path, overlay, logger) : "";
 
         clang_preprocess_result result;
         try
         {
             result = clang_preprocess_impl(c, logger, full_path,
-                                           fast_preprocessing ? macro_file.c_str() : nullptr);
+                                           fast_preprocessing ? macro_file.c_str() : nullptr,
+                                           overlay);
         }
         catch (...)
         {
@@ -499,6 +652,33 @@ namespace
         return result;
     }
 
+    clang_preprocess_result read_preprocessed(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw libclang_error("preprocessor: preprocessed file '" + path + "' doesn't exist");
+
+        clang_preprocess_result result;
+        char                    buffer[4096];
+        while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+            append_preprocessed(result.file, buffer, std::size_t(file.gcount()));
+        return result;
+    }
+
+    // returns the name of the main file used in the linemarkers,
+    // which is the name it was preprocessed with
+    std::string get_main_file_name(const std::string& path, const std::string& preprocessed)
+    {
+        // format (first line): # 1 "<filename>"
+        auto begin = preprocessed.find('"');
+        auto end   = begin == std::string::npos ? begin : preprocessed.find('"', begin + 1u);
+        if (preprocessed.compare(0, 4u, "# 1 ") != 0 || end == std::string::npos
+            || end > preprocessed.find('\n'))
+            throw libclang_error("preprocessor: preprocessed file '" + path
+                                 + "' doesn't start with a linemarker");
+        return preprocessed.substr(begin + 1u, end - begin - 1u);
+    }
+
     //==== parsing ===//
     class position
     {
@@ -657,80 +837,34 @@ namespace
                 p.skip();
     }
 
-    detail::pp_doc_comment parse_c_doc_comment(position& p)
+    // appends the raw text of a comment to the buffer
+    detail::raw_doc_comment make_raw_comment(const detail::preprocessor_output& output,
+                                             detail::raw_doc_comment::kind_t kind, unsigned column,
+                                             const char* begin, const char* end)
     {
-        detail::pp_doc_comment result;
-        result.kind = detail::pp_doc_comment::c;
-
-        auto indent = p.cur_column() + 3;
-
-        if (starts_with(p, " "))
-        {
-            // skip one whitespace at most
-            p.skip();
-            ++indent;
-        }
+        auto offset = output.comment_buffer->size();
+        output.comment_buffer->append(begin, end);
+        return detail::raw_doc_comment{output.comment_buffer, std::uint32_t(offset),
+                                       std::uint32_t(end - begin), column, kind};
+    }
 
+    // only records where the comment is, it is normalized by cpp_entity::comment()
+    detail::pp_doc_comment parse_c_doc_comment(position& p,
+                                               const detail::preprocessor_output& output)
+    {
+        auto column = p.cur_column();
+        auto begin  = p.ptr();
         while (!starts_with(p, "*/"))
-        {
             if (starts_with(p, "\n"))
-            {
-                // remove trailing spaces
-                while (!result.comment.empty() && result.comment.back() == ' ')
-                    result.comment.pop_back();
-
-                // skip newline(s)
-                while (starts_with(p, "\n"))
-                {
-                    p.skip_with_linecount();
-                    result.comment += '\n';
-                }
-
-                // skip indentation
-                auto actual_indent = 0u;
-                for (auto i = 0u; i < indent && starts_with(p, " "); ++i)
-                {
-                    ++actual_indent;
-                    p.skip();
-                }
-
-                auto extra_indent = 0u;
-                while (starts_with(p, " "))
-                {
-                    ++extra_indent;
-                    p.skip();
-                }
-
-                // skip continuation star, if any
-                if (starts_with(p, "*") && !starts_with(p, "*/"))
-                {
-                    p.skip();
-                    if (starts_with(p, " "))
-                        // skip one whitespace at most
-                        p.skip();
-                }
-                else
-                {
-                    // insert extra indent again
-                    result.comment += std::string(extra_indent, ' ');
-                    // use minimum indent in the future
-                    indent = std::min(actual_indent, indent);
-                }
-            }
+                p.skip_with_linecount();
             else
-            {
-                result.comment += *p.ptr();
                 p.skip();
-            }
-        }
-        p.skip(2u);
 
-        // remove trailing star
-        if (!result.comment.empty() && result.comment.back() == '*')
-            result.comment.pop_back();
-        // remove trailing spaces
-        while (!result.comment.empty() && result.comment.back() == ' ')
-            result.comment.pop_back();
+        detail::pp_doc_comment result;
+        result.comment =
+            make_raw_comment(output, detail::raw_doc_comment::c, column, begin, p.ptr());
+        result.kind = detail::pp_doc_comment::c;
+        p.skip(2u);
 
         result.line = p.cur_line();
         return result;
@@ -745,11 +879,12 @@ namespace
         if (starts_with(p, "*/"))
             // empty comment
             p.skip(2u);
-        else if (p.write_enabled() && (starts_with(p, "*") || starts_with(p, "!")))
+        else if (output.comment_buffer && p.write_enabled()
+                 && (starts_with(p, "*") || starts_with(p, "!")))
         {
             // doc comment
             p.skip();
-            output.comments.push_back(parse_c_doc_comment(p));
+            output.comments.push_back(parse_c_doc_comment(p, output));
         }
         else
         {
@@ -761,29 +896,6 @@ namespace
         return true;
     }
 
-    detail::pp_doc_comment parse_cpp_doc_comment(position& p, bool end_of_line)
-    {
-        detail::pp_doc_comment result;
-        result.kind =
-            end_of_line ? detail::pp_doc_comment::end_of_line : detail::pp_doc_comment::cpp;
-        if (starts_with(p, " "))
-            // skip one whitespace at most
-            p.skip();
-
-        while (!starts_with(p, "\n"))
-        {
-            result.comment += *p.ptr();
-            p.skip();
-        }
-        // don't skip newline
-
-        // remove trailing spaces
-        while (!result.comment.empty() && result.comment.back() == ' ')
-            result.comment.pop_back();
-        result.line = p.cur_line();
-        return result;
-    }
-
     bool can_merge_comment(const detail::pp_doc_comment& comment, unsigned cur_line)
     {
         return comment.line + 1 == cur_line
@@ -791,16 +903,42 @@ namespace
                    || comment.kind == detail::pp_doc_comment::end_of_line);
     }
 
-    void merge_or_add(detail::preprocessor_output& output, detail::pp_doc_comment comment)
+    // parses a C++ style doc comment, p is after the leading sequence
+    void parse_cpp_doc_comment(position& p, detail::preprocessor_output& output, bool end_of_line)
     {
-        if (output.comments.empty() || !can_merge_comment(output.comments.back(), comment.line))
-            output.comments.push_back(std::move(comment));
+        auto begin = p.ptr();
+        auto end   = std::strchr(begin, '\n');
+        p.skip(std::size_t(end - begin)); // don't skip newline
+
+        if (end_of_line || output.comments.empty()
+            || !can_merge_comment(output.comments.back(), p.cur_line()))
+        {
+            detail::pp_doc_comment result;
+            result.comment =
+                make_raw_comment(output, detail::raw_doc_comment::cpp, p.cur_column(), begin, end);
+            result.line = p.cur_line();
+            result.kind =
+                end_of_line ? detail::pp_doc_comment::end_of_line : detail::pp_doc_comment::cpp;
+            output.comments.push_back(std::move(result));
+        }
         else
         {
-            auto& result = output.comments.back();
-            result.comment += "\n" + std::move(comment.comment);
-            if (result.kind != detail::pp_doc_comment::end_of_line)
-                result.line = comment.line;
+            auto& result = output.comments.back().comment;
+            auto& buffer = *output.comment_buffer;
+            if (result.offset + result.length != buffer.size())
+            {
+                // not the last comment in the buffer, so copy it to the end first
+                auto copy     = buffer.substr(result.offset, result.length);
+                result.offset = std::uint32_t(buffer.size());
+                buffer += copy;
+            }
+
+            buffer += '\n';
+            buffer.append(begin, end);
+            result.length = std::uint32_t(buffer.size() - result.offset);
+
+            if (output.comments.back().kind != detail::pp_doc_comment::end_of_line)
+                output.comments.back().line = p.cur_line();
         }
     }
 
@@ -810,19 +948,18 @@ namespace
             return false;
         p.skip(2u);
 
-        if (p.write_enabled() && (starts_with(p, "/") || starts_with(p, "!")))
+        if (output.comment_buffer && p.write_enabled()
+            && (starts_with(p, "/") || starts_with(p, "!")))
         {
             // C++ style doc comment
             p.skip();
-            auto comment = parse_cpp_doc_comment(p, false);
-            merge_or_add(output, std::move(comment));
+            parse_cpp_doc_comment(p, output, false);
         }
-        else if (p.write_enabled() && starts_with(p, "<"))
+        else if (output.comment_buffer && p.write_enabled() && starts_with(p, "<"))
         {
             // end of line doc comment
             p.skip();
-            auto comment = parse_cpp_doc_comment(p, true);
-            output.comments.push_back(std::move(comment));
+            parse_cpp_doc_comment(p, output, true);
         }
         else
         {
@@ -910,7 +1047,7 @@ namespace
         // match comment directly
         if (!output.comments.empty() && output.comments.back().matches(*result, cur_line))
         {
-            result->set_comment(std::move(output.comments.back().comment));
+            result->set_comment(output.comments.back().comment);
             output.comments.pop_back();
         }
         return result;
@@ -1073,8 +1210,15 @@ detail::preprocessor_output detail::preprocess(const libclang_compile_config& co
 {
     detail::preprocessor_output                  result;
     std::unordered_map<std::string, std::string> indirect_includes;
+    if (detail::libclang_compile_config_access::parse_comments(config))
+        result.comment_buffer = std::make_shared<std::string>();
 
-    auto preprocessed = clang_preprocess(config, path, logger);
+    auto& input        = detail::libclang_compile_config_access::preprocessed_input(config);
+    auto  preprocessed = input.empty() ? clang_preprocess(config, path, logger) :
+                                        read_preprocessed(input);
+    // the linemarkers use the name the file was preprocessed with
+    auto main_file =
+        input.empty() ? std::string(path) : get_main_file_name(input, preprocessed.file);
 
     if (detail::libclang_compile_config_access::clang_version(config) < 40000)
     {
@@ -1160,10 +1304,25 @@ detail::preprocessor_output detail::preprocess(const libclang_compile_config& co
             {
                 if (p.write_enabled())
                 {
+                    if (!input.empty()
+                        && (result.includes.empty() || !result.includes.back().full_path.empty()))
+                    {
+                        // preprocessed without -dI, so the include directive is gone
+                        // recreate it from the linemarker, libclang needs it as well
+                        auto& full_path = lm.value().file;
+                        auto  file_name = full_path.compare(0, 2u, "./") == 0 ?
+                                             full_path.substr(2u) :
+                                             full_path;
+                        auto kind = lm.value().is_system ? cpp_include_kind::system :
+                                                           cpp_include_kind::local;
+                        result.includes.push_back(
+                            pp_include{std::move(file_name), full_path, kind, p.cur_line()});
+                        p.write_str("#include \"" + full_path + "\"\n");
+                    }
                     // this is a direct include, update the full path of the last include
                     // note: path can be empty if pre clang 4 and not fast preprocessing
                     // in this case we can't get the full path at all
-                    if (!result.includes.empty())
+                    else if (!result.includes.empty())
                     {
                         DEBUG_ASSERT(result.includes.back().full_path.empty()
                                          && lm.value().file.find(result.includes.back().file_name)
@@ -1188,7 +1347,7 @@ detail::preprocessor_output detail::preprocess(const libclang_compile_config& co
             }
             else if (lm.value().flag == linemarker::enter_old)
             {
-                if (lm.value().file == path)
+                if (lm.value().file == main_file)
                 {
                     p.enable_write();
                     p.set_line(lm.value().line);
@@ -1196,11 +1355,12 @@ detail::preprocessor_output detail::preprocess(const libclang_compile_config& co
             }
             else if (lm.value().flag == linemarker::line_directive && p.write_enabled())
             {
-                if (first_line.try_reset() && lm.value().file == path && lm.value().line == 1u)
+                if (first_line.try_reset() && lm.value().file == main_file
+                    && lm.value().line == 1u)
                 {
                     // this is the first line marker
                     // just skip all builtin macro stuff until we reach the file again
-                    auto closing_line_marker = std::string("# 1 \"") + path + "\" 2\n";
+                    auto closing_line_marker = "# 1 \"" + main_file + "\" 2\n";
 
                     auto ptr = std::strstr(p.ptr(), closing_line_marker.c_str());
                     DEBUG_ASSERT(ptr, detail::assert_handler{});
@@ -1254,3 +1414,22 @@ detail::preprocessor_output detail::preprocess(const libclang_compile_config& co
 
     return result;
 }
+
+const std::string* detail::find_unsaved_file(const libclang_compile_config& config,
+                                             const std::string&             path)
+{
+    auto& files = detail::libclang_compile_config_access::unsaved_files(config);
+    if (files.empty())
+        return nullptr;
+
+    auto iter = files.find(path);
+    if (iter != files.end())
+        return &iter->second;
+
+    // try again with the absolute path, the name might be spelled differently
+    auto absolute = get_absolute_path(path);
+    for (auto& file : files)
+        if (get_absolute_path(file.first) == absolute)
+            return &file.second;
+    return nullptr;
+}
@@ -27,8 +27,8 @@ namespace cppast
 
         struct pp_doc_comment
         {
-            std::string comment;
-            unsigned    line;
+            raw_doc_comment comment; // buffer is nullptr once it has been matched
+            unsigned        line;
             enum
             {
                 c,
@@ -41,14 +41,25 @@ namespace cppast
 
         struct preprocessor_output
         {
-            std::string                 source;
-            std::vector<pp_include>     includes;
-            std::vector<pp_macro>       macros;
-            std::vector<pp_doc_comment> comments;
+            std::string                  source;
+            std::vector<pp_include>      includes;
+            std::vector<pp_macro>        macros;
+            std::vector<pp_doc_comment>  comments;
+            // the raw text of the comments, nullptr if they are disabled
+            std::shared_ptr<std::string> comment_buffer;
         };
 
         preprocessor_output preprocess(const libclang_compile_config& config, const char* path,
                                        const diagnostic_logger& logger);
+
+        // returns the path of a new file in the temporary directory of the process,
+        // a directory only accessible to the current user that is removed on exit
+        std::string get_temporary_path(const char* prefix);
+
+        // returns the contents of the file, if it was added to the config as unsaved file,
+        // nullptr otherwise
+        const std::string* find_unsaved_file(const libclang_compile_config& config,
+                                             const std::string&             path);
     }
 } // namespace cppast::detail
 
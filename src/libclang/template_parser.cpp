@@ -175,8 +175,8 @@ namespace
                                  detail::assert_handler{});
                 }
 
-                builder.default_template(
-                    cpp_template_ref(detail::get_entity_id(target), std::move(spelling)));
+                builder.default_template(cpp_template_ref(detail::get_entity_id(context, target),
+                                                          std::move(spelling)));
             }
             else
                 DEBUG_ASSERT(clang_isReference(kind), detail::parse_error_handler{}, cur,
@@ -205,9 +205,8 @@ namespace
     void handle_comment_attributes(cpp_entity& templ_entity, cpp_entity& non_template)
     {
         // steal comment
-        auto comment = type_safe::copy(non_template.comment());
+        templ_entity.set_comment(non_template);
         non_template.set_comment(type_safe::nullopt);
-        templ_entity.set_comment(std::move(comment));
 
         // copy attributes over
         templ_entity.add_attribute(non_template.attributes());
@@ -333,7 +332,7 @@ std::unique_ptr<cpp_entity> detail::try_parse_cpp_function_template_specializati
 
     cpp_function_template_specialization::builder
         builder(std::unique_ptr<cpp_function_base>(static_cast<cpp_function_base*>(func.release())),
-                cpp_template_ref(detail::get_entity_id(templ), ""));
+                cpp_template_ref(detail::get_entity_id(context, templ), ""));
     parse_arguments(builder, context, cur);
     handle_comment_attributes(builder.get(), *func_ptr);
     return builder.finish(*context.idx, detail::get_entity_id(cur),
@@ -389,7 +388,7 @@ std::unique_ptr<cpp_entity> detail::parse_cpp_class_template_specialization(
 
     cpp_class_template_specialization::builder
         builder(std::unique_ptr<cpp_class>(static_cast<cpp_class*>(c.release())),
-                cpp_template_ref(detail::get_entity_id(primary), ""));
+                cpp_template_ref(detail::get_entity_id(context, primary), ""));
     handle_comment_attributes(builder.get(), *c_ptr);
     parse_parameters(builder, context, cur);
     parse_arguments(builder, context, cur);
@@ -97,19 +97,6 @@ namespace
         return clang_equalCursors(parent, decl_parent) != 0;
     }
 
-    std::string get_type_spelling(const CXCursor& cur, const CXType& type)
-    {
-        auto spelling = detail::cxstring(clang_getTypeSpelling(type)).std_str();
-        if (need_to_remove_scope(cur, type))
-        {
-            auto colon = spelling.rfind(':');
-            if (colon != std::string::npos)
-                spelling.erase(0, colon + 1u);
-        }
-
-        return spelling;
-    }
-
     // const/volatile at the end (because people do that apparently!)
     // also used on member function pointers
     cpp_cv suffix_cv(std::string& spelling)
@@ -205,26 +192,35 @@ namespace
         return cpp_cv_qualified_type::build(std::move(entity), cv);
     }
 
-    template <typename Builder>
-    std::unique_ptr<cpp_type> make_leave_type(const CXCursor& cur, const CXType& type, Builder b)
+    // cv qualifiers of the type itself, without looking at the spelling
+    cpp_cv get_cv(const CXType& type)
     {
-        auto spelling = get_type_spelling(cur, type);
-
-        // check for cv qualifiers on the leave type
-        auto prefix = prefix_cv(spelling);
-        auto suffix = suffix_cv(spelling);
-        auto cv     = merge_cv(prefix, suffix);
-
-        // remove struct/class/union prefix on inline type definition
-        // i.e. C's typedef struct idiom
-        remove_prefix(spelling, "struct", true);
-        remove_prefix(spelling, "class", true);
-        remove_prefix(spelling, "union", true);
+        auto is_const    = clang_isConstQualifiedType(type) != 0u;
+        auto is_volatile = clang_isVolatileQualifiedType(type) != 0u;
+        if (is_const && is_volatile)
+            return cpp_cv_const_volatile;
+        else if (is_const)
+            return cpp_cv_const;
+        else if (is_volatile)
+            return cpp_cv_volatile;
+        return cpp_cv_none;
+    }
 
-        auto entity = b(std::move(spelling));
+    template <typename Builder>
+    std::unique_ptr<cpp_type> make_leave_type(const detail::parse_context& context,
+                                              const CXCursor& cur, const CXType& type, Builder b)
+    {
+        auto& leave  = context.types.leave(cur, type);
+        auto  entity = b(std::string(leave.spelling));
         if (!entity)
             return nullptr;
-        return make_cv_qualified(std::move(entity), cv);
+        return make_cv_qualified(std::move(entity), leave.cv);
+    }
+
+    std::unique_ptr<cpp_type> make_builtin_type(const CXType& type, cpp_builtin_type_kind kind)
+    {
+        // builtin types don't need the spelling
+        return make_cv_qualified(cpp_builtin_type::build(kind), get_cv(type));
     }
 
     cpp_reference get_reference_kind(const CXType& type)
@@ -239,14 +235,17 @@ namespace
     std::unique_ptr<cpp_type> parse_type_impl(const detail::parse_context& context,
                                               const CXCursor& cur, const CXType& type);
 
-    std::unique_ptr<cpp_expression> parse_array_size(const CXCursor& cur, const CXType& type)
+    std::unique_ptr<cpp_expression> parse_array_size(const detail::parse_context& context,
+                                                     const CXCursor& cur, const CXType& type)
     {
         auto size = clang_getArraySize(type);
         if (size != -1)
             return cpp_literal_expression::build(cpp_builtin_type::build(cpp_ulonglong),
-                                                 std::to_string(size));
+                                                 std::to_string(size),
+                                                 cpp_integral_value::make_unsigned(
+                                                     static_cast<unsigned long long>(size)));
 
-        auto spelling = get_type_spelling(cur, type);
+        auto& spelling = context.types.spelling(cur, type);
         DEBUG_ASSERT(spelling.size() > 2u && spelling.back() == ']', detail::parse_error_handler{},
                      type, "unexpected token");
 
@@ -289,7 +288,7 @@ namespace
             // only downside of this workaround: we've stripped away typedefs
         }
 
-        auto size = parse_array_size(cur, canonical); // type may not work, see above
+        auto size = parse_array_size(context, cur, canonical); // type may not work, see above
         return cpp_array_type::build(parse_type_impl(context, cur, value_type), std::move(size));
     }
 
@@ -340,7 +339,7 @@ namespace
     std::unique_ptr<cpp_type> parse_member_pointee_type(const detail::parse_context& context,
                                                         const CXCursor& cur, const CXType& type)
     {
-        auto spelling = get_type_spelling(cur, type);
+        auto spelling = context.types.spelling(cur, type);
         auto ref      = member_function_ref_qualifier(spelling);
         auto cv       = suffix_cv(spelling);
 
@@ -403,14 +402,15 @@ namespace
 
         // doesn't respect cv qualifiers properly
         auto result =
-            make_leave_type(cur, type,
+            make_leave_type(context, cur, type,
                             [&](std::string&& type_spelling) -> std::unique_ptr<cpp_type> {
                                 // look at the template parameters,
                                 // see if we find a matching one
                                 auto param = clang_getNullCursor();
                                 detail::visit_children(templ, [&](const CXCursor& child) {
                                     if (clang_getCursorKind(child) == CXCursor_TemplateTypeParameter
-                                        && get_type_spelling(child, clang_getCursorType(child))
+                                        && context.types.spelling(child,
+                                                                  clang_getCursorType(child))
                                                == type_spelling)
                                     {
                                         // found one
@@ -426,7 +426,7 @@ namespace
                                     // found matching parameter
                                     return cpp_template_parameter_type::build(
                                         cpp_template_type_parameter_ref(detail::get_entity_id(
-                                                                            param),
+                                                                            context, param),
                                                                         std::move(type_spelling)));
                             });
 
@@ -470,57 +470,59 @@ namespace
         }
     }
 
-    std::unique_ptr<cpp_type> try_parse_instantiation_type(const detail::parse_context&,
+    std::unique_ptr<cpp_type> try_parse_instantiation_type(const detail::parse_context& context,
                                                            const CXCursor& cur, const CXType& type)
     {
-        return make_leave_type(cur, type, [&](std::string&& spelling) -> std::unique_ptr<cpp_type> {
-            auto ptr = spelling.c_str();
-
-            std::string templ_name;
-            for (; *ptr && *ptr != '<'; ++ptr)
-                templ_name += *ptr;
-            if (*ptr != '<')
-                return nullptr;
-            ++ptr;
-
-            auto templ = get_instantiation_template(cur, type, templ_name);
-            if (clang_Cursor_isNull(templ))
-                return nullptr;
-
-            cpp_template_instantiation_type::builder builder(
-                cpp_template_ref(detail::get_entity_id(templ), std::move(templ_name)));
-
-            // parse arguments
-            // i.e. not parse really, just add the string
-            if (spelling.empty() || spelling.back() != '>')
-                return nullptr;
-            spelling.pop_back();
-            while (!spelling.empty() && spelling.back() == ' ')
+        return make_leave_type(
+            context, cur, type, [&](std::string&& spelling) -> std::unique_ptr<cpp_type> {
+                auto ptr = spelling.c_str();
+
+                std::string templ_name;
+                for (; *ptr && *ptr != '<'; ++ptr)
+                    templ_name += *ptr;
+                if (*ptr != '<')
+                    return nullptr;
+                ++ptr;
+
+                auto templ = get_instantiation_template(cur, type, templ_name);
+                if (clang_Cursor_isNull(templ))
+                    return nullptr;
+
+                cpp_template_instantiation_type::builder builder(
+                    cpp_template_ref(detail::get_entity_id(context, templ), std::move(templ_name)));
+
+                // parse arguments
+                // i.e. not parse really, just add the string
+                if (spelling.empty() || spelling.back() != '>')
+                    return nullptr;
                 spelling.pop_back();
-            builder.add_unexposed_arguments(ptr);
+                while (!spelling.empty() && spelling.back() == ' ')
+                    spelling.pop_back();
+                builder.add_unexposed_arguments(ptr);
 
-            return builder.finish();
-        });
+                return builder.finish();
+            });
     }
 
-    std::unique_ptr<cpp_type> try_parse_decltype_type(const detail::parse_context&,
+    std::unique_ptr<cpp_type> try_parse_decltype_type(const detail::parse_context& context,
                                                       const CXCursor& cur, const CXType& type)
     {
         if (clang_isExpression(clang_getCursorKind(cur)))
             return nullptr; // don't use decltype here
 
-        return make_leave_type(cur, type, [&](std::string&& spelling) -> std::unique_ptr<cpp_type> {
-            if (!remove_prefix(spelling, "decltype(", false))
-                return nullptr;
-            remove_suffix(spelling, "...", false); // variadic decltype. fun
-            DEBUG_ASSERT(!spelling.empty() && spelling.back() == ')', detail::parse_error_handler{},
-                         type, "unexpected spelling");
-            spelling.pop_back();
+        return make_leave_type(
+            context, cur, type, [&](std::string&& spelling) -> std::unique_ptr<cpp_type> {
+                if (!remove_prefix(spelling, "decltype(", false))
+                    return nullptr;
+                remove_suffix(spelling, "...", false); // variadic decltype. fun
+                DEBUG_ASSERT(!spelling.empty() && spelling.back() == ')',
+                             detail::parse_error_handler{}, type, "unexpected spelling");
+                spelling.pop_back();
 
-            return cpp_decltype_type::build(
-                cpp_unexposed_expression::build(cpp_unexposed_type::build("<decltype>"),
-                                                cpp_token_string::tokenize(spelling)));
-        });
+                return cpp_decltype_type::build(
+                    cpp_unexposed_expression::build(cpp_unexposed_type::build("<decltype>"),
+                                                    cpp_token_string::tokenize(spelling)));
+            });
     }
 
     std::unique_ptr<cpp_type> parse_type_impl(const detail::parse_context& context,
@@ -612,95 +614,55 @@ namespace
                 return ptype;
         // fallthrough
         case CXType_Complex:
-            return cpp_unexposed_type::build(get_type_spelling(cur, type).c_str());
+            return cpp_unexposed_type::build(context.types.spelling(cur, type).c_str());
 
         case CXType_Void:
-            return make_leave_type(cur, type,
-                                   [](std::string&&) { return cpp_builtin_type::build(cpp_void); });
+            return make_builtin_type(type, cpp_void);
         case CXType_Bool:
-            return make_leave_type(cur, type,
-                                   [](std::string&&) { return cpp_builtin_type::build(cpp_bool); });
+            return make_builtin_type(type, cpp_bool);
         case CXType_UChar:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_uchar);
-            });
+            return make_builtin_type(type, cpp_uchar);
         case CXType_UShort:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_ushort);
-            });
+            return make_builtin_type(type, cpp_ushort);
         case CXType_UInt:
-            return make_leave_type(cur, type,
-                                   [](std::string&&) { return cpp_builtin_type::build(cpp_uint); });
+            return make_builtin_type(type, cpp_uint);
         case CXType_ULong:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_ulong);
-            });
+            return make_builtin_type(type, cpp_ulong);
         case CXType_ULongLong:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_ulonglong);
-            });
+            return make_builtin_type(type, cpp_ulonglong);
         case CXType_UInt128:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_uint128);
-            });
+            return make_builtin_type(type, cpp_uint128);
         case CXType_SChar:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_schar);
-            });
+            return make_builtin_type(type, cpp_schar);
         case CXType_Short:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_short);
-            });
+            return make_builtin_type(type, cpp_short);
         case CXType_Int:
-            return make_leave_type(cur, type,
-                                   [](std::string&&) { return cpp_builtin_type::build(cpp_int); });
+            return make_builtin_type(type, cpp_int);
         case CXType_Long:
-            return make_leave_type(cur, type,
-                                   [](std::string&&) { return cpp_builtin_type::build(cpp_long); });
+            return make_builtin_type(type, cpp_long);
         case CXType_LongLong:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_longlong);
-            });
+            return make_builtin_type(type, cpp_longlong);
         case CXType_Int128:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_int128);
-            });
+            return make_builtin_type(type, cpp_int128);
         case CXType_Float:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_float);
-            });
+            return make_builtin_type(type, cpp_float);
         case CXType_Double:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_double);
-            });
+            return make_builtin_type(type, cpp_double);
         case CXType_LongDouble:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_longdouble);
-            });
+            return make_builtin_type(type, cpp_longdouble);
         case CXType_Float128:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_float128);
-            });
+            return make_builtin_type(type, cpp_float128);
         case CXType_Char_U:
         case CXType_Char_S:
-            return make_leave_type(cur, type,
-                                   [](std::string&&) { return cpp_builtin_type::build(cpp_char); });
+            return make_builtin_type(type, cpp_char);
         case CXType_Char16:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_char16);
-            });
+            return make_builtin_type(type, cpp_char16);
         case CXType_Char32:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_char32);
-            });
+            return make_builtin_type(type, cpp_char32);
         case CXType_WChar:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_wchar);
-            });
+            return make_builtin_type(type, cpp_wchar);
         case CXType_NullPtr:
-            return make_leave_type(cur, type, [](std::string&&) {
-                return cpp_builtin_type::build(cpp_nullptr);
-            });
+            return make_builtin_type(type, cpp_nullptr);
 
         case CXType_Elaborated:
             if (auto itype = try_parse_instantiation_type(context, cur, type))
@@ -710,22 +672,19 @@ namespace
         case CXType_Record:
         case CXType_Enum:
         case CXType_Typedef:
-            return make_leave_type(cur, type, [&](std::string&& spelling) {
+            return make_leave_type(context, cur, type, [&](std::string&& spelling) {
                 auto decl = clang_getTypeDeclaration(type);
                 if (remove_prefix(spelling, "(anonymous", false))
                     spelling = ""; // anonymous type
                 return cpp_user_defined_type::build(
-                    cpp_type_ref(detail::get_entity_id(decl), std::move(spelling)));
+                    cpp_type_ref(detail::get_entity_id(context, decl), std::move(spelling)));
             });
 
         case CXType_Pointer:
         {
             auto pointee = parse_type_impl(context, cur, clang_getPointeeType(type));
             auto pointer = cpp_pointer_type::build(std::move(pointee));
-
-            auto spelling = get_type_spelling(cur, type);
-            auto cv       = suffix_cv(spelling);
-            return make_cv_qualified(std::move(pointer), cv);
+            return make_cv_qualified(std::move(pointer), get_cv(type));
         }
         case CXType_LValueReference:
         case CXType_RValueReference:
@@ -748,8 +707,7 @@ namespace
             return cpp_pointer_type::build(parse_member_pointee_type(context, cur, type));
 
         case CXType_Auto:
-            return make_leave_type(cur, type,
-                                   [&](std::string&&) { return cpp_auto_type::build(); });
+            return make_cv_qualified(cpp_auto_type::build(), get_cv(type));
         }
 
         DEBUG_UNREACHABLE(detail::assert_handler{});
@@ -757,6 +715,58 @@ namespace
     }
 }
 
+detail::type_cache::entry& detail::type_cache::get_entry(const CXCursor& cur,
+                                                         const CXType&   type) const
+{
+    auto remove_scope = need_to_remove_scope(cur, type);
+    auto iter         = entries_.find(key{type, remove_scope});
+    if (iter == entries_.end())
+    {
+        auto spelling = cxstring(clang_getTypeSpelling(type)).std_str();
+        if (remove_scope)
+        {
+            auto colon = spelling.rfind(':');
+            if (colon != std::string::npos)
+                spelling.erase(0, colon + 1u);
+        }
+
+        iter = entries_
+                   .emplace(key{type, remove_scope},
+                            entry{std::move(spelling), type_safe::nullopt})
+                   .first;
+    }
+    return iter->second;
+}
+
+const std::string& detail::type_cache::spelling(const CXCursor& cur, const CXType& type) const
+{
+    return get_entry(cur, type).spelling;
+}
+
+const detail::type_cache::leave_spelling& detail::type_cache::leave(const CXCursor& cur,
+                                                                    const CXType&   type) const
+{
+    auto& entry = get_entry(cur, type);
+    if (!entry.leave)
+    {
+        auto spelling = entry.spelling;
+
+        // check for cv qualifiers on the leave type
+        auto prefix = prefix_cv(spelling);
+        auto suffix = suffix_cv(spelling);
+        auto cv     = merge_cv(prefix, suffix);
+
+        // remove struct/class/union prefix on inline type definition
+        // i.e. C's typedef struct idiom
+        remove_prefix(spelling, "struct", true);
+        remove_prefix(spelling, "class", true);
+        remove_prefix(spelling, "union", true);
+
+        entry.leave = leave_spelling{std::move(spelling), cv};
+    }
+    return entry.leave.value();
+}
+
 std::unique_ptr<cpp_type> detail::parse_type(const detail::parse_context& context,
                                              const CXCursor& cur, const CXType& type)
 {
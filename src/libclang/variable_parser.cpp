@@ -42,11 +42,18 @@ std::unique_ptr<cpp_expression> detail::parse_default_value(cpp_attribute_list&
             attributes.insert(attributes.end(), cur_attributes.begin(), cur_attributes.end());
         }
     }
-    if (has_default)
-        return parse_raw_expression(context, stream, stream.end(),
-                                    parse_type(context, cur, clang_getCursorType(cur)));
-    else
+    if (!has_default)
         return nullptr;
+
+    // the default value is the last expression, if it is exposed at all
+    type_safe::optional<cpp_integral_value> evaluated;
+    detail::visit_children(cur, [&](const CXCursor& child) {
+        if (clang_isExpression(clang_getCursorKind(child)))
+            evaluated = evaluate_integral(child);
+    });
+    return parse_raw_expression(context, stream, stream.end(),
+                                parse_type(context, cur, clang_getCursorType(cur)),
+                                std::move(evaluated));
 }
 
 std::unique_ptr<cpp_entity> detail::parse_cpp_variable(const detail::parse_context& context,
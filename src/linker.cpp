@@ -0,0 +1,237 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cppast/linker.hpp>
+
+#include <cppast/cpp_array_type.hpp>
+#include <cppast/cpp_class.hpp>
+#include <cppast/cpp_enum.hpp>
+#include <cppast/cpp_file.hpp>
+#include <cppast/cpp_forward_declarable.hpp>
+#include <cppast/cpp_friend.hpp>
+#include <cppast/cpp_function.hpp>
+#include <cppast/cpp_function_type.hpp>
+#include <cppast/cpp_member_function.hpp>
+#include <cppast/cpp_member_variable.hpp>
+#include <cppast/cpp_namespace.hpp>
+#include <cppast/cpp_template.hpp>
+#include <cppast/cpp_template_parameter.hpp>
+#include <cppast/cpp_type_alias.hpp>
+#include <cppast/cpp_variable.hpp>
+#include <cppast/visitor.hpp>
+
+using namespace cppast;
+
+namespace
+{
+    struct linker
+    {
+        const cpp_entity_index&            idx;
+        std::vector<unresolved_reference>& unresolved;
+
+        template <typename T, typename Predicate>
+        void link_ref(const cpp_entity& e, const basic_cpp_entity_ref<T, Predicate>& ref)
+        {
+            if (!ref.link(idx))
+                unresolved.emplace_back(type_safe::ref(e), ref.name());
+        }
+
+        void link_type(const cpp_entity& e, const cpp_type& type)
+        {
+            switch (type.kind())
+            {
+            case cpp_type_kind::user_defined_t:
+                link_ref(e, static_cast<const cpp_user_defined_type&>(type).entity());
+                break;
+            case cpp_type_kind::cv_qualified_t:
+                link_type(e, static_cast<const cpp_cv_qualified_type&>(type).type());
+                break;
+            case cpp_type_kind::pointer_t:
+                link_type(e, static_cast<const cpp_pointer_type&>(type).pointee());
+                break;
+            case cpp_type_kind::reference_t:
+                link_type(e, static_cast<const cpp_reference_type&>(type).referee());
+                break;
+            case cpp_type_kind::array_t:
+                link_type(e, static_cast<const cpp_array_type&>(type).value_type());
+                break;
+
+            case cpp_type_kind::function_t:
+            {
+                auto& func = static_cast<const cpp_function_type&>(type);
+                link_type(e, func.return_type());
+                for (auto& param : func.parameter_types())
+                    link_type(e, param);
+                break;
+            }
+            case cpp_type_kind::member_function_t:
+            {
+                auto& func = static_cast<const cpp_member_function_type&>(type);
+                link_type(e, func.class_type());
+                link_type(e, func.return_type());
+                for (auto& param : func.parameter_types())
+                    link_type(e, param);
+                break;
+            }
+            case cpp_type_kind::member_object_t:
+            {
+                auto& obj = static_cast<const cpp_member_object_type&>(type);
+                link_type(e, obj.class_type());
+                link_type(e, obj.object_type());
+                break;
+            }
+
+            case cpp_type_kind::template_parameter_t:
+                link_ref(e, static_cast<const cpp_template_parameter_type&>(type).entity());
+                break;
+            case cpp_type_kind::template_instantiation_t:
+            {
+                auto& inst = static_cast<const cpp_template_instantiation_type&>(type);
+                link_ref(e, inst.primary_template());
+                if (inst.arguments_exposed() && inst.arguments())
+                    for (auto& arg : inst.arguments().value())
+                    {
+                        if (arg.type())
+                            link_type(e, arg.type().value());
+                        else if (arg.template_ref())
+                            link_ref(e, arg.template_ref().value());
+                    }
+                break;
+            }
+            case cpp_type_kind::dependent_t:
+                link_type(e, static_cast<const cpp_dependent_type&>(type).dependee());
+                break;
+
+            case cpp_type_kind::builtin_t:
+            case cpp_type_kind::auto_t:
+            case cpp_type_kind::decltype_t:
+            case cpp_type_kind::decltype_auto_t:
+            case cpp_type_kind::unexposed_t:
+                break;
+            }
+        }
+
+        template <typename T>
+        void link_function(const cpp_entity& e)
+        {
+            auto& func = static_cast<const T&>(e);
+            link_type(e, func.return_type());
+        }
+
+        void link_parameters(const cpp_entity& e)
+        {
+            auto& func = static_cast<const cpp_function_base&>(e);
+            for (auto& param : func.parameters())
+                link_type(param, param.type());
+        }
+
+        void link_template_parameters(const cpp_template_parameter& param)
+        {
+            switch (param.kind())
+            {
+            case cpp_entity_kind::template_type_parameter_t:
+            {
+                auto& type_param = static_cast<const cpp_template_type_parameter&>(param);
+                if (type_param.default_type())
+                    link_type(param, type_param.default_type().value());
+                break;
+            }
+            case cpp_entity_kind::non_type_template_parameter_t:
+                link_type(param, static_cast<const cpp_non_type_template_parameter&>(param).type());
+                break;
+            case cpp_entity_kind::template_template_parameter_t:
+                for (auto& nested :
+                     static_cast<const cpp_template_template_parameter&>(param).parameters())
+                    link_template_parameters(nested);
+                break;
+            default:
+                break;
+            }
+        }
+
+        void link_entity(const cpp_entity& e)
+        {
+            auto declarable = get_forward_declarable(e);
+            if (declarable && declarable.value().semantic_parent())
+                link_ref(e, declarable.value().semantic_parent().value());
+
+            if (is_template(e.kind()))
+                for (auto& param : static_cast<const cpp_template&>(e).parameters())
+                    link_template_parameters(param);
+
+            switch (e.kind())
+            {
+            case cpp_entity_kind::namespace_alias_t:
+                link_ref(e, static_cast<const cpp_namespace_alias&>(e).target());
+                break;
+            case cpp_entity_kind::using_directive_t:
+                link_ref(e, static_cast<const cpp_using_directive&>(e).target());
+                break;
+            case cpp_entity_kind::using_declaration_t:
+                link_ref(e, static_cast<const cpp_using_declaration&>(e).target());
+                break;
+
+            case cpp_entity_kind::type_alias_t:
+                link_type(e, static_cast<const cpp_type_alias&>(e).underlying_type());
+                break;
+            case cpp_entity_kind::enum_t:
+                link_type(e, static_cast<const cpp_enum&>(e).underlying_type());
+                break;
+            case cpp_entity_kind::class_t:
+                for (auto& base : static_cast<const cpp_class&>(e).bases())
+                    link_type(base, base.type());
+                break;
+
+            case cpp_entity_kind::variable_t:
+                link_type(e, static_cast<const cpp_variable&>(e).type());
+                break;
+            case cpp_entity_kind::member_variable_t:
+            case cpp_entity_kind::bitfield_t:
+                link_type(e, static_cast<const cpp_member_variable_base&>(e).type());
+                break;
+
+            case cpp_entity_kind::function_t:
+                link_function<cpp_function>(e);
+                link_parameters(e);
+                break;
+            case cpp_entity_kind::member_function_t:
+            case cpp_entity_kind::conversion_op_t:
+                link_function<cpp_member_function_base>(e);
+                link_parameters(e);
+                break;
+            case cpp_entity_kind::constructor_t:
+                link_parameters(e);
+                break;
+
+            case cpp_entity_kind::friend_t:
+            {
+                auto& f = static_cast<const cpp_friend&>(e);
+                if (f.type())
+                    link_type(e, f.type().value());
+                if (f.entity())
+                    link_all(f.entity().value());
+                break;
+            }
+
+            default:
+                break;
+            }
+        }
+
+        void link_all(const cpp_entity& e)
+        {
+            visit(e, [&](const cpp_entity& cur, const visitor_info& info) {
+                if (info.is_new_entity())
+                    link_entity(cur);
+            });
+        }
+    };
+} // namespace
+
+std::vector<unresolved_reference> cppast::link(const cpp_entity_index& idx, const cpp_file& file)
+{
+    std::vector<unresolved_reference> unresolved;
+    linker{idx, unresolved}.link_all(file);
+    return unresolved;
+}
@@ -30,6 +30,10 @@ class b final {};
 /// };
 union c {};
 
+// redeclaration
+/// struct a;
+struct a;
+
 // members
 /// struct d{
 ///   enum m1{
@@ -107,6 +111,8 @@ struct g
             auto definition = get_definition(idx, c);
             REQUIRE(definition);
             REQUIRE(definition.value().name() == c.name());
+            if (c.is_declaration())
+                REQUIRE(&c.definition_entity(idx).value() == &definition.value());
         }
         else if (c.name() == "b")
         {
@@ -299,5 +305,119 @@ struct g
         else
             REQUIRE(false);
     });
-    REQUIRE(count == 12u);
+    REQUIRE(count == 13u);
+}
+
+TEST_CASE("get_definition of a declaration from another index")
+{
+    cpp_entity_index idx;
+    auto definition = cpp_class::builder("a", cpp_class_kind::struct_t)
+                          .finish(idx, cpp_entity_id("a"), type_safe::nullopt);
+
+    cpp_entity_index other_idx;
+    auto             declaration = cpp_class::builder("a", cpp_class_kind::struct_t)
+                           .finish_declaration(other_idx, cpp_entity_id("a"));
+    REQUIRE(!declaration->definition_entity(idx));
+    REQUIRE(!declaration->definition_entity(other_idx));
+
+    auto result = get_definition(idx, *declaration);
+    REQUIRE(result);
+    REQUIRE(&result.value() == definition.get());
+    REQUIRE(!get_definition(other_idx, *declaration));
+
+    // the definition is only stored for the index that has it
+    idx.register_forward_declaration(cpp_entity_id("a"), type_safe::ref(*declaration));
+    REQUIRE(&declaration->definition_entity(idx).value() == definition.get());
+    REQUIRE(!declaration->definition_entity(other_idx));
+    REQUIRE(!get_definition(other_idx, *declaration));
+
+    idx.clear();
+    REQUIRE(!declaration->definition_entity(idx));
+    REQUIRE(!get_definition(idx, *declaration));
+}
+
+TEST_CASE("cpp_class head")
+{
+    // only the tokens up to the first member are used to parse the class itself
+    auto code = R"(
+template <typename T, int I>
+struct base {};
+
+struct a final : base<int, (1 > 0)>
+{
+    int member_a;
+};
+
+#define MEMBER int member_b;
+
+struct b
+{
+    MEMBER
+    int other_b;
+};
+
+struct c
+{
+    friend struct d;
+    int member_c;
+};
+
+struct e final : base<e, 2>
+{
+    friend void f() {}
+    void member_e() {}
+};
+)";
+
+    cpp_entity_index idx;
+    auto             file  = parse(idx, "cpp_class_head.cpp", code);
+    auto             count = test_visit<cpp_class>(*file, [&](const cpp_class& c) {
+        std::vector<std::string> members;
+        for (auto& member : c)
+            members.push_back(member.kind() == cpp_entity_kind::friend_t ? "friend" :
+                                                                           member.name());
+        auto no_bases = 0u;
+        for (auto& base : c.bases())
+        {
+            ++no_bases;
+            REQUIRE(base.name().compare(0u, 5u, "base<") == 0);
+        }
+
+        REQUIRE(c.is_definition());
+        REQUIRE(c.class_kind() == cpp_class_kind::struct_t);
+        if (c.name() == "base")
+        {
+            REQUIRE(members.empty());
+            REQUIRE(no_bases == 0u);
+        }
+        else if (c.name() == "a")
+        {
+            REQUIRE(c.is_final());
+            REQUIRE(no_bases == 1u);
+            REQUIRE(members == std::vector<std::string>{"member_a"});
+        }
+        else if (c.name() == "b")
+        {
+            // the first member comes from a macro
+            REQUIRE(!c.is_final());
+            REQUIRE(members == (std::vector<std::string>{"member_b", "other_b"}));
+        }
+        else if (c.name() == "c")
+        {
+            REQUIRE(!c.is_final());
+            REQUIRE(members == (std::vector<std::string>{"friend", "member_c"}));
+        }
+        else if (c.name() == "e")
+        {
+            REQUIRE(c.is_final());
+            REQUIRE(no_bases == 1u);
+            REQUIRE(members == (std::vector<std::string>{"friend", "member_e"}));
+        }
+        else
+            REQUIRE(false);
+
+        return false; // don't have a comment
+    });
+    // the friend declaration d isn't visited
+    REQUIRE(count == 5u);
 }
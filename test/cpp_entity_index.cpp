@@ -0,0 +1,514 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cppast/cpp_entity_index.hpp>
+#include <cppast/cpp_entity_index_snapshot.hpp>
+#include <cppast/cpp_forward_declarable.hpp>
+#include <cppast/cpp_friend.hpp>
+#include <cppast/cpp_namespace.hpp>
+#include <cppast/cpp_template.hpp>
+#include <cppast/lazy_entity_index.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "test_parser.hpp"
+
+using namespace cppast;
+
+namespace
+{
+    std::vector<std::string> lookup_names(const cpp_entity_index&                   idx,
+                                          type_safe::array_ref<const cpp_entity_id> ids)
+    {
+        std::vector<std::string> result;
+        for (auto& id : ids)
+        {
+            auto entity = idx.lookup(id);
+            if (entity)
+                result.push_back(entity.value().name());
+            else
+            {
+                auto ns = idx.lookup_namespace(id);
+                REQUIRE(ns.size() != 0u);
+                result.push_back(ns.begin()->get().name());
+            }
+        }
+        return result;
+    }
+
+    // visits friended entities and template parameters as well
+    template <typename Func>
+    void visit_all(const cpp_file& file, Func f)
+    {
+        visit(file, [&](const cpp_entity& e, visitor_info info) {
+            if (info.event == visitor_info::container_entity_exit)
+                return true;
+
+            f(e);
+            if (e.kind() == cpp_entity_kind::friend_t)
+                type_safe::with(static_cast<const cpp_friend&>(e).entity(),
+                                [&](const cpp_entity& friended) { f(friended); });
+            else if (is_template(e.kind()))
+                for (auto& param : static_cast<const cpp_template&>(e).parameters())
+                    f(param);
+            return true;
+        });
+    }
+} // namespace
+
+TEST_CASE("cpp_entity_index name lookup")
+{
+    auto code = R"(
+namespace ns
+{
+    struct Widget
+    {
+        void resize(int);
+        void resize(int, int);
+
+        int width;
+
+        struct Nested
+        {
+            int width;
+        };
+    };
+
+    namespace
+    {
+        void hidden();
+    }
+
+    template <typename T>
+    struct Templ
+    {
+        void member();
+    };
+}
+
+void ns::Widget::resize(int) {}
+
+void global();
+)";
+
+    cpp_entity_index idx;
+    auto             file = parse(idx, "cpp_entity_index.cpp", code);
+    idx.build_name_index();
+
+    SECTION("lookup_name")
+    {
+        REQUIRE(lookup_names(idx, idx.lookup_name("ns")) == std::vector<std::string>{"ns"});
+        REQUIRE(lookup_names(idx, idx.lookup_name("ns::Widget"))
+                == std::vector<std::string>{"Widget"});
+        REQUIRE(idx.lookup_name("ns::Widget::resize").size() == 2u);
+        REQUIRE(idx.lookup_name("ns::Widget::width").size() == 1u);
+        REQUIRE(idx.lookup_name("ns::Widget::Nested::width").size() == 1u);
+        REQUIRE(idx.lookup_name("ns::hidden").size() == 1u);
+        REQUIRE(idx.lookup_name("ns::Templ").size() == 1u);
+        REQUIRE(idx.lookup_name("ns::Templ::member").size() == 1u);
+        REQUIRE(idx.lookup_name("global").size() == 1u);
+
+        REQUIRE(idx.lookup_name("Widget").size() == 0u);
+        REQUIRE(idx.lookup_name("ns::Widget::").size() == 0u);
+        REQUIRE(idx.lookup_name("ns::Widget::resiz").size() == 0u);
+    }
+    SECTION("lookup_name_prefix")
+    {
+        REQUIRE(idx.lookup_name_prefix("ns::Widget::").size() == 5u);
+        REQUIRE(idx.lookup_name_prefix("ns::Widget::Nested").size() == 2u);
+        REQUIRE(idx.lookup_name_prefix("ns::Widget::resize").size() == 2u);
+        REQUIRE(idx.lookup_name_prefix("ns::Wid").size() == 6u);
+        REQUIRE(idx.lookup_name_prefix("foo").size() == 0u);
+    }
+    SECTION("lookup_scope_members")
+    {
+        REQUIRE(lookup_names(idx, idx.lookup_scope_members("ns::Widget"))
+                == (std::vector<std::string>{"Nested", "resize", "resize", "width"}));
+        REQUIRE(lookup_names(idx, idx.lookup_scope_members("ns::Widget::Nested"))
+                == std::vector<std::string>{"width"});
+        REQUIRE(lookup_names(idx, idx.lookup_scope_members(""))
+                == (std::vector<std::string>{"global", "ns"}));
+        REQUIRE(idx.lookup_scope_members("ns::Wid").size() == 0u);
+    }
+}
+
+TEST_CASE("cpp_entity_index_snapshot")
+{
+    auto code = R"(
+namespace ns
+{
+    struct Widget
+    {
+        void resize(int);
+
+        int width;
+    };
+}
+
+void global();
+)";
+
+    cpp_entity_index idx;
+    auto             file = parse(idx, "cpp_entity_index_snapshot.cpp", code);
+    idx.write_snapshot("cpp_entity_index_snapshot.idx");
+
+    cpp_entity_index_snapshot snapshot("cpp_entity_index_snapshot.idx");
+    std::remove("cpp_entity_index_snapshot.idx");
+
+    auto widget = snapshot.lookup_name("ns::Widget");
+    REQUIRE(widget.size() == 1u);
+    REQUIRE(widget.front().name == std::string("Widget"));
+    REQUIRE(widget.front().file == std::string("cpp_entity_index_snapshot.cpp"));
+    REQUIRE(widget.front().kind == cpp_entity_kind::class_t);
+    REQUIRE(widget.front().is_definition);
+
+    auto info = snapshot.lookup(widget.front().id);
+    REQUIRE(info);
+    REQUIRE(info.value().full_name == std::string("ns::Widget"));
+    REQUIRE(idx.lookup(widget.front().id).value().name() == "Widget");
+
+    REQUIRE(snapshot.lookup_name_prefix("ns::Widget::").size() == 2u);
+    REQUIRE(snapshot.lookup_name("global").size() == 1u);
+    REQUIRE(!snapshot.lookup_name("global").front().is_definition);
+    REQUIRE(snapshot.lookup_name("Widget").empty());
+
+    auto ns = snapshot.lookup_name("ns");
+    REQUIRE(ns.size() == 1u);
+    REQUIRE(ns.front().kind == cpp_entity_kind::namespace_t);
+    auto files = snapshot.lookup_namespace(ns.front().id);
+    REQUIRE(files.size() == 1u);
+    REQUIRE(files.front() == std::string("cpp_entity_index_snapshot.cpp"));
+
+    REQUIRE_THROWS_AS(cpp_entity_index_snapshot("cpp_entity_index_snapshot.cpp"), snapshot_error);
+
+    // the string table is at the end, so this overwrites its terminator
+    idx.write_snapshot("cpp_entity_index_snapshot.idx");
+    std::string content;
+    {
+        std::ifstream in("cpp_entity_index_snapshot.idx", std::ios_base::binary);
+        content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out("cpp_entity_index_snapshot.idx", std::ios_base::binary);
+        content.back() = 'x';
+        out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    }
+    REQUIRE_THROWS_AS(cpp_entity_index_snapshot("cpp_entity_index_snapshot.idx"), snapshot_error);
+    std::remove("cpp_entity_index_snapshot.idx");
+}
+
+TEST_CASE("cpp_entity_index::unregister_file")
+{
+    // parsed again below
+    write_file("unregister_file_decl.cpp", "struct a; struct b {};");
+
+    cpp_entity_index idx(true);
+    auto decl_file = parse_file(idx, "unregister_file_decl.cpp");
+    auto def_file  = parse(idx, "unregister_file_def.cpp", "struct a {};");
+
+    auto& decl = static_cast<const cpp_class&>(*decl_file->begin());
+    REQUIRE(decl.definition_entity(idx));
+    REQUIRE(idx.lookup_definition(decl.definition().value()));
+
+    idx.unregister_file(*def_file);
+    REQUIRE(!decl.definition_entity(idx));
+    REQUIRE(!idx.lookup_definition(decl.definition().value()));
+    REQUIRE(&idx.lookup(decl.definition().value()).value() == &decl);
+
+    idx.unregister_file(*decl_file);
+    REQUIRE(!idx.lookup(decl.definition().value()));
+
+    // can be parsed again
+    REQUIRE(parse_file(idx, "unregister_file_decl.cpp"));
+}
+
+TEST_CASE("cpp_entity_index::unregister_file with multiple definitions")
+{
+    // an inline function can be defined in every file, that isn't an error if files are tracked
+    auto code = "inline void f() {}";
+
+    cpp_entity_index idx(true);
+    auto             a = parse(idx, "unregister_file_a.cpp", code);
+    auto             b = parse(idx, "unregister_file_b.cpp", code);
+    idx.build_name_index();
+    auto f_id = idx.lookup_name("f")[0u];
+    REQUIRE(&idx.lookup_definition(f_id).value() == &*a->begin());
+
+    // the definition of the other file is used once the first one is gone
+    idx.unregister_file(*a);
+    REQUIRE(&idx.lookup_definition(f_id).value() == &*b->begin());
+
+    idx.unregister_file(*b);
+    REQUIRE(!idx.lookup(f_id));
+}
+
+TEST_CASE("lazy_entity_index")
+{
+    {
+        // the loader parses them again
+        write_file("lazy_entity_index_a.cpp", "struct a { int x; };");
+        write_file("lazy_entity_index_b.cpp", "struct b { int y; };");
+
+        cpp_entity_index idx;
+        auto             a = parse_file(idx, "lazy_entity_index_a.cpp");
+        auto             b = parse_file(idx, "lazy_entity_index_b.cpp");
+        idx.write_snapshot("lazy_entity_index.idx");
+    }
+
+    auto              loads = 0u;
+    lazy_entity_index lazy(cpp_entity_index_snapshot("lazy_entity_index.idx"),
+                           [&](const std::string& path, const cpp_entity_index& idx) {
+                               ++loads;
+                               return parse_file(idx, path.c_str());
+                           },
+                           4u);
+    std::remove("lazy_entity_index.idx");
+    REQUIRE(lazy.loaded_files() == 0u);
+
+    auto a_id = lazy.snapshot().lookup_name("a").front().id;
+    auto b_id = lazy.snapshot().lookup_name("b").front().id;
+
+    auto a = lazy.lookup(a_id);
+    REQUIRE(a != nullptr);
+    REQUIRE(a->name() == "a");
+    REQUIRE(lazy.lookup_definition(a_id) != nullptr);
+    REQUIRE(lazy.loaded_files() == 1u);
+    REQUIRE(loads == 1u);
+
+    // loading b exceeds the budget and unloads a, but a is still alive
+    REQUIRE(lazy.lookup(b_id)->name() == "b");
+    REQUIRE(lazy.loaded_files() == 1u);
+    REQUIRE(lazy.loaded_entities() == 3u);
+    REQUIRE(loads == 2u);
+    REQUIRE(a->name() == "a");
+
+    REQUIRE(lazy.lookup(a_id)->name() == "a");
+    REQUIRE(loads == 3u);
+
+    REQUIRE(lazy.lookup(cpp_entity_id("unknown")) == nullptr);
+    REQUIRE(loads == 3u);
+}
+
+TEST_CASE("lazy_entity_index with concurrent loads")
+{
+    // builds the files directly, as the loader is called on multiple threads
+    auto make_file = [](const cpp_entity_index& idx, const std::string& path) {
+        auto name = path == "lazy_concurrent_a.cpp" ? "a" : "b";
+
+        cpp_class::builder class_(name, cpp_class_kind::struct_t);
+        cpp_file::builder  file(path);
+        file.add_child(class_.finish(idx, cpp_entity_id(name), type_safe::nullopt));
+        return file.finish(idx);
+    };
+    {
+        cpp_entity_index idx;
+        auto             a = make_file(idx, "lazy_concurrent_a.cpp");
+        auto             b = make_file(idx, "lazy_concurrent_b.cpp");
+        idx.write_snapshot("lazy_concurrent.idx");
+    }
+
+    std::atomic<unsigned> loads(0u);
+    lazy_entity_index     lazy(cpp_entity_index_snapshot("lazy_concurrent.idx"),
+                               [&](const std::string& path, const cpp_entity_index& idx) {
+                                   ++loads;
+                                   // the other threads must wait for it instead of loading it again
+                                   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                                   return make_file(idx, path);
+                               },
+                               100u);
+    std::remove("lazy_concurrent.idx");
+
+    std::vector<std::string> names(8u);
+    std::vector<std::thread> threads;
+    for (auto i = 0u; i != names.size(); ++i)
+        threads.emplace_back([&, i] {
+            auto entity = lazy.lookup(cpp_entity_id(i % 2u == 0u ? "a" : "b"));
+            if (entity)
+                names[i] = entity->name();
+        });
+    for (auto& thread : threads)
+        thread.join();
+
+    for (auto i = 0u; i != names.size(); ++i)
+        REQUIRE(names[i] == (i % 2u == 0u ? "a" : "b"));
+    REQUIRE(loads == 2u);
+    REQUIRE(lazy.loaded_files() == 2u);
+}
+
+TEST_CASE("full_name")
+{
+    auto code = R"(
+namespace ns
+{
+    struct a
+    {
+        struct b;
+
+        template <typename T>
+        struct c
+        {
+            void d();
+        };
+
+        friend void e();
+
+        enum f { f_a };
+        enum class g { g_a };
+    };
+
+    namespace
+    {
+        int h;
+    }
+}
+
+struct ns::a::b
+{
+    int i;
+};
+)";
+
+    cpp_entity_index idx;
+    auto             file  = parse(idx, "full_name.cpp", code);
+    auto             count = 0u;
+    visit_all(*file, [&](const cpp_entity& e) {
+        if (is_templated(e) || e.kind() == cpp_entity_kind::file_t)
+            return;
+
+        INFO(e.name());
+        if (e.name() == "ns")
+            REQUIRE(cppast::full_name(e) == "ns");
+        else if (e.name() == "a")
+            REQUIRE(cppast::full_name(e) == "ns::a");
+        else if (e.name() == "b")
+            REQUIRE(cppast::full_name(e) == "ns::a::b");
+        else if (e.name() == "c")
+            REQUIRE(cppast::full_name(e) == "ns::a::c");
+        else if (e.name() == "d")
+            REQUIRE(cppast::full_name(e) == "ns::a::c::d");
+        else if (e.name() == "e")
+            REQUIRE(cppast::full_name(e) == "ns::e");
+        else if (e.name() == "f")
+            REQUIRE(cppast::full_name(e) == "ns::a::f");
+        else if (e.name() == "f_a")
+            REQUIRE(cppast::full_name(e) == "ns::a::f_a");
+        else if (e.name() == "g")
+            REQUIRE(cppast::full_name(e) == "ns::a::g");
+        else if (e.name() == "g_a")
+            REQUIRE(cppast::full_name(e) == "ns::a::g::g_a");
+        else if (e.name() == "h")
+            REQUIRE(cppast::full_name(e) == "ns::h");
+        else if (e.name() == "i")
+            REQUIRE(cppast::full_name(e) == "ns::a::b::i");
+        else if (e.name() == "T")
+            REQUIRE(cppast::full_name(e) == "T");
+        else
+            return;
+
+        ++count;
+    });
+    REQUIRE(count == 14u);
+}
+
+TEST_CASE("full_name of templated, friended and anonymous scopes")
+{
+    auto code = R"(
+namespace ns
+{
+    template <typename T>
+    struct templ
+    {
+        struct templ_member {};
+
+        template <typename U>
+        void templ_func();
+    };
+
+    struct host
+    {
+        friend struct friended;
+        friend void friended_func();
+
+        template <typename T>
+        friend void friended_templ();
+    };
+
+    template <typename T>
+    struct templ_host
+    {
+        friend void templ_friended_func();
+    };
+
+    namespace
+    {
+        struct anon_ns_member {};
+    }
+
+    struct outer
+    {
+        struct
+        {
+            int anon_struct_member;
+        } var;
+
+        union
+        {
+            int anon_union_member;
+        };
+    };
+}
+)";
+
+    // templated entities and their templates have the same full name
+    std::unordered_map<std::string, std::string> expected = {
+        {"templ", "ns::templ"},
+        {"templ_member", "ns::templ::templ_member"},
+        {"templ_func", "ns::templ::templ_func"},
+        {"U", "U"},
+        {"friended", "ns::friended"},
+        {"friended_func", "ns::friended_func"},
+        {"friended_templ", "ns::friended_templ"},
+        {"templ_friended_func", "ns::templ_friended_func"},
+        {"anon_ns_member", "ns::anon_ns_member"},
+        {"outer", "ns::outer"},
+        {"var", "ns::outer::var"},
+        {"anon_struct_member", "ns::outer::anon_struct_member"},
+        {"anon_union_member", "ns::outer::anon_union_member"}};
+
+    cpp_entity_index                idx;
+    auto                            file = parse(idx, "full_name_scopes.cpp", code);
+    std::unordered_set<std::string> found;
+    visit_all(*file, [&](const cpp_entity& e) {
+        auto iter = expected.find(e.name());
+        if (iter != expected.end())
+        {
+            INFO(e.name());
+            REQUIRE(cppast::full_name(e) == iter->second);
+            found.insert(e.name());
+        }
+    });
+    REQUIRE(found.size() == expected.size());
+}
+
+TEST_CASE("cpp_entity_id")
+{
+    REQUIRE(cpp_entity_id("c:@N@ns@S@Widget") == cpp_entity_id(std::string("c:@N@ns@S@Widget")));
+    REQUIRE(cpp_entity_id("c:@N@ns@S@Widget") != cpp_entity_id("c:@N@ns@S@Widgeu"));
+    REQUIRE(cpp_entity_id("") != cpp_entity_id(std::string(1u, '\0')));
+
+    // hashing pieces is the same as hashing the concatenation
+    std::string str = "c:@N@ns@FT@>1#Tf#t0.0#v#";
+    for (auto i = 0u; i <= str.size(); ++i)
+    {
+        detail::id_hasher hasher;
+        hasher.append(str.substr(0u, i)).append(str.substr(i));
+        REQUIRE(cpp_entity_id(hasher) == cpp_entity_id(str));
+    }
+}
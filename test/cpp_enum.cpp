@@ -121,7 +121,7 @@ enum ns::c : int {};
                 auto no_vals = 0u;
                 for (auto& val : e)
                 {
-                    REQUIRE(full_name(val) == "b::" + val.name());
+                    REQUIRE(::full_name(val) == "b::" + val.name());
                     if (val.name() == "b_a" || val.name() == "b_c")
                     {
                         ++no_vals;
@@ -174,3 +174,93 @@ enum ns::c : int {};
     });
     REQUIRE(count == 5u);
 }
+
+TEST_CASE("cpp_enum_value_table")
+{
+    auto code = R"(
+enum dense
+{
+    dense_a = -2,
+    dense_b,
+    dense_c = 1,
+    dense_d = dense_b + 2, // same value as dense_c
+    dense_e
+};
+
+enum sparse : unsigned long long
+{
+    sparse_a = 1,
+    sparse_b = 1000,
+    sparse_c = 0xFFFFFFFFFFFFFFFF
+};
+
+template <int I>
+struct foo
+{
+    enum dependent
+    {
+        dependent_a = 4,
+        dependent_b,
+        dependent_c = I,
+        dependent_d
+    };
+};
+)";
+
+    auto value_of = [](const cpp_enum& e, const char* name) {
+        for (auto& val : e)
+            if (val.name() == name)
+                return val.evaluated_value();
+        REQUIRE(false);
+        return type_safe::optional<cpp_integral_value>();
+    };
+
+    cpp_entity_index idx;
+    auto             file  = parse(idx, "cpp_enum_value_table.cpp", code);
+    auto             count = test_visit<cpp_enum>(*file, [&](const cpp_enum& e) {
+        cpp_enum_value_table table(e);
+        if (e.name() == "dense")
+        {
+            REQUIRE(value_of(e, "dense_a") == cpp_integral_value::make_signed(-2));
+            REQUIRE(value_of(e, "dense_b") == cpp_integral_value::make_signed(-1));
+            REQUIRE(value_of(e, "dense_d") == cpp_integral_value::make_signed(1));
+            REQUIRE(value_of(e, "dense_e") == cpp_integral_value::make_signed(2));
+
+            REQUIRE(table.is_dense());
+            REQUIRE(table.entries().size() == 4u);
+            REQUIRE(table.lookup(cpp_integral_value::make_signed(-2)).value().name() == "dense_a");
+            REQUIRE(table.lookup(cpp_integral_value::make_signed(1)).value().name() == "dense_c");
+            REQUIRE(table.lookup(cpp_integral_value::make_unsigned(2)).value().name() == "dense_e");
+            REQUIRE(!table.lookup(cpp_integral_value::make_signed(0)));
+            REQUIRE(!table.lookup(cpp_integral_value::make_signed(3)));
+            REQUIRE(!table.lookup(cpp_integral_value::make_unsigned(std::uint64_t(-2))));
+        }
+        else if (e.name() == "sparse")
+        {
+            REQUIRE(value_of(e, "sparse_c")
+                    == cpp_integral_value::make_unsigned(std::uint64_t(-1)));
+
+            REQUIRE(!table.is_dense());
+            REQUIRE(table.entries().size() == 3u);
+            REQUIRE(table.entries().back().enumerator->name() == "sparse_c");
+            REQUIRE(table.lookup(cpp_integral_value::make_signed(1000)).value().name()
+                    == "sparse_b");
+            REQUIRE(!table.lookup(cpp_integral_value::make_signed(-1)));
+            REQUIRE(!table.lookup(cpp_integral_value::make_unsigned(2)));
+        }
+        else if (e.name() == "dependent")
+        {
+            REQUIRE(value_of(e, "dependent_a") == cpp_integral_value::make_signed(4));
+            REQUIRE(value_of(e, "dependent_b") == cpp_integral_value::make_signed(5));
+            REQUIRE(!value_of(e, "dependent_c"));
+            REQUIRE(!value_of(e, "dependent_d"));
+
+            REQUIRE(table.entries().size() == 2u);
+            REQUIRE(table.lookup(cpp_integral_value::make_signed(5)).value().name()
+                    == "dependent_b");
+        }
+        else
+            REQUIRE(false);
+    });
+    REQUIRE(count == 3u);
+}
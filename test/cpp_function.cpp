@@ -110,6 +110,7 @@ ns::m m();
                                                   build(cpp_pointer_type::build(
                                                             cpp_builtin_type::build(cpp_float)),
                                                         cpp_token_string::tokenize("nullptr"))));
+                        REQUIRE(!param.default_value().value().evaluated_value());
                     }
                     else
                         REQUIRE(false);
@@ -307,3 +308,37 @@ void foo::a() {}
     });
     REQUIRE(count == 4u);
 }
+
+TEST_CASE("cpp_function_parameter evaluated_value")
+{
+    auto code = R"(
+constexpr int size = 4;
+
+void a(int i = 2 * 3, unsigned j = size, char k = 'a', float l = 1.f, int m = -1);
+)";
+
+    auto value_of = [](const cpp_function& func, const char* name) {
+        for (auto& param : func.parameters())
+            if (param.name() == name)
+                return param.default_value().value().evaluated_value();
+        REQUIRE(false);
+        return type_safe::optional<cpp_integral_value>();
+    };
+
+    cpp_entity_index idx;
+    auto             file  = parse(idx, "cpp_function_parameter_evaluated_value.cpp", code);
+    auto             count = test_visit<cpp_function>(*file,
+                                          [&](const cpp_function& func) {
+                                              REQUIRE(value_of(func, "i")
+                                                      == cpp_integral_value::make_signed(6));
+                                              REQUIRE(value_of(func, "j")
+                                                      == cpp_integral_value::make_unsigned(4u));
+                                              REQUIRE(value_of(func, "k")
+                                                      == cpp_integral_value::make_signed('a'));
+                                              REQUIRE(!value_of(func, "l"));
+                                              REQUIRE(value_of(func, "m")
+                                                      == cpp_integral_value::make_signed(-1));
+                                          },
+                                          false);
+    REQUIRE(count == 1u);
+}
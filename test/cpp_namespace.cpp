@@ -98,6 +98,47 @@ namespace e::f {}
     REQUIRE(count == 7u);
 }
 
+TEST_CASE("cpp_namespace head")
+{
+    // only the tokens up to the first member are used to parse the namespace itself
+    auto code = R"(
+namespace a::b
+{
+    int c;
+
+    namespace d
+    {
+        int e;
+    }
+}
+)";
+
+    auto file  = parse({}, "cpp_namespace_head.cpp", code);
+    auto count = test_visit<cpp_namespace>(*file, [&](const cpp_namespace& ns) {
+        REQUIRE(!ns.is_anonymous());
+        REQUIRE(!ns.is_inline());
+        if (ns.name() == "a")
+            REQUIRE(count_children(ns) == 1u);
+        else if (ns.name() == "b")
+        {
+            check_parent(ns, "a", "a::b");
+            REQUIRE(count_children(ns) == 2u);
+            REQUIRE(ns.begin()->name() == "c");
+        }
+        else if (ns.name() == "d")
+        {
+            check_parent(ns, "b", "a::b::d");
+            REQUIRE(count_children(ns) == 1u);
+            REQUIRE(ns.begin()->name() == "e");
+        }
+        else
+            REQUIRE(false);
+
+        return false; // don't have a comment
+    });
+    REQUIRE(count == 3u);
+}
+
 TEST_CASE("cpp_namespace_alias")
 {
     auto code = R"(
@@ -135,7 +176,7 @@ namespace f = outer::c;
         auto entities = target.get(idx);
         REQUIRE(entities.size() == no);
         for (auto& entity : entities)
-            REQUIRE(full_name(*entity) == target_full_name);
+            REQUIRE(::full_name(*entity) == target_full_name);
     };
 
     auto file  = parse(idx, "cpp_namespace_alias.cpp", code);
@@ -196,7 +237,7 @@ using namespace outer::ns;
 
         auto entities = target.get(idx);
         REQUIRE(entities.size() == 1u);
-        REQUIRE(full_name(*entities[0u]) == target_full_name);
+        REQUIRE(::full_name(*entities[0u]) == target_full_name);
     };
 
     auto file  = parse(idx, "cpp_using_directive.cpp", code);
@@ -276,7 +317,7 @@ using ns1::d;
         REQUIRE((target.no_overloaded() == no));
         for (auto entity : target.get(idx))
         {
-            REQUIRE(full_name(*entity) == target_full_name);
+            REQUIRE(::full_name(*entity) == target_full_name);
         }
     };
 
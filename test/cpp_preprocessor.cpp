@@ -3,6 +3,7 @@
 // found in the top-level directory of this distribution.
 
 #include <cppast/cpp_preprocessor.hpp>
+#include <cppast/cpp_variable.hpp>
 
 #include "test_parser.hpp"
 
@@ -113,8 +114,11 @@ b
 #include "header_a.hpp"
 )";
 
+    // header_a.hpp is included by header_b.hpp, so it must exist on disk
+    write_file("header_a.hpp", header_a);
+
     cpp_entity_index idx;
-    auto             file_a = parse(idx, "header_a.hpp", header_a);
+    auto             file_a = parse_file(idx, "header_a.hpp");
     auto             file_b = parse(idx, "header_b.hpp", header_b);
 
     auto count =
@@ -152,3 +156,54 @@ b
     });
     REQUIRE(count == 1u);
 }
+
+TEST_CASE("libclang_compile_config::set_preprocessed_input")
+{
+    write_file("preprocessed_input-header.hpp", "int a;\n");
+
+    // output of clang -E -dD -C without -Xclang -dI, the path of the file doesn't matter
+    write_file("preprocessed_input.ii", R"(# 1 "preprocessed_input.cpp"
+# 1 "<built-in>" 1
+# 1 "<built-in>" 3
+#define __cplusplus 201103L
+# 1 "<command line>" 1
+# 1 "<built-in>" 2
+# 1 "preprocessed_input.cpp" 2
+/// #define FOO 1
+#define FOO 1
+/// #include "preprocessed_input-header.hpp"
+# 1 "./preprocessed_input-header.hpp" 1
+int a;
+# 5 "preprocessed_input.cpp" 2
+
+/// int b=FOO;
+int b = FOO;
+)");
+
+    libclang_compile_config config;
+    config.set_flags(cpp_standard::cpp_latest);
+    config.set_preprocessed_input("preprocessed_input.ii");
+
+    cpp_entity_index idx;
+    libclang_parser  p(default_logger());
+    auto             file = p.parse(idx, "preprocessed_input.cpp", config);
+    REQUIRE(!p.error());
+    REQUIRE(file);
+
+    auto count = test_visit<cpp_macro_definition>(*file, [&](const cpp_macro_definition& macro) {
+        REQUIRE(macro.name() == "FOO");
+        REQUIRE(macro.replacement() == "1");
+    });
+    REQUIRE(count == 1u);
+
+    count = test_visit<cpp_include_directive>(*file, [&](const cpp_include_directive& include) {
+        REQUIRE(include.name() == "preprocessed_input-header.hpp");
+        REQUIRE(include.include_kind() == cppast::cpp_include_kind::local);
+        REQUIRE(include.full_path() == "./preprocessed_input-header.hpp");
+    });
+    REQUIRE(count == 1u);
+
+    count = test_visit<cpp_variable>(*file,
+                                     [&](const cpp_variable& var) { REQUIRE(var.name() == "b"); });
+    REQUIRE(count == 1u);
+}
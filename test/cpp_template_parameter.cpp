@@ -189,6 +189,45 @@ using d = void;
     REQUIRE(count == 4u);
 }
 
+TEST_CASE("cpp_non_type_template_parameter evaluated_value")
+{
+    auto code = R"(
+template <int A = 2 * 3, unsigned B = 4u, bool C = true, int D = sizeof(int), int E = A + 1,
+          char* F = nullptr>
+using a = void;
+)";
+
+    auto value_of = [](const cpp_alias_template& alias, const char* name) {
+        for (auto& p : alias.parameters())
+            if (p.name() == name)
+                return static_cast<const cpp_non_type_template_parameter&>(p)
+                    .default_value()
+                    .value()
+                    .evaluated_value();
+        REQUIRE(false);
+        return type_safe::optional<cpp_integral_value>();
+    };
+
+    cpp_entity_index idx;
+    auto             file  = parse(idx, "non_type_template_parameter_value.cpp", code);
+    auto             count = test_visit<cpp_alias_template>(*file,
+                                                [&](const cpp_alias_template& alias) {
+                                                    REQUIRE(value_of(alias, "A")
+                                                            == cpp_integral_value::make_signed(6));
+                                                    REQUIRE(value_of(alias, "B")
+                                                            == cpp_integral_value::make_unsigned(
+                                                                   4u));
+                                                    REQUIRE(value_of(alias, "C")
+                                                            == cpp_integral_value::make_signed(1));
+                                                    // might depend on a template parameter
+                                                    REQUIRE(!value_of(alias, "D"));
+                                                    REQUIRE(!value_of(alias, "E"));
+                                                    REQUIRE(!value_of(alias, "F"));
+                                                },
+                                                false);
+    REQUIRE(count == 1u);
+}
+
 TEST_CASE("cpp_template_template_parameter")
 {
     // no need to check parameters of template parameter
@@ -7,7 +7,11 @@
 #include <catch.hpp>
 
 #include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <initializer_list>
+#include <iterator>
+#include <vector>
 
 using namespace cppast;
 
@@ -52,6 +56,7 @@ TEST_CASE("tokenizer")
         check_equal_tokens("1.0e4", {cpp_token(cpp_token_kind::float_literal, "1.0e4")});
         check_equal_tokens("1e4", {cpp_token(cpp_token_kind::float_literal, "1e4")});
         check_equal_tokens(".5e-2", {cpp_token(cpp_token_kind::float_literal, ".5e-2")});
+        check_equal_tokens("1.5e-4", {cpp_token(cpp_token_kind::float_literal, "1.5e-4")});
 
         // hexadecimal
         check_equal_tokens("0xabc.def", {cpp_token(cpp_token_kind::float_literal, "0xabc.def")});
@@ -126,4 +131,93 @@ TEST_CASE("tokenizer")
                                              cpp_token(cpp_token_kind::identifier, "bar"),
                                              cpp_token(cpp_token_kind::punctuation, ">")});
     }
+    SECTION("invalid input")
+    {
+        check_equal_tokens("\xC3\xBC$a \\", {cpp_token(cpp_token_kind::identifier, "\xC3\xBC$a"),
+                                             cpp_token(cpp_token_kind::punctuation, "\\")});
+        // unterminated literals end at the end of the string
+        check_equal_tokens("a 'b", {cpp_token(cpp_token_kind::identifier, "a"),
+                                    cpp_token(cpp_token_kind::char_literal, "'b")});
+        check_equal_tokens("\"\\", {cpp_token(cpp_token_kind::string_literal, "\"\\")});
+        check_equal_tokens("R\"(a", {cpp_token(cpp_token_kind::string_literal, "R\"(a")});
+    }
+}
+
+TEST_CASE("cpp_token_string")
+{
+    cpp_token_string::builder builder;
+    builder.add_token(cpp_token(cpp_token_kind::identifier, "a"));
+    builder.add_token(cpp_token(cpp_token_kind::punctuation, "<"));
+    builder.add_token(cpp_token(cpp_token_kind::int_literal, "42"));
+    builder.add_token(cpp_token(cpp_token_kind::punctuation, ">>"));
+    builder.unmunch();
+    auto str = builder.finish();
+
+    REQUIRE(str.size() == 4u);
+    auto& front = str.front();
+    REQUIRE(front.kind == cpp_token_kind::identifier);
+    REQUIRE(front.spelling == "a");
+    auto& back = str.back();
+    REQUIRE(back.spelling == ">");
+    REQUIRE(back.spelling.length() == 1u);
+    REQUIRE(str.as_string() == "a<42>");
+    REQUIRE(str.begin()[2].spelling == "42");
+    REQUIRE(str.end() - 1 == std::prev(str.end()));
+    REQUIRE(&*(str.end() - 1) == &back);
+
+    auto iter = str.begin();
+    ++iter;
+    REQUIRE(iter->spelling == std::string("<"));
+    REQUIRE(std::string(iter->spelling) == "<");
+    ++iter;
+    REQUIRE(iter->kind == cpp_token_kind::int_literal);
+    REQUIRE(*iter == cpp_token(cpp_token_kind::int_literal, "42"));
+
+    REQUIRE(str == cpp_token_string::tokenize("a < 42 >"));
+    REQUIRE(str != cpp_token_string::tokenize("a < 4 2 >"));
+    REQUIRE(str != cpp_token_string::tokenize("a < 42"));
+
+    // the spellings stay valid in copies
+    auto copy = cpp_token_string::tokenize("b");
+    {
+        auto original = cpp_token_string::tokenize("a < 42 >");
+        copy          = original;
+    }
+    REQUIRE(copy.front().spelling == "a");
+    REQUIRE(copy == str);
+}
+
+TEST_CASE("cpp_token_string::tokenize", "[!hide][benchmark]")
+{
+    const char* files[] = {
+#include <cppast_files.hpp>
+    };
+
+    std::vector<std::string> headers;
+    for (auto file : files)
+    {
+        std::string name = file;
+        if (name.size() < 4u || name.compare(name.size() - 4u, 4u, ".hpp") != 0)
+            continue;
+
+        std::ifstream in(name);
+        REQUIRE(in.is_open());
+        headers.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    REQUIRE(!headers.empty());
+
+    auto bytes = std::size_t(0u), tokens = std::size_t(0u);
+    auto begin = std::chrono::steady_clock::now();
+    for (auto i = 0; i != 20; ++i)
+        for (auto& header : headers)
+        {
+            bytes += header.size();
+            tokens += cpp_token_string::tokenize(header).size();
+        }
+    auto end = std::chrono::steady_clock::now();
+
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 20;
+    WARN("tokenize: " << headers.size() << " headers, " << bytes / 20 << " bytes, "
+                      << tokens / 20 << " tokens in " << us << "us");
+    REQUIRE(tokens > 0u);
 }
@@ -97,19 +97,26 @@ int r[] = {0};
         if (var.name() == "a")
             check_variable(var, *int_type, nullptr, cpp_storage_class_none, false, false);
         else if (var.name() == "b")
+        {
             check_variable(var, *cpp_builtin_type::build(cpp_ulonglong),
                            // unexposed due to implicit cast, I think
                            type_safe::ref(
                                *cpp_unexposed_expression::build(cpp_builtin_type::build(cpp_int),
                                                                 cpp_token_string::tokenize("42"))),
                            cpp_storage_class_none, false, false);
+            REQUIRE(var.default_value().value().evaluated_value()
+                    == cpp_integral_value::make_unsigned(42u));
+        }
         else if (var.name() == "c")
+        {
             check_variable(var, *cpp_builtin_type::build(cpp_float),
                            type_safe::ref(
                                *cpp_unexposed_expression::build(cpp_builtin_type::build(cpp_float),
                                                                 cpp_token_string::tokenize(
                                                                     "3.f+0.14f"))),
                            cpp_storage_class_none, false, false);
+            REQUIRE(!var.default_value().value().evaluated_value());
+        }
         else if (var.name() == "d")
             check_variable(var, *int_type, nullptr, cpp_storage_class_extern, false, true);
         else if (var.name() == "e")
@@ -120,6 +127,7 @@ int r[] = {0};
             check_variable(var, *int_type, nullptr,
                            cpp_storage_class_static | cpp_storage_class_thread_local, false, false);
         else if (var.name() == "h")
+        {
             check_variable(var,
                            *cpp_cv_qualified_type::build(cpp_builtin_type::build(cpp_int),
                                                          cpp_cv_const),
@@ -127,6 +135,9 @@ int r[] = {0};
                                *cpp_unexposed_expression::build(cpp_builtin_type::build(cpp_int),
                                                                 cpp_token_string::tokenize("12"))),
                            cpp_storage_class_none, true, false);
+            REQUIRE(var.default_value().value().evaluated_value()
+                    == cpp_integral_value::make_signed(12));
+        }
         else if (var.name() == "i")
         {
             check_variable(var,
@@ -170,6 +181,7 @@ int r[] = {0};
                                                                 cpp_token_string::tokenize("128"))),
                            cpp_storage_class_none, false, false);
         else if (var.name() == "n")
+        {
             check_variable(var,
                            *cpp_reference_type::
                                build(cpp_cv_qualified_type::build(cpp_auto_type::build(),
@@ -179,6 +191,9 @@ int r[] = {0};
                                *cpp_unexposed_expression::build(cpp_builtin_type::build(cpp_int),
                                                                 cpp_token_string::tokenize("m"))),
                            cpp_storage_class_none, false, false);
+            // not a constant expression
+            REQUIRE(!var.default_value().value().evaluated_value());
+        }
         else if (var.name() == "o")
             check_variable(var,
                            *cpp_decltype_type::build(
@@ -200,13 +215,19 @@ int r[] = {0};
                                                                 cpp_token_string::tokenize("o"))),
                            cpp_storage_class_none, false, false);
         else if (var.name() == "q")
+        {
             check_variable(var,
                            *cpp_array_type::build(cpp_builtin_type::build(cpp_int),
                                                   cpp_literal_expression::
                                                       build(cpp_builtin_type::build(cpp_ulonglong),
                                                             "42")),
                            nullptr, cpp_storage_class_none, false, false);
+            auto& array = static_cast<const cpp_array_type&>(var.type());
+            REQUIRE(array.size().value().evaluated_value()
+                    == cpp_integral_value::make_unsigned(42u));
+        }
         else if (var.name() == "r")
+        {
             check_variable(var,
                            *cpp_array_type::build(cpp_builtin_type::build(cpp_int),
                                                   cpp_literal_expression::
@@ -216,6 +237,10 @@ int r[] = {0};
                                *cpp_unexposed_expression::build(cpp_unexposed_type::build(""),
                                                                 cpp_token_string::tokenize("{0}"))),
                            cpp_storage_class_none, false, false);
+            auto& array = static_cast<const cpp_array_type&>(var.type());
+            REQUIRE(array.size().value().evaluated_value()
+                    == cpp_integral_value::make_unsigned(1u));
+        }
         else
             REQUIRE(false);
 
@@ -4,9 +4,20 @@
 
 #include <catch.hpp>
 
+#include <cppast/cpp_class.hpp>
+#include <cppast/cpp_entity_index.hpp>
+#include <cppast/cpp_entity_index_snapshot.hpp>
+#include <cppast/cpp_namespace.hpp>
+#include <cppast/cpp_variable.hpp>
 #include <cppast/libclang_parser.hpp>
+#include <cppast/libclang_process_parser.hpp>
+#include <cppast/visitor.hpp>
 
+#include <chrono>
+#include <cstdio>
 #include <fstream>
+#include <thread>
+#include <vector>
 
 using namespace cppast;
 
@@ -100,3 +111,538 @@ TEST_CASE("libclang_compile_config")
     libclang_compile_config c(database, CPPAST_DETAIL_DRIVE "/c.cpp");
     require_flags(c, "-std=c++14 -fms-extensions -fms-compatibility");
 }
+
+TEST_CASE("find_dependencies_for")
+{
+    auto database = get_database(R"([
+{
+    "directory": "",
+    "command": "/usr/bin/clang++ -MMD -MF find_dependencies_for-a.d -c -o a.o /a.cpp",
+    "file": "/a.cpp"
+},
+{
+    "directory": "",
+    "command": "/usr/bin/clang++ -MD -c -o find_dependencies_for-b.o /b.cpp",
+    "file": "/b.cpp"
+},
+{
+    "directory": "",
+    "command": "/usr/bin/clang++ -c -o c.o /c.cpp",
+    "file": "/c.cpp"
+}
+])");
+
+    std::ofstream("find_dependencies_for-a.d") << R"(a.o: /a.cpp a.hpp \
+  /usr/include/b\ c.hpp \
+  /d.hpp
+a.hpp:
+)";
+    std::remove("find_dependencies_for-b.d");
+
+    auto a = find_dependencies_for(database, "/a.cpp");
+    REQUIRE(a);
+    REQUIRE((a.value() == std::vector<std::string>{"a.hpp", "/usr/include/b c.hpp", "/d.hpp"}));
+
+    // dependency file doesn't exist yet
+    REQUIRE(!find_dependencies_for(database, "/b.cpp"));
+    std::ofstream("find_dependencies_for-b.d") << "find_dependencies_for-b.o: /b.cpp\n";
+    auto b = find_dependencies_for(database, "/b.cpp");
+    REQUIRE(b);
+    REQUIRE(b.value().empty());
+
+    // no dependency file written
+    REQUIRE(!find_dependencies_for(database, "/c.cpp"));
+}
+
+TEST_CASE("libclang_compile_config::add_unsaved_file")
+{
+    libclang_compile_config config;
+    config.set_flags(cpp_standard::cpp_latest);
+    config.add_unsaved_file("unsaved_file.cpp", R"(#include "unsaved_file.hpp"
+
+struct b : a {};
+)");
+    config.add_unsaved_file("unsaved_file.hpp", "#define A\nstruct a {};\n");
+
+    SECTION("fast_preprocessing")
+    {
+        config.fast_preprocessing(true);
+    }
+    SECTION("normal")
+    {
+        config.fast_preprocessing(false);
+    }
+
+    libclang_parser  p(default_logger());
+    cpp_entity_index idx;
+    auto             file = p.parse(idx, "unsaved_file.cpp", config);
+    REQUIRE(!p.error());
+    REQUIRE(file);
+
+    std::vector<std::string> names;
+    for (auto& e : *file)
+        names.push_back(e.name());
+    REQUIRE(names == (std::vector<std::string>{"unsaved_file.hpp", "b"}));
+
+    // nothing has been written to disk
+    REQUIRE(!std::ifstream("unsaved_file.cpp"));
+    REQUIRE(!std::ifstream("unsaved_file.hpp"));
+}
+
+TEST_CASE("libclang_compile_config::parse_comments")
+{
+    libclang_compile_config config;
+    config.set_flags(cpp_standard::cpp_latest);
+    config.add_unsaved_file("parse_comments.cpp", R"(/// a
+struct a {};
+
+/// unmatched
+)");
+
+    auto parse_comments = false;
+    SECTION("enabled")
+    {
+        parse_comments = true;
+    }
+    SECTION("disabled")
+    {
+        parse_comments = false;
+    }
+    config.parse_comments(parse_comments);
+
+    libclang_parser  p(default_logger());
+    cpp_entity_index idx;
+    auto             file = p.parse(idx, "parse_comments.cpp", config);
+    REQUIRE(!p.error());
+    REQUIRE(file);
+
+    auto& a = *file->begin();
+    REQUIRE(a.name() == "a");
+    if (parse_comments)
+    {
+        REQUIRE(a.comment());
+        REQUIRE(a.comment().value() == "a");
+        REQUIRE(file->unmatched_comments().size() == 1u);
+    }
+    else
+    {
+        REQUIRE(!a.comment());
+        REQUIRE(file->unmatched_comments().size() == 0u);
+    }
+}
+
+TEST_CASE("libclang_compile_config::lazy_unexposed")
+{
+    libclang_compile_config config;
+    config.set_flags(cpp_standard::cpp_latest);
+    config.add_unsaved_file("lazy_unexposed.cpp", R"(int f(int);
+int i = f(1 +  2);
+int j = (1 << 2)
+        * i;
+)");
+
+    auto lazy = false;
+    SECTION("enabled")
+    {
+        lazy = true;
+    }
+    SECTION("disabled")
+    {
+        lazy = false;
+    }
+    config.lazy_unexposed(lazy);
+
+    libclang_parser  p(default_logger());
+    cpp_entity_index idx;
+    auto             file = p.parse(idx, "lazy_unexposed.cpp", config);
+    REQUIRE(!p.error());
+    REQUIRE(file);
+
+    auto get_expression = [&](const char* name) -> const cpp_token_string& {
+        type_safe::optional_ref<const cpp_expression> value;
+        for (auto& e : *file)
+            if (e.kind() == cpp_variable::kind() && e.name() == name)
+                value = static_cast<const cpp_variable&>(e).default_value();
+        REQUIRE(value);
+        REQUIRE(value.value().kind() == cpp_expression_kind::unexposed_t);
+        return static_cast<const cpp_unexposed_expression&>(value.value()).expression();
+    };
+
+    auto& i = get_expression("i");
+    REQUIRE(i.as_string() == "f(1+2)");
+    REQUIRE(i.size() == 6u);
+    REQUIRE(i.front().kind == cpp_token_kind::identifier);
+
+    auto& j = get_expression("j");
+    REQUIRE(j.as_string() == "(1<<2)*i");
+    REQUIRE(j == cpp_token_string::tokenize("(1 << 2) * i"));
+}
+
+TEST_CASE("libclang_compile_config::set_prelude")
+{
+    {
+        std::ofstream file("prelude.hpp");
+        file << "#define PRELUDE_VALUE 42\nstruct a {};\n";
+    }
+
+    libclang_compile_config config;
+    config.set_flags(cpp_standard::cpp_latest);
+    config.set_prelude("prelude.hpp");
+
+    SECTION("fast_preprocessing")
+    {
+        config.fast_preprocessing(true);
+    }
+    SECTION("normal")
+    {
+        config.fast_preprocessing(false);
+    }
+
+    // records the messages about the precompiled prelude
+    class pch_logger : public diagnostic_logger
+    {
+    public:
+        pch_logger() : diagnostic_logger(true) {}
+
+        mutable std::vector<std::string> built, used, failed;
+
+    private:
+        bool do_log(const char*, const diagnostic& d) const override
+        {
+            // the path is quoted at the end of the message
+            auto path = [&] {
+                auto begin = d.message.find('\'') + 1u;
+                return d.message.substr(begin, d.message.size() - begin - 1u);
+            };
+            if (d.message.find("precompiled prelude to '") == 0u)
+                built.push_back(path());
+            else if (d.message.find("using precompiled prelude '") == 0u)
+                used.push_back(path());
+            else if (d.message.find("unable to precompile prelude") == 0u)
+                failed.push_back(d.message);
+            return true;
+        }
+    } logger;
+
+    // both files share the precompiled prelude
+    libclang_parser  p(type_safe::ref(logger));
+    cpp_entity_index idx;
+    for (auto name : {"prelude_b.cpp", "prelude_c.cpp"})
+    {
+        config.add_unsaved_file(name, "struct b : a { int value = PRELUDE_VALUE; };\n");
+
+        auto file = p.parse(idx, name, config);
+        REQUIRE(!p.error());
+        REQUIRE(file);
+
+        // the prelude isn't part of the file
+        std::vector<std::string> names;
+        for (auto& e : *file)
+            names.push_back(e.name());
+        REQUIRE(names == (std::vector<std::string>{"b"}));
+    }
+
+    // it was built once and used by both files
+    REQUIRE(logger.failed.empty());
+    REQUIRE(logger.built.size() == 1u);
+    REQUIRE(logger.used == (std::vector<std::string>{logger.built.front(), logger.built.front()}));
+    REQUIRE(std::ifstream(logger.built.front()).is_open());
+}
+
+TEST_CASE("libclang_parser::parse_streaming")
+{
+    {
+        std::ofstream file("parse_streaming.cpp");
+        file << R"(#include <cstddef>
+#define A 42
+
+struct a {};
+void b();
+namespace c { int d; }
+)";
+    }
+
+    libclang_compile_config config;
+    config.set_flags(cpp_standard::cpp_latest);
+
+    libclang_parser p(default_logger());
+
+    SECTION("without index")
+    {
+        std::vector<std::string> names;
+        REQUIRE(p.parse_streaming(nullptr, "parse_streaming.cpp", config,
+                                  [&](std::unique_ptr<cpp_entity> e) {
+                                      REQUIRE(!e->parent());
+                                      names.push_back(e->name());
+                                  }));
+        REQUIRE(!p.error());
+        REQUIRE(names == (std::vector<std::string>{"cstddef", "A", "a", "b", "c"}));
+    }
+    SECTION("with index")
+    {
+        cpp_entity_index                         idx;
+        std::vector<std::unique_ptr<cpp_entity>> entities;
+        REQUIRE(p.parse_streaming(type_safe::ref(idx), "parse_streaming.cpp", config,
+                                  [&](std::unique_ptr<cpp_entity> e) {
+                                      entities.push_back(std::move(e));
+                                  }));
+        REQUIRE(!p.error());
+        REQUIRE(entities.size() == 5u);
+        REQUIRE(idx.lookup(cpp_entity_id("c:@S@a")));
+        // the file itself isn't registered
+        REQUIRE(!idx.lookup(cpp_entity_id("parse_streaming.cpp")));
+    }
+}
+
+TEST_CASE("libclang_parser::set_entity_filter")
+{
+    {
+        std::ofstream file("entity_filter.cpp");
+        file << R"(
+struct [[generate::serialize]] a
+{
+    int member;
+    void function();
+};
+
+struct b
+{
+    int member;
+
+    struct [[generate::serialize]] nested {};
+};
+
+namespace ns
+{
+    [[deprecated]] void c();
+    void d();
+
+    template <typename T>
+    struct e
+    {
+        void f();
+    };
+}
+)";
+    }
+
+    libclang_compile_config config;
+    config.set_flags(cpp_standard::cpp_latest);
+
+    libclang_parser          p(default_logger());
+    std::vector<std::string> filtered;
+    auto                     filter = [&](const libclang_entity_info& info) {
+        filtered.push_back(info.name());
+        return info.has_attributes();
+    };
+
+    auto get_names = [](const cpp_entity& e) {
+        std::vector<std::string> names;
+        visit(e, [&](const cpp_entity& child, const visitor_info& info) {
+            if (child.kind() != cpp_entity_kind::file_t && info.is_new_entity())
+                names.push_back(child.name());
+        });
+        return names;
+    };
+
+    SECTION("members of accepted classes")
+    {
+        p.set_entity_filter(filter);
+
+        cpp_entity_index idx;
+        auto             file = p.parse(idx, "entity_filter.cpp", config);
+        REQUIRE(!p.error());
+        REQUIRE(file);
+        // namespaces and members of accepted classes aren't filtered,
+        // members of rejected classes are
+        REQUIRE(filtered
+                == (std::vector<std::string>{"a", "b", "member", "nested", "c", "d", "e", "f"}));
+        // b is only kept as scope of nested, e has no accepted members
+        REQUIRE(get_names(*file)
+                == (std::vector<std::string>{"a", "member", "function", "b", "nested", "ns",
+                                             "c"}));
+
+        // the scope isn't registered and has nothing but the accepted members
+        REQUIRE(!idx.lookup(cpp_entity_id("c:@S@b")));
+        auto nested = idx.lookup(cpp_entity_id("c:@S@b@S@nested"));
+        REQUIRE(nested);
+        REQUIRE(full_name(nested.value()) == "b::nested");
+        auto& scope = static_cast<const cpp_class&>(nested.value().parent().value());
+        REQUIRE(scope.class_kind() == cpp_class_kind::struct_t);
+        REQUIRE(scope.attributes().empty());
+        // the rejected function wasn't parsed, so it wasn't registered
+        REQUIRE(!idx.lookup(cpp_entity_id("c:@N@ns@F@d#")));
+    }
+    SECTION("filter_members")
+    {
+        p.set_entity_filter(filter, true);
+
+        cpp_entity_index idx;
+        auto             file = p.parse(idx, "entity_filter.cpp", config);
+        REQUIRE(!p.error());
+        REQUIRE(file);
+        REQUIRE(filtered
+                == (std::vector<std::string>{"a", "member", "function", "b", "member", "nested",
+                                             "c", "d", "e", "f"}));
+        REQUIRE(get_names(*file) == (std::vector<std::string>{"a", "b", "nested", "ns", "c"}));
+    }
+}
+
+TEST_CASE("libclang_parser::set_entity_filter performance", "[!hide][benchmark]")
+{
+    // only every tenth class is accepted, the others have members that are expensive to parse
+    {
+        std::ofstream file("entity_filter_benchmark.cpp");
+        file << "#include <map>\n#include <string>\n#include <vector>\n";
+        for (auto i = 0; i != 1000; ++i)
+        {
+            file << "struct " << (i % 10 == 0 ? "[[generate]] " : "") << "class_" << i << "\n{\n";
+            for (auto j = 0; j != 10; ++j)
+                file << "    std::map<std::string, std::vector<int>> member_" << j << ";\n"
+                     << "    const std::vector<std::string>& function_" << j
+                     << "(int a, const std::map<int, int>& b = {}) const noexcept;\n";
+            file << "};\n";
+        }
+    }
+
+    libclang_compile_config config;
+    config.set_flags(cpp_standard::cpp_latest);
+
+    auto parse = [&](const char* name, libclang_parser::entity_filter filter) {
+        libclang_parser p(default_logger());
+        p.set_entity_filter(std::move(filter));
+
+        cpp_entity_index idx;
+        auto             begin = std::chrono::steady_clock::now();
+        auto             file  = p.parse(idx, "entity_filter_benchmark.cpp", config);
+        auto             end   = std::chrono::steady_clock::now();
+        REQUIRE(file);
+
+        auto count = std::size_t(0u);
+        visit(*file, [&](const cpp_entity&, const visitor_info& info) {
+            if (info.is_new_entity())
+                ++count;
+        });
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+        WARN(name << ": " << count << " entities in " << ms << "ms");
+        return count;
+    };
+
+    auto all      = parse("unfiltered", {});
+    auto selected = parse("filtered", [](const libclang_entity_info& info) {
+        return info.kind() == cpp_entity_kind::class_t && info.has_attributes();
+    });
+    REQUIRE(selected < all);
+}
+
+TEST_CASE("libclang_parser multithreaded")
+{
+    {
+        std::ofstream file("multithreaded.cpp");
+        file << "struct a {};\n";
+    }
+
+    libclang_compile_config config;
+    config.set_flags(cpp_standard::cpp_latest);
+
+    libclang_parser p(default_logger());
+    p.use_background_priority(true);
+
+    // every thread uses its own libclang index
+    std::vector<std::unique_ptr<cpp_entity_index>> indices;
+    std::vector<std::unique_ptr<cpp_file>>         files(4u);
+    std::vector<std::thread>                       threads;
+    for (auto i = 0u; i != files.size(); ++i)
+        indices.emplace_back(new cpp_entity_index);
+    for (auto i = 0u; i != files.size(); ++i)
+        threads.emplace_back(
+            [&, i] { files[i] = p.parse(*indices[i], "multithreaded.cpp", config); });
+    for (auto& thread : threads)
+        thread.join();
+
+    REQUIRE(!p.error());
+    for (auto& file : files)
+    {
+        REQUIRE(file);
+        REQUIRE(file->begin()->name() == "a");
+    }
+}
+
+TEST_CASE("libclang_process_parser")
+{
+    {
+        std::ofstream file("process_a.cpp");
+        file << "struct a {};\nnamespace ns { void f(); }\n";
+    }
+    {
+        std::ofstream file("process_b.cpp");
+        file << "namespace ns { void f() {} }\n";
+    }
+
+    libclang_compile_config config;
+    config.set_flags(cpp_standard::cpp_latest);
+
+    libclang_process_parser p(default_logger(), 2u);
+    p.set_worker_executable(CPPAST_TEST_WORKER);
+    auto result = p.parse({{"process_a.cpp", config},
+                           {"process_b.cpp", config},
+                           {"process_missing.cpp", config}},
+                          "process.idx");
+    REQUIRE(result.parsed == (std::vector<std::string>{"process_a.cpp", "process_b.cpp"}));
+    REQUIRE(result.failed == std::vector<std::string>{"process_missing.cpp"});
+    REQUIRE(result.crashed.empty());
+
+    cpp_entity_index_snapshot snapshot("process.idx");
+    std::remove("process.idx");
+    REQUIRE(snapshot.lookup_name("a").size() == 1u);
+
+    // the definition of another file wins
+    auto f = snapshot.lookup_name("ns::f");
+    REQUIRE(f.size() == 1u);
+    REQUIRE(f.front().is_definition);
+    REQUIRE(f.front().file == std::string("process_b.cpp"));
+
+    // namespaces of all files are combined
+    auto ns = snapshot.lookup_name("ns");
+    REQUIRE(ns.size() == 1u);
+    REQUIRE(snapshot.lookup_namespace(ns.front().id).size() == 2u);
+}
+
+TEST_CASE("libclang_process_parser crash")
+{
+    // the filter of the worker aborts when it sees process_crash
+    // and hangs when it sees process_hang, see process_worker.cpp
+    {
+        std::ofstream file("process_ok.cpp");
+        file << "struct ok {};\n";
+    }
+    {
+        std::ofstream file("process_crash.cpp");
+        file << "struct process_crash {};\n";
+    }
+    {
+        std::ofstream file("process_hang.cpp");
+        file << "struct process_hang {};\n";
+    }
+
+    libclang_compile_config config;
+    config.set_flags(cpp_standard::cpp_latest);
+
+    libclang_process_parser p(default_logger(), 2u, 2u);
+    p.set_worker_executable(CPPAST_TEST_WORKER);
+    p.set_timeout(std::chrono::milliseconds(500));
+    auto result = p.parse({{"process_crash.cpp", config},
+                           {"process_hang.cpp", config},
+                           {"process_ok.cpp", config}},
+                          "process_crash.idx");
+    REQUIRE(result.parsed == std::vector<std::string>{"process_ok.cpp"});
+    REQUIRE(result.failed.empty());
+    REQUIRE(result.crashed == std::vector<std::string>{"process_crash.cpp"});
+    REQUIRE(result.timed_out == std::vector<std::string>{"process_hang.cpp"});
+
+    cpp_entity_index_snapshot snapshot("process_crash.idx");
+    std::remove("process_crash.idx");
+    REQUIRE(snapshot.lookup_name("ok").size() == 1u);
+    REQUIRE(snapshot.lookup_name("process_crash").empty());
+    REQUIRE(snapshot.lookup_name("process_hang").empty());
+}
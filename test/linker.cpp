@@ -0,0 +1,118 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <cppast/linker.hpp>
+
+#include <cppast/cpp_class.hpp>
+#include <cppast/cpp_namespace.hpp>
+#include <cppast/cpp_variable.hpp>
+
+#include "test_parser.hpp"
+
+using namespace cppast;
+
+TEST_CASE("link")
+{
+    auto code = R"(
+#include <cstddef>
+
+namespace ns
+{
+    struct a {};
+}
+
+namespace alias = ns;
+using namespace ns;
+using ns::a;
+
+ns::a var_a;
+const ns::a* var_b;
+std::size_t var_c;
+)";
+
+    cpp_entity_index idx;
+    auto             file = parse(idx, "linker.cpp", code);
+
+    auto unresolved = link(idx, *file);
+    REQUIRE(unresolved.size() == 1u);
+    REQUIRE(unresolved[0u].entity->name() == "var_c");
+    REQUIRE(unresolved[0u].name == "std::size_t");
+
+    auto count = 0u;
+    visit(*file, [&](const cpp_entity& e, const visitor_info& info) {
+        if (!info.is_new_entity())
+            return;
+
+        if (e.kind() == cpp_namespace_alias::kind())
+        {
+            auto& target = static_cast<const cpp_namespace_alias&>(e).target();
+            REQUIRE(target.is_linked());
+            REQUIRE(target.get(idx).size() == 1u);
+            REQUIRE(target.get(idx)[0u]->name() == "ns");
+            ++count;
+        }
+        else if (e.kind() == cpp_using_directive::kind())
+        {
+            auto& target = static_cast<const cpp_using_directive&>(e).target();
+            REQUIRE(target.is_linked());
+            REQUIRE(target.get(idx).size() == 1u);
+            ++count;
+        }
+        else if (e.kind() == cpp_using_declaration::kind())
+        {
+            auto& target = static_cast<const cpp_using_declaration&>(e).target();
+            REQUIRE(target.is_linked());
+            REQUIRE(target.get(idx).size() == 1u);
+            REQUIRE(target.get(idx)[0u]->name() == "a");
+            ++count;
+        }
+        else if (e.kind() == cpp_variable::kind() && e.name() == "var_a")
+        {
+            auto& type = static_cast<const cpp_variable&>(e).type();
+            REQUIRE(type.kind() == cpp_type_kind::user_defined_t);
+            auto& ref = static_cast<const cpp_user_defined_type&>(type).entity();
+            REQUIRE(ref.is_linked());
+            REQUIRE(ref.get(idx).size() == 1u);
+            REQUIRE(ref.get(idx)[0u]->name() == "a");
+            ++count;
+        }
+    });
+    REQUIRE(count == 4u);
+}
+
+TEST_CASE("link and unregister_file")
+{
+    cpp_entity_index idx(true);
+    auto             def  = parse(idx, "linker_def.cpp", "struct a {};");
+    auto             decl = parse(idx, "linker_decl.cpp", R"(
+struct a;
+extern a var;
+)");
+    REQUIRE(link(idx, *decl).empty());
+
+    const cpp_type_ref* ref = nullptr;
+    test_visit<cpp_variable>(*decl,
+                             [&](const cpp_variable& var) {
+                                 REQUIRE(var.type().kind() == cpp_type_kind::user_defined_t);
+                                 ref = &static_cast<const cpp_user_defined_type&>(var.type())
+                                            .entity();
+                             },
+                             false);
+    REQUIRE(ref);
+    REQUIRE(ref->get_linked(idx));
+    REQUIRE(ref->get_linked(idx).value().size() == 1u);
+    REQUIRE(static_cast<const cpp_class&>(*ref->get(idx)[0u]).is_definition());
+
+    // only used for the index it was linked with
+    cpp_entity_index other;
+    REQUIRE(!ref->get_linked(other));
+    REQUIRE(ref->get(other).empty());
+
+    // the definition is gone, so it falls back to the declaration
+    idx.unregister_file(*def);
+    REQUIRE(!ref->get_linked(idx));
+    auto entities = ref->get(idx);
+    REQUIRE(entities.size() == 1u);
+    REQUIRE(static_cast<const cpp_class&>(*entities[0u]).is_declaration());
+}
@@ -1,6 +1,11 @@
 #include <catch.hpp>
+#include <chrono>
+#include <cstring>
 #include <fstream>
+#include <memory>
 
+#include "libclang/child_process.hpp"
+#include "libclang/file_cache.hpp"
 #include "libclang/preprocessor.hpp"
 #include "test_parser.hpp"
 
@@ -309,3 +314,89 @@ void j();
     }
     REQUIRE((file->unmatched_comments().size() == 3u + add));
 }
+
+#ifndef _WIN32
+TEST_CASE("detail::run_process")
+{
+    std::string out, err;
+    auto        exit_code =
+        detail::run_process("echo hello && echo world 1>&2 && exit 3",
+                            [&](const char* str, std::size_t n) { out.append(str, n); },
+                            [&](const char* str, std::size_t n) { err.append(str, n); });
+    REQUIRE(exit_code == 3);
+    REQUIRE(out == "hello\n");
+    REQUIRE(err == "world\n");
+}
+
+TEST_CASE("detail::run_process with large heap", "[!hide][benchmark]")
+{
+    auto spawn = [] {
+        auto begin = std::chrono::steady_clock::now();
+        for (auto i = 0; i != 20; ++i)
+            REQUIRE(detail::run_process("true", nullptr, nullptr) == 0);
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 20;
+    };
+
+    auto small = spawn();
+
+    // touch every page, so they are actually mapped
+    auto                    size = std::size_t(2u) << 30;
+    std::unique_ptr<char[]> heap(new char[size]);
+    for (auto i = std::size_t(0u); i < size; i += 4096u)
+        heap[i] = char(i);
+
+    auto large = spawn();
+    WARN("spawn: " << small << "us with a small heap, " << large << "us with a 2GiB heap");
+    // doesn't depend on the size of the heap
+    REQUIRE(large < 4 * small + 1000);
+}
+#endif
+
+TEST_CASE("detail::read_file")
+{
+    REQUIRE(!detail::read_file("read_file-missing.hpp"));
+
+    auto header = R"(// comment
+/* comment */
+#ifndef READ_FILE_HPP
+#define READ_FILE_HPP
+int a;
+#endif
+)";
+    write_file("read_file.hpp", header);
+
+    auto file = detail::read_file("read_file.hpp");
+    REQUIRE(file);
+    REQUIRE(std::string(file->data(), file->size()) == header);
+    REQUIRE(file->hash() == detail::id_hash(header, std::strlen(header)));
+    REQUIRE(file->include_guard().value() == "READ_FILE_HPP");
+
+    // cached
+    REQUIRE(detail::read_file("read_file.hpp") == file);
+
+    // read again after a change of size
+    write_file("read_file.hpp", "int a;\n");
+    auto changed = detail::read_file("read_file.hpp");
+    REQUIRE(changed != file);
+    REQUIRE(std::string(changed->data(), changed->size()) == "int a;\n");
+    REQUIRE(!changed->include_guard());
+    // the old contents are owned, so they are unchanged
+    REQUIRE(std::string(file->data(), file->size()) == header);
+}
+
+TEST_CASE("detail::get_include_guard_macro")
+{
+    auto guard = [](const char* str) {
+        return detail::get_include_guard_macro(str, str + std::strlen(str));
+    };
+
+    REQUIRE(guard("#ifndef A\n#define A\n").value() == "A");
+    REQUIRE(guard("\r\n#if !defined(B)\r\n  #define B  \r\n").value() == "B");
+    REQUIRE(guard("/* #ifndef A */ // #define A\n#ifndef C\n#define C").value() == "C");
+    REQUIRE(!guard(""));
+    REQUIRE(!guard("/"));
+    REQUIRE(!guard("int a;\n#ifndef A\n#define A\n"));
+    REQUIRE(!guard("#ifndef A\n#define B\n"));
+    REQUIRE(!guard("#ifndef A\n#define A 1\n"));
+}
@@ -0,0 +1,32 @@
+// Copyright (C) 2017-2018 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+// the worker executable of the libclang_process_parser tests
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <cppast/libclang_process_parser.hpp>
+
+namespace
+{
+    // crashes or hangs on purpose, see the libclang_process_parser tests
+    bool worker_filter(const cppast::libclang_entity_info& info)
+    {
+        if (std::strcmp(info.name(), "process_crash") == 0)
+            std::abort();
+        else if (std::strcmp(info.name(), "process_hang") == 0)
+            std::this_thread::sleep_for(std::chrono::hours(1));
+        return true;
+    }
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    cppast::libclang_process_parser::run_worker(argc, argv, worker_filter);
+    // not started as a worker
+    return EXIT_FAILURE;
+}
@@ -41,12 +41,24 @@ inline std::unique_ptr<cppast::cpp_file> parse_file(const cppast::cpp_entity_ind
     return result;
 }
 
+// parses the code without writing it to disk
 inline std::unique_ptr<cppast::cpp_file> parse(const cppast::cpp_entity_index& idx,
                                                const char* name, const char* code,
                                                bool fast_preprocessing = false)
 {
-    write_file(name, code);
-    return parse_file(idx, name, fast_preprocessing);
+    using namespace cppast;
+
+    libclang_compile_config config;
+    config.set_flags(cpp_standard::cpp_latest);
+    config.fast_preprocessing(fast_preprocessing);
+    config.add_unsaved_file(name, code);
+
+    libclang_parser p(default_logger());
+
+    std::unique_ptr<cppast::cpp_file> result;
+    REQUIRE_NOTHROW(result = p.parse(idx, name, config));
+    REQUIRE(!p.error());
+    return result;
 }
 
 class test_generator : public cppast::code_generator
@@ -236,7 +248,8 @@ bool equal_ref(const cppast::cpp_entity_index&                   idx,
     if (entities.size() != 1u)
         return false;
     return entities[0u]->name().empty()
-           || full_name(*entities[0u]) == (full_name_override ? full_name_override : parsed.name());
+           || ::full_name(*entities[0u])
+                  == (full_name_override ? full_name_override : parsed.name());
 }
 
 template <typename T>